@@ -83,7 +83,7 @@ def fromString(s, keyvals=True, convert_strings=False):
         p.parse_string(a, s)
     return _ark.to_object(a, convert_strings)
 
-def fromArgv(argv, convert_strings=False):
+def fromArgv(argv, convert_strings=False, jobs=1):
     '''
     Handle --include xxx and --cfg options from a list of strings.
     
@@ -96,8 +96,13 @@ def fromArgv(argv, convert_strings=False):
 
     If convert_strings is True, try to convert atoms to int, float,
     or bool before giving up and settling for string.
+
+    The files, and the files they include, are read and parsed on jobs
+    threads (1 by default, 0 for one per core) and applied in the order
+    given.
     '''
     a = _ark.ark()
+    l = _ark.loader(_ark.parser().threads(jobs))
     i,n = 0, len(argv)
     args = []
     while i<n:
@@ -105,15 +110,16 @@ def fromArgv(argv, convert_strings=False):
             i += 1
             if i==n:
                 raise ValueError('Missing argument to --include')
-            _ark.parser().parse_file(a, argv[i])
+            l.include(argv[i])
         elif argv[i] == '--cfg':
             i += 1
             if i==n:
                 raise ValueError('Missing argument to --cfg')
-            _ark.parser().parse_keyvals(a, argv[i])
+            l.keyvals(argv[i])
         else:
             args.append(argv[i])
         i += 1
+    l.load(a)
     return _ark.to_object(a, convert_strings), args
 
 def load(*paths, **kwds):
@@ -139,6 +145,55 @@ def save(obj, path, **kwds):
     with open(path, 'w') as fp:
         fp.write(toString(obj, **kwds))
 
+def writeRecord(fp, obj, whitespace=False):
+    ''' Append obj to an ark stream (see ark/records.hpp).
+
+    Args:
+        fp: file open for writing in binary mode.
+        obj: ark object as nested dict, list, string; need not be a dict.
+        whitespace (bool): as for toString().
+    '''
+    text = toString(obj, keyvals=False, whitespace=whitespace).encode('utf-8')
+    fp.write(b'%d ' % len(text))
+    fp.write(text)
+    fp.write(b'\n')
+
+def readRecords(fp, convert_strings=False):
+    ''' Generate the records of an ark stream, in order.
+
+    Records are read and parsed one at a time, as the generator is
+    advanced, so a stream can be larger than memory.
+
+    Args:
+        fp: file path, or file open for reading in binary mode.
+        convert_strings (bool): as for fromString().
+    '''
+    if isinstance(fp, (str, bytes, os.PathLike)):
+        with open(fp, 'rb') as f:
+            yield from readRecords(f, convert_strings)
+        return
+    count, offset = 0, 0
+    while True:
+        digits = b''
+        c = fp.read(1)
+        while c.isdigit() and len(digits) < 19:
+            digits += c
+            c = fp.read(1)
+        if not c and not digits:
+            return
+        count += 1
+        if c != b' ' or not digits:
+            raise ValueError('bad record length in record %d at byte %d'
+                             % (count, offset + len(digits)))
+        n = int(digits)
+        text = fp.read(n)
+        if len(text) != n or fp.read(1) != b'\n':
+            raise ValueError('record %d at byte %d is cut short'
+                             % (count, offset))
+        offset += len(digits) + n + 2
+        yield fromString(text.decode('utf-8'), keyvals=False,
+                         convert_strings=convert_strings)
+
 class ArkAction(argparse.Action):
     @staticmethod
     def configure(parser, prefix=None, defval=None, abspath=False):
@@ -133,6 +133,40 @@ PYBIND11_MODULE(_ark, m) {
         .def("parse_keyvals",
              (ark&(parser::*)(ark&, std::string const&) const) &parser::parse_keyvals)
         .def("parse_file", &parser::parse_file)
+        .def("threads", (parser&(parser::*)(unsigned)) &parser::threads,
+             return_value_policy::reference_internal)
+        .def("cache_includes", (parser&(parser::*)(bool)) &parser::cache_includes,
+             return_value_policy::reference_internal)
+        .def("cache_dir",
+             (parser&(parser::*)(std::string const&)) &parser::cache_dir,
+             return_value_policy::reference_internal)
+        .def("lazy", (parser&(parser::*)(bool)) &parser::lazy,
+             return_value_policy::reference_internal)
+        .def("select", [](parser& p, iterable keys) -> parser& {
+                std::vector<std::string> k;
+                for (handle h : keys) k.push_back(h.cast<std::string>());
+                return p.select(k);
+             },
+             return_value_policy::reference_internal)
+        ;
+
+    class_<include_cache>(m, "include_cache")
+        .def_static("hits", &include_cache::hits)
+        .def_static("misses", &include_cache::misses)
+        .def_static("size", &include_cache::size)
+        .def_static("clear", &include_cache::clear)
+        .def_static("reset", &include_cache::reset)
+        ;
+
+    class_<loader>(m, "loader")
+        .def(init<const parser&>())
+        .def("include", &loader::include,
+             return_value_policy::reference_internal)
+        .def("keyvals",
+             (loader&(loader::*)(std::string const&)) &loader::keyvals,
+             return_value_policy::reference_internal)
+        .def("load", &loader::load,
+             call_guard<gil_scoped_release>())
         ;
 
     class_<printer::printer_ref>(m, "printer_ref")
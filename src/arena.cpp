@@ -0,0 +1,53 @@
+#include "arena.hpp"
+#include "base.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace Ark {
+
+  namespace {
+    // blocks grow geometrically up to this size
+    const size_t max_block = size_t(1)<<24;
+  }
+
+  arena::arena(size_t block) :
+    _cur(NULL), _end(NULL), _next(block ? block : 1),
+    _allocations(0), _bytes(0), _reserved(0), _heap_refs(0) {}
+
+  arena::~arena() {
+#ifndef ANARKY_NOW
+    // annotations hold heap strings, so then we always walk
+    if (_heap_refs)
+#endif
+      for (size_t i=_roots.size(); i--; ) _roots[i]->~ark();
+    for (size_t i=0; i<_blocks.size(); ++i) free(_blocks[i]);
+  }
+
+  void *arena::grow(size_t n,size_t align) {
+    _blocks.reserve(_blocks.size()+1);
+    size_t size = _next;
+    if (size < n+align) size = n+align;
+    void *b = malloc(size);
+    if (!b) throw std::bad_alloc();
+    _blocks.push_back(b);
+    _reserved += size;
+    _cur = static_cast<char *>(b);
+    _end = _cur+size;
+    if (_next < max_block) _next *= 2;
+    return allocate(n,align);
+  }
+
+  const char *arena::copy(const char *s,size_t n) {
+    char *p = static_cast<char *>(allocate(n+1,8));
+    memcpy(p,s,n);
+    p[n] = '\0';
+    return p;
+  }
+
+  ark &arena::root() {
+    ark *r = new (allocate(sizeof(ark),alignof(ark))) ark;
+    _roots.push_back(r);
+    return *r;
+  }
+}
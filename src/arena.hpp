@@ -0,0 +1,173 @@
+#ifndef ark_arena_hpp
+#define ark_arena_hpp
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+/*! \file ark/arena.hpp
+
+An arena is a monotonic allocator for arks that are parsed once and
+then only read, such as simulation configurations.  Nodes, container
+storage and atom characters are carved out of large blocks, and the
+whole tree is released at once when the arena is destroyed, without
+visiting individual nodes.
+
+Example:
+<code>
+\verbatim
+    Ark::arena A;
+    const Ark::ark &cfg = Ark::parser().parse_file_into(A,"sim.ark");
+    // ... read cfg for as long as A lives ...
+\endverbatim
+</code>
+
+Trees in an arena are handed out const.  Copies of them (or of any of
+their subtrees) are ordinary heap-allocated arks that may outlive the
+arena.
+*/
+
+namespace Ark {
+
+  class ark;
+
+  //! A monotonic block allocator.  Not thread-safe.
+  class arena {
+    char  *_cur;   //!< next free byte in the current block.
+    char  *_end;   //!< end of the current block.
+    size_t _next;  //!< size of the next block to allocate.
+    std::vector<void *> _blocks; //!< every block, for release.
+    std::vector<ark *>  _roots;  //!< trees to destroy if _heap_refs.
+    size_t _allocations; //!< number of allocate() calls.
+    size_t _bytes;       //!< bytes handed out by allocate().
+    size_t _reserved;    //!< bytes held in blocks.
+    size_t _heap_refs;   //!< heap allocations owned by arena nodes.
+
+    arena(const arena &);            // not copyable
+    arena &operator=(const arena &); // not assignable
+
+    void *grow(size_t n,size_t align);
+
+  public:
+    /*! Constructor.
+      @param block size of the first block; later blocks grow.
+    */
+    explicit arena(size_t block=65536);
+
+    /*! Release everything.  Trees are only visited when something
+      they own lives on the heap (see note_heap_allocation()).
+    */
+    ~arena();
+
+    /*! allocate memory that lives as long as the arena.
+      @param n bytes.
+      @param align alignment, a power of two.
+      @return pointer to the memory.
+    */
+    void *allocate(size_t n,size_t align=alignof(std::max_align_t)) {
+      char *p = reinterpret_cast<char *>(
+        (reinterpret_cast<size_t>(_cur) + align-1) & ~(align-1));
+      if (p+n > _end || !_cur) return grow(n,align);
+      _cur = p+n;
+      ++_allocations;
+      _bytes += n;
+      return p;
+    }
+
+    /*! copy a string into the arena, NUL-terminated and aligned so it
+      can be held by an atom.
+      @param s characters.
+      @param n number of characters.
+      @return the copy.
+    */
+    const char *copy(const char *s,size_t n);
+
+    /*! create an empty ark that lives in the arena and is destroyed
+      with it.
+      @return the new ark.
+    */
+    ark &root();
+
+    /*! record that an arena node owns a heap allocation (a long
+      table key, for instance).  The arena then destroys its root
+      trees before releasing its blocks, so nothing leaks.
+    */
+    void note_heap_allocation() { ++_heap_refs; }
+
+    //! number of allocate() calls so far.
+    //! @return count.
+    size_t allocations() const { return _allocations; }
+    //! bytes handed out so far.
+    //! @return count.
+    size_t bytes() const { return _bytes; }
+    //! bytes held in blocks, in use or not.
+    //! @return count.
+    size_t reserved() const { return _reserved; }
+    //! number of blocks.
+    //! @return count.
+    size_t blocks() const { return _blocks.size(); }
+  };
+
+  /*! A standard allocator which takes its memory from an arena, or
+    from the heap when it has no arena.  Containers keep the allocator
+    they were constructed with for their whole life, and copies of
+    containers go back to the heap.
+  */
+  template <typename T>
+  class allocator {
+    template <typename U> friend class allocator;
+    arena *_pool; //!< the arena, or NULL for the heap.
+
+  public:
+    typedef T value_type; //!< what gets allocated.
+    //! keep the allocator across container assignment.
+    typedef std::false_type propagate_on_container_copy_assignment;
+    //! keep the allocator across container assignment.
+    typedef std::false_type propagate_on_container_move_assignment;
+    //! keep the allocator across container swaps.
+    typedef std::false_type propagate_on_container_swap;
+
+    //! heap allocator.
+    allocator() noexcept : _pool(NULL) {}
+    //! arena allocator.
+    //! @param a the arena, or NULL for the heap.
+    explicit allocator(arena *a) noexcept : _pool(a) {}
+    //! rebinding copy.
+    //! @param o another allocator.
+    template <typename U>
+    allocator(const allocator<U> &o) noexcept : _pool(o._pool) {}
+
+    //! the arena in use.
+    //! @return the arena, or NULL for the heap.
+    arena *pool() const { return _pool; }
+
+    //! copies of containers live on the heap.
+    //! @return a heap allocator.
+    allocator select_on_container_copy_construction() const {
+      return allocator();
+    }
+
+    //! allocate room for n objects.
+    //! @param n count.
+    //! @return uninitialized memory.
+    T *allocate(size_t n) {
+      if (_pool) return static_cast<T *>(_pool->allocate(n*sizeof(T),alignof(T)));
+      return static_cast<T *>(::operator new(n*sizeof(T)));
+    }
+    //! release memory; a no-op for arenas.
+    //! @param p memory from allocate().
+    void deallocate(T *p,size_t) {
+      if (!_pool) ::operator delete(p);
+    }
+
+    //! allocators are equal if they use the same memory.
+    template <typename U>
+    bool operator==(const allocator<U> &o) const { return _pool==o._pool; }
+    //! allocators are equal if they use the same memory.
+    template <typename U>
+    bool operator!=(const allocator<U> &o) const { return _pool!=o._pool; }
+  };
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define __ark__argv_dot_hpp__
 
 #include "ark.hpp"
+#include "loader.hpp"
 #include <string>
 #include <iostream>
 
@@ -23,17 +24,20 @@ extern const std::string _dashcfg;
   @param a ark to parse into
   @param b iterator pointing to beginning of command line arguments, e.g., argv
   @param e iterator pointing to end of command line arguments, e.g., argv+argc
+  @param P parser to use, e.g. one set up with parser::threads().  With
+  more than one thread the files and their includes are read and parsed
+  concurrently by a loader, and applied in command line order.
 
   @bug The argv utilities may be confused by non-ark command line arguments that
   look like ark-specific arguments, --include or --cfg.
  */
 template <class IITER>
 void
-argvparse(ark& a, IITER b, IITER e){
+argvparse(ark& a, IITER b, IITER e, const parser& P){
   const std::string di("--include");
   const std::string dc("--cfg");
   const std::string ds("-");
-  Ark::parser P;
+  loader L(P);
   for(; b!=e; ++b){
     if( !*b ){              // handle argv[argc] = NULL
       continue;
@@ -41,27 +45,40 @@ argvparse(ark& a, IITER b, IITER e){
       IITER ppb = ++b;
       if(ppb == e)
         throw InputError("dangling --include arg at end of argument sequence");
-      P.parse_file(a, *ppb);
+      L.include(*ppb);
     }else if( *b == dc ){
       IITER ppb = ++b;
       if(ppb == e)
         throw InputError("dangling --cfg arg at end of argument sequence");
-      if (*ppb == ds) P.parse_keyvals(a, std::cin);
-      else            P.parse_keyvals(a, *ppb);
+      if (*ppb == ds) L.keyvals(std::cin);
+      else            L.keyvals(*ppb);
     }else {
       std::string s(*b);
       if( s.substr(0,di.size()+1) == di+"=" ){
         std::string arg = s.substr(di.size()+1);
-        P.parse_file(a, arg);
+        L.include(arg);
       }
       else if( s.substr(0,dc.size()+1) == dc+"=" ){
         std::string arg = s.substr(dc.size()+1) ;
-        if (arg == ds) P.parse_keyvals(a, std::cin);
-        else           P.parse_keyvals(a, arg);
+        if (arg == ds) L.keyvals(std::cin);
+        else           L.keyvals(arg);
 
       }
     }
   }
+  L.load(a);
+}
+
+/*! argvparse() with a default parser.
+
+  @param a ark to parse into
+  @param b iterator pointing to beginning of command line arguments, e.g., argv
+  @param e iterator pointing to end of command line arguments, e.g., argv+argc
+ */
+template <class IITER>
+void
+argvparse(ark& a, IITER b, IITER e){
+  argvparse(a, b, e, Ark::parser());
 }
 
 /*! Copy all arguments from the range [b, e) to out, skipping those
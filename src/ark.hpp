@@ -3,8 +3,19 @@
 
 #include "base.hpp"
 #include "printer.hpp"
+#include "handler.hpp"
 #include "parser.hpp"
 #include "exception.hpp"
+#include "cache.hpp"
+#include "loader.hpp"
+#include "batch.hpp"
+#include "feeder.hpp"
+#include "records.hpp"
+#include "compress.hpp"
+#include "watcher.hpp"
+#include "patch.hpp"
+#include "binding.hpp"
+#include "intern.hpp"
 #include "argv.hpp"
 #include "reader.hpp"
 
@@ -1,15 +1,62 @@
 #include "atom.hpp"
+#include <atomic>
 #include <cstring>
 #include <cstdlib>
+#include <new>
+
+namespace {
+  // shared storage for empty atoms, so that default-constructed and
+  // moved-from atoms don't allocate.  Aligned to keep the tag bits free.
+  alignas(8) char empty_atom[8] = "";
+
+  // heap characters follow the number of storages holding them
+  typedef std::atomic<size_t> holders_t;
+
+  holders_t &holders(char *p) { return reinterpret_cast<holders_t *>(p)[-1]; }
+
+  char *made(size_t n) {
+    void *m = malloc(sizeof(holders_t)+n+1);
+    if (!m) throw std::bad_alloc();
+    holders_t *h = new (m) holders_t(1);
+    return reinterpret_cast<char *>(h+1);
+  }
+}
 
 void Ark::atom_storage_t::destroy() {
+  if (bitmasks::mask(u.bits,bitmasks::all,0)==bitmasks::borrowed) return;
   u.bits = bitmasks::mask(u.bits,~bitmasks::all,0);
-  free(u.ptr);
+  if (u.ptr!=empty_atom
+      && holders(u.ptr).fetch_sub(1,std::memory_order_acq_rel)==1)
+    free(&holders(u.ptr));
 }
 void Ark::atom_storage_t::init(const char *c) {
-  u.ptr=strdup(c);
+  init(c,strlen(c));
+}
+void Ark::atom_storage_t::init(const char *c,size_t n) {
+  if (!n) { init_empty(); return; }
+  u.ptr=made(n);
+  memcpy(u.ptr,c,n);
+  u.ptr[n]='\0';
+  u.bits = bitmasks::mask(u.bits,~bitmasks::all,bitmasks::atom);
+}
+void Ark::atom_storage_t::init_empty() {
+  u.ptr=empty_atom;
   u.bits = bitmasks::mask(u.bits,~bitmasks::all,bitmasks::atom);
 }
+void Ark::atom_storage_t::borrow(const char *c) {
+  u.ptr=const_cast<char *>(c);
+  u.bits = bitmasks::mask(u.bits,~bitmasks::all,bitmasks::borrowed);
+}
+void Ark::atom_storage_t::share(const atom_storage_t &o) {
+  // borrowed characters may not outlive their owner
+  if (bitmasks::mask(o.u.bits,bitmasks::all,0)==bitmasks::borrowed) {
+    init(o.c_str());
+    return;
+  }
+  u.bits = o.u.bits;
+  char *p = const_cast<char *>(c_str());
+  if (p!=empty_atom) holders(p).fetch_add(1,std::memory_order_relaxed);
+}
 const char *Ark::atom_storage_t::c_str() const {
   ptr_t p(u);
   p.bits = bitmasks::mask(p.bits,~bitmasks::all,0);
@@ -3,6 +3,7 @@
 
 #include "bittricks.hpp"
 #include <string>
+#include <string_view>
 
 /*! \file ark/atom.hpp */
 
@@ -13,6 +14,7 @@ namespace Ark {
     aggressively small memory footprint.
   */
   class atom_t : private atom_storage_t {
+    friend class ark;
   public:
     //! deallocates the atom_storage_t parent.
     ~atom_t() {destroy();}
@@ -20,9 +22,13 @@ namespace Ark {
     //! defaults to empty string.
     atom_t() {init("");}
 
-    //! copies into the atom_storage_t.
+    //! shares a's characters.
+    //! @param a an atom.
+    atom_t(const atom_t &a) {share(a);}
+
+    //! takes over a's storage, leaving a empty.
     //! @param a an atom.
-    atom_t(const atom_t &a) {init(a.c_str());}
+    atom_t(atom_t &&a) noexcept {init_empty(); swap(a);}
 
     //! copies into the atom_storage_t.
     //! @param a a C++ string.
@@ -32,6 +38,10 @@ namespace Ark {
     //! @param a a C string.
     atom_t(const char *a) {init(a);}
 
+    //! copies into the atom_storage_t.
+    //! @param a characters, which must not include a NUL.
+    explicit atom_t(std::string_view a) {init(a.data(),a.size());}
+
     //! get a C-string.
     //! @return a pointer to a fixed C string (don't decallocate).
     const char *c_str() const {return atom_storage_t::c_str();}
@@ -43,7 +53,18 @@ namespace Ark {
     //! assignment.
     //! @param a an atom. Yes, a = a should work.
     //! @return reference to this atom_t.
-    atom_t &operator=(const atom_t &a) { assign(a.c_str()); return *this; }
+    atom_t &operator=(const atom_t &a) {
+      atom_storage_t tmp;
+      tmp.share(a);
+      destroy();
+      swap(tmp);
+      return *this;
+    }
+
+    //! move assignment.
+    //! @param a an atom, left holding this atom's old value.
+    //! @return reference to this atom_t.
+    atom_t &operator=(atom_t &&a) noexcept { swap(a); return *this; }
 
     //! allow implicit coercion to a C++-string.
     operator std::string() const { return str(); }
@@ -4,6 +4,15 @@
 #include <sstream>
 #include <cstdlib>
 
+/* Sharing.  Every vector and table is made with a count of the arks
+   holding it just in front of it.  Copying an ark that holds one from
+   the heap adds to the count instead of copying it; a non-const
+   vector() or table() through an ark that isn't the only holder
+   copies the container, which shares each element's own subtree, and
+   lets go of the shared one.  A container in an arena is always
+   copied, to the heap, since copies may outlive the arena; its count
+   stays at one. */
+
 namespace Ark {
 
   exception::exception(const std::string& s):
@@ -18,7 +27,11 @@ namespace Ark {
   }
 
   ark::ark(const atom_t &a) {
-    u.atom.init(a.c_str());
+    u.atom.share(a);
+  }
+  ark::ark(atom_t &&a) noexcept {
+    u.atom.init_empty();
+    u.atom.swap(a);
   }
   ark::ark(const std::string& str) {
      u.atom.init(str.c_str());
@@ -35,40 +48,142 @@ namespace Ark {
     be(Table).table() = t;
   }
 
+  ark::ark(vector_t &&v) {
+    u.bits = bitmasks::none;
+    be(Vector).vector() = std::move(v);
+  }
+  ark::ark(table_t &&t) {
+    u.bits = bitmasks::none;
+    be(Table).table() = std::move(t);
+  }
+
   ark::~ark() { clear(); }
 
+  namespace {
+    typedef std::atomic<size_t> holders_t;
+
+    holders_t &holders(void *c) { return static_cast<holders_t *>(c)[-1]; }
+
+    // a new container in m, with one holder
+    template <typename C,typename... Args>
+    C *placed(void *m,Args&&... args) {
+      static_assert(alignof(C)<=sizeof(holders_t),"count spoils alignment");
+      holders_t *h = new (m) holders_t(1);
+      return new (h+1) C(std::forward<Args>(args)...);
+    }
+
+    template <typename C,typename... Args>
+    C *made(Args&&... args) {
+      void *m = ::operator new(sizeof(holders_t)+sizeof(C));
+      try {
+        return placed<C>(m,std::forward<Args>(args)...);
+      }
+      catch (...) {
+        ::operator delete(m);
+        throw;
+      }
+    }
+
+    template <typename C>
+    C *made(arena *A) {
+      return placed<C>(A->allocate(sizeof(holders_t)+sizeof(C),
+                                   alignof(holders_t)),
+                       typename C::allocator_type(A));
+    }
+
+    // containers keep their allocator for life, so it also tells us
+    // where the container itself was put.
+    template <typename C>
+    void release(C *c) {
+      if (c->get_allocator().pool()) c->~C();
+      else if (holders(c).fetch_sub(1,std::memory_order_acq_rel)==1) {
+        c->~C();
+        ::operator delete(&holders(c));
+      }
+    }
+
+    // the container for a copy of an ark holding c
+    template <typename C>
+    C *shared(C *c) {
+      if (c->get_allocator().pool()) return made<C>(*c);
+      holders(c).fetch_add(1,std::memory_order_relaxed);
+      return c;
+    }
+  }
+
   ark &ark::be(kind_t t) {
+    // a subtree that is about to be replaced need never be parsed
+    if (is_deferred()) undefer(t==kind());
     kind_t _kind=kind();
     if (t!=_kind) {
       switch(_kind) {
       case None: break;
       case Atom: u.atom.destroy(); break;
-      case Vector: delete unmasked().vector; break;
-      case Table:  delete unmasked().table; break;
+      case Vector: release(unmasked().vector); break;
+      case Table:  release(unmasked().table); break;
       }
       switch(t) {
       case None: u.bits = bitmasks::none; break;
       case Atom: u.atom.init(""); break;
-      case Vector: u.vector = new vector_t; mask(bitmasks::vector); break;
-      case Table:  u.table  = new table_t; mask(bitmasks::table); break;
+      case Vector: u.vector = made<vector_t>(); mask(bitmasks::vector); break;
+      case Table:  u.table  = made<table_t>(); mask(bitmasks::table); break;
       }
     }
     return *this;
   }
+  ark &ark::be(kind_t t,arena *A) {
+    if (!A || t==kind() || t==None || t==Atom) return be(t);
+    clear();
+    if (t==Vector) {
+      u.vector = made<vector_t>(A);
+      mask(bitmasks::vector);
+    }
+    else {
+      u.table = made<table_t>(A);
+      mask(bitmasks::table);
+    }
+    return *this;
+  }
+  ark &ark::be_atom(std::string_view s,arena *A) {
+    if (!A) {
+      be(Atom);
+      atom() = atom_t(s);
+      return *this;
+    }
+    clear();
+    u.atom.borrow(A->copy(s.data(),s.size()));
+    return *this;
+  }
 #ifdef ANARKY_NOW
   ark::ark(const ark &a) : ano(a.ano) { // copy annotation
 #else
   ark::ark(const ark &a) {
 #endif
-    u = a.u;
+    u = a.resolved().u;
     switch(kind()) {
     case None: break;
     case Atom:
-      u.atom.init(atom().c_str()); break;
+      u.atom.share(a.u.atom); break;
     case Vector:
-      u.vector = new vector_t(vector()); mask(bitmasks::vector); break;
+      u.vector = shared(unmasked().vector); mask(bitmasks::vector); break;
     case Table :
-      u.table = new table_t(table()); mask(bitmasks::table); break;
+      u.table = shared(unmasked().table); mask(bitmasks::table); break;
+    }
+  }
+
+  //private:
+  void ark::unshare() {
+    if (kind()==Vector) {
+      vector_t *c = unmasked().vector;
+      u.vector = made<vector_t>(*c);
+      mask(bitmasks::vector);
+      release(c);
+    }
+    else {
+      table_t *c = unmasked().table;
+      u.table = made<table_t>(*c);
+      mask(bitmasks::table);
+      release(c);
     }
   }
   
@@ -105,10 +220,10 @@ namespace Ark {
   
   const ark * ark::xget(const std::string &s) const {
     const ark * ret=this;
+    bool looking=false; // a deferred subtree's parse errors get out
     try {
-      tokenizer::syntax S("[].","");
-      std::istringstream In(s);
-      tokenizer t(In,S);
+      static const tokenizer::syntax S("[].","");
+      tokenizer t(s,S);
       t.next();
       while( ret && t.current().kind() != token::End ) {
         if (t.current().syntax()=='[') { 
@@ -117,10 +232,14 @@ namespace Ark {
           unsigned offset = strtoul(t.current().text().c_str(),NULL,10);
 
           if (t.next().syntax()!=']') return NULL;
+          looking=true;
           ret = ret->get(offset);
+          looking=false;
         }
         else if (t.current().kind()==token::Symbol) {
+          looking=true;
           ret = ret->get(t.current().text());
+          looking=false;
         }
         else return NULL;
 
@@ -137,7 +256,10 @@ namespace Ark {
         }
       }
       return ret;
-    } catch(...) { /* anything goes wrong, you get NULL back */ }
+    } catch(...) {
+      if (looking) throw;
+      /* anything else goes wrong, you get NULL back */
+    }
     return NULL;
   }
 }
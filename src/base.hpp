@@ -5,9 +5,12 @@
 #include "kind.hpp"
 #include "key.hpp"
 #include "atom.hpp"
+#include "arena.hpp"
 
+#include <atomic>
 #include <vector>
 #include <map>
+#include <utility>
 
 
 /*! \file ark/base.hpp */
@@ -23,10 +26,14 @@ namespace Ark {
   //! footprint small.
   class ark;
 
-  typedef std::vector<ark> vector_t;
+  //! a subtree that has not been parsed yet; see parser::lazy().
+  struct deferred_t;
+
+  typedef std::vector<ark,allocator<ark> > vector_t;
   //!< vector_t is an STL vector of arks.
 
-  typedef std::map<key_t,ark> table_t;
+  typedef std::map<key_t,ark,std::less<key_t>,
+                   allocator<std::pair<const key_t,ark> > > table_t;
   //!< table_t is an STL map of key_t-ark pairs.
 
   /*! Think of an ark as a union of Ark::atom_t, Ark::vector_t, and
@@ -34,6 +41,24 @@ namespace Ark {
     and tables being the internal nodes and atoms, and None as
     leaf nodes.
 
+    Copying an ark is cheap: the copy shares its vector or table, and
+    everything below, with the original, and whichever of them is
+    first changed through a non-const vector() or table() makes its own
+    copy of that one container, sharing the arks in it in turn.  Arks
+    sharing a subtree can be read, copied and destroyed from different
+    threads.
+
+    \warning A reference got from a non-const accessor is into this
+    ark's own container only until the ark, or one holding it, is
+    copied; a change through it afterwards shows in the copy too.
+    Take it again after copying to change only this ark:
+\verbatim
+      table_t &t = a.table();
+      ark b(a);
+      t[x] = "changed";        // changes b as well
+      a.table()[x] = "changed"; // changes a alone
+\endverbatim
+
     There are 4 "get" members which are supplied as a convenience for
     extracting values from an ark.  However, these functions are
     probably misplaced, definitely could be implemented outside this
@@ -47,9 +72,12 @@ namespace Ark {
       atom_storage_t          atom;
       vector_t    *vector;
       table_t     *table;
+      deferred_t  *deferred;
     } var_ptr_t;
     var_ptr_t u;
 
+    friend struct deferred_t;
+
     var_ptr_t unmasked() const {
       var_ptr_t p(u);
       p.bits = bitmasks::mask(p.bits,~bitmasks::all,0);
@@ -59,6 +87,32 @@ namespace Ark {
       u.bits = bitmasks::mask(u.bits,~bitmasks::all,m);
     }
 
+    // deferred subtrees; see lazy.cpp
+    bool is_deferred() const {
+      return bitmasks::mask(u.bits,bitmasks::deferred,0)==bitmasks::deferred;
+    }
+    const ark &forced() const;
+    const ark &resolved() const { return is_deferred() ? forced() : *this; }
+    ark &resolved() {
+      return is_deferred() ? const_cast<ark &>(forced()) : *this;
+    }
+    void undefer(bool keep);
+
+    // a vector or table is preceded by the number of arks holding it;
+    // see base.cpp
+    typedef std::atomic<size_t> holders_t;
+    static holders_t &holders(const void *c) {
+      return const_cast<holders_t *>(static_cast<const holders_t *>(c))[-1];
+    }
+    void unshare();
+    //! this ark, resolved, with a vector or table of its own.
+    ark &owned() {
+      ark &r = resolved();
+      if (holders(r.unmasked().table).load(std::memory_order_acquire)!=1)
+        r.unshare();
+      return r;
+    }
+
 #ifdef ANARKY_NOW
   public:
     struct annotation_t {
@@ -88,8 +142,11 @@ namespace Ark {
       default:
       case bitmasks::none:         return None;
       case bitmasks::atom:         return Atom;
+      case bitmasks::borrowed:     return Atom;
       case bitmasks::vector:       return Vector;
       case bitmasks::table:        return Table;
+      case bitmasks::deferred_table:  return Table;
+      case bitmasks::deferred_vector: return Vector;
       }
     }
     //! explicit constructor given a kind.
@@ -117,10 +174,33 @@ namespace Ark {
     //! @param t table.
     ark(const table_t &t);
 
-    //! Copy.
+    //! construct by taking over a vector_t.
+    //! @param v vector (left empty).
+    ark(vector_t &&v);
+
+    //! construct by taking over a table_t.
+    //! @param t table (left empty).
+    ark(table_t &&t);
+
+    //! Copy.  A vector or table is shared, not copied, unless it is in
+    //! an arena.
     //! @param a another ark.
     ark(const ark &a);
 
+    //! Move.  Takes over the contents of a, leaving it None.
+    //! @param a another ark.
+#ifdef ANARKY_NOW
+    ark(ark &&a) noexcept : u(a.u), ano(std::move(a.ano)) {
+#else
+    ark(ark &&a) noexcept : u(a.u) {
+#endif
+      a.u.bits = bitmasks::none;
+    }
+
+    //! construct by taking over the storage of an atom_t.
+    //! @param a atom (left empty).
+    ark(atom_t &&a) noexcept;
+
     //! swap: swings pointers but does not destroy anything.
     //! @param a another ark.
     void swap(ark &a);
@@ -134,6 +214,16 @@ namespace Ark {
       return *this;
     }
 
+    /*! Move assignment.  Whatever this ark held before is destroyed
+      and a is left None.
+      @param a another ark.
+      @return reference to this ark.
+    */
+    ark &operator=(ark &&a) noexcept {
+      ark tmp(std::move(a)); swap(tmp);
+      return *this;
+    }
+
     /*! Merge.  Add the contents of the given ark to this ark,
       merging table entries and otherwise transmuting as needed
       by the second ark.  To be specific (in pseudocode):
@@ -149,6 +239,14 @@ namespace Ark {
     */
     ark &merge(const ark &b);
 
+    /*! Merge, taking ownership of b's subtrees instead of copying them.
+      Same semantics as merge(const ark &); b is left in a valid but
+      unspecified state.
+      @param b another ark.
+      @return reference to this ark (after modification).
+    */
+    ark &merge(ark &&b);
+
     /*! transmute to a different type.
       If this ark is already of kind k, then nothing.  Else, all
       data previously held by this ark is destroyed and this ark
@@ -158,6 +256,20 @@ namespace Ark {
     */
     ark &be(kind_t k);
 
+    /*! be(k), taking any new vector or table from an arena.
+      @param k the new kind.
+      @param A the arena, or NULL for the heap.
+      @return reference to this (new) ark.
+    */
+    ark &be(kind_t k,arena *A);
+
+    /*! become an atom holding s, with its characters in an arena.
+      @param s characters.
+      @param A the arena, or NULL for the heap.
+      @return reference to this (new) ark.
+    */
+    ark &be_atom(std::string_view s,arena *A);
+
     //! the obvious.  equivalent to be(None).
     void clear() { be(None); }
 
@@ -172,17 +284,47 @@ namespace Ark {
     //! non-const version of atom().
     atom_t &atom()  { return ((atom_t*)&u.atom)[0]; }
 
-    //! access as vector (undefined behavior if wrong kind).
+    //! access as vector (undefined behavior if wrong kind).  A
+    //! deferred vector is parsed first.
     //! @return reference to this ark as a vector.
-    const vector_t &vector() const {return unmasked().vector[0];}
-    //! non-const version of vector().
-    vector_t &vector()  {return unmasked().vector[0];} 
+    const vector_t &vector() const {return resolved().unmasked().vector[0];}
+    //! non-const version of vector().  A vector shared with copies of
+    //! this ark is copied first, so changes to it are this ark's alone.
+    vector_t &vector()  {return owned().unmasked().vector[0];}
 
-    //! access as table (undefined behavior if wrong kind).
+    //! access as table (undefined behavior if wrong kind).  A
+    //! deferred table is parsed first.
     //! @return reference to this ark as a table.
-    const table_t &table() const { return unmasked().table[0]; }
-    //! non-const version of table().
-    table_t &table()  { return unmasked().table[0]; }
+    const table_t &table() const { return resolved().unmasked().table[0]; }
+    //! non-const version of table().  A table shared with copies of
+    //! this ark is copied first, so changes to it are this ark's alone.
+    table_t &table()  { return owned().unmasked().table[0]; }
+
+    /*! construct a new last element in place (undefined behavior if
+      this ark is not a vector).
+      @param args constructor arguments for the new element.
+      @return reference to the new element.
+    */
+    template <typename... Args>
+    ark &emplace_back(Args&&... args) {
+      vector_t &v = vector();
+      v.emplace_back(std::forward<Args>(args)...);
+      return v.back();
+    }
+
+    /*! construct the element for key k in place unless k is already
+      present (undefined behavior if this ark is not a table).
+      @param k key.
+      @param args constructor arguments for the new element.
+      @return reference to the element stored under k.
+    */
+    template <typename... Args>
+    ark &emplace(key_t k, Args&&... args) {
+      return table().emplace(std::piecewise_construct,
+                             std::forward_as_tuple(std::move(k)),
+                             std::forward_as_tuple(std::forward<Args>(args)...)
+                             ).first->second;
+    }
 
     //! return a atom_t* or NULL.
     //! @return pointer to the atom if this ark is an atom.
@@ -222,6 +364,60 @@ namespace Ark {
     @return the parsed ark.
   */
   ark parse(const std::string &s);
+  /*! parse text written by Ark::printer, fast.  Printer output, with
+    or without whitespace, is read straight from the buffer by a
+    parser that knows no other form of the strict grammar; anything it
+    doesn't expect sends the whole input through parse() instead, so
+    the result, or the error thrown, is the same as parse() gives.
+    @param b start of the input.
+    @param n length of the input.
+    @param check check that keys are well formed and not repeated, as
+    parse() does; machine-written input can skip this, in which case a
+    repeated key keeps its last value.
+    @return the parsed ark.
+  */
+  ark parse_trusted(const char *b,size_t n,bool check=true);
+  /*! parse_trusted() of a string.
+    @param s input string.
+    @param check as for parse_trusted(const char*,size_t,bool).
+    @return the parsed ark.
+  */
+  ark parse_trusted(const std::string &s,bool check=true);
+  /*! parse_trusted() into a new tree allocated from an arena, as
+    parser::parse_file_into() does, which is faster again.
+    @param A arena; must outlive every use of the result.
+    @param b start of the input.
+    @param n length of the input.
+    @param check as for parse_trusted(const char*,size_t,bool).
+    @return the parsed tree, owned by A.
+  */
+  const ark &parse_trusted_into(arena &A,const char *b,size_t n,
+                                bool check=true);
+  /*! parse with the strict grammar in two stages: the whole input is
+    first indexed, finding every token 64 bytes at a time (see
+    token_index), and the tree is then built from the index, with each
+    vector reserved at its final length.  The result, or the error
+    thrown, is the same as parse() gives, but line and column are only
+    worked out for an error.  Inputs of 2 GB or more are given to
+    parse()'s tokenizer.
+    @param b start of the input.
+    @param n length of the input.
+    @return the parsed ark.
+  */
+  ark parse_indexed(const char *b,size_t n);
+  /*! parse_indexed() of a string.
+    @param s input string.
+    @return the parsed ark.
+  */
+  ark parse_indexed(const std::string &s);
+  /*! parse_indexed() into a new tree allocated from an arena, as
+    parser::parse_file_into() does.
+    @param A arena; must outlive every use of the result.
+    @param b start of the input.
+    @param n length of the input.
+    @return the parsed tree, owned by A.
+  */
+  const ark &parse_indexed_into(arena &A,const char *b,size_t n);
 }
 
 /*! basic ark I/O: output.  No pretty printing, fully delimited.
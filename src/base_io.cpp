@@ -2,8 +2,11 @@
 #include "exception.hpp"
 #include "tokens.hpp"
 #include "printer.hpp"
+#include "parser_impl.hpp"
 
+#include <cctype>
 #include <sstream>
+#include <vector>
 
 /*! \file ark/base_io.cpp
 
@@ -30,69 +33,63 @@ change because of that.
 namespace {
   using namespace Ark;
   //! Internal function to do strict ark parsing.
+  //! @param to a tree_builder or an event_builder.
+  //! @param a where the value goes.
   //! @param t a token stream.
-  //! @return the parsed ark.
-  ark strict_parse(tokenizer &t) {
-    ark a;
+  template <typename B>
+  void strict_parse(B &to,typename B::node a,tokenizer &t) {
     switch(t.current().kind()) {
     case token::Symbol:
     case token::String:
-      a.be(Atom).atom() = t.current().text();
-      return a;
+      to.atom(a,t.current().view());
+      return;
     case token::Syntax:
       {
         switch( t.current().syntax() ) {
         case '[':
-          a.be(Vector);
-          for(int i=0; t.next().syntax()!=']'; i++)
-            a.vector().push_back(strict_parse(t));
+          to.begin_vector(a);
+          while (t.next().syntax()!=']')
+            strict_parse(to,to.element(a),t);
+          to.end_vector(a);
           break;
         case '{':
-          a.be(Table);
-          for(int i=0; t.next().syntax()!='}'; i++) {
+          to.begin_table(a);
+          while (t.next().syntax()!='}') {
             if (t.current().kind() != token::Symbol)
               throw  InputError("expecting a key symbol");
             Ark::key_t key(t.current().text());
-            if (a.table().find(key) != a.table().end()) {
-              std::string err("duplicate key: ");
-              throw InputError(err+key.str());
-            }
+            typename B::node slot = to.new_key(a,key);
             if (t.next().kind()!=token::Syntax || t.current().syntax()!='=')
               throw InputError("expecting a '='");
             t.next();
-            a.table()[key] = strict_parse(t);
+            strict_parse(to,slot,t);
           }
+          to.end_table(a);
           break;
         case '?':
-          a.be(None); break;
+          to.none(a); break;
         default:
           throw InputError("expecting '{' or '[' or '?'");
         }
-        return a;
+        return;
       }
       break;
     default:
       throw InputError("expecting '{' or '[' or '?' or string");
     }
   }
-}
-
-namespace Ark {
-
-  ark parse(const std::string &s) {
-    std::istringstream in(s);
-    return parse(in);
-  }
 
-  ark parse(std::istream &in) {
-    tokenizer t(in,tokenizer::syntax("{}<>[]=?","#"));
+  //! Internal function to strictly parse a whole token stream.
+  //! @param to a tree_builder or an event_builder.
+  //! @param a where the value goes.
+  //! @param t a token stream.
+  template <typename B>
+  void top_parse(B &to,typename B::node a,tokenizer &t) {
     try {
-      ark a;
       t.next();
-      a = strict_parse(t);
+      strict_parse(to,a,t);
       if (t.next().kind() != token::End )
         throw InputError("extra stuff after the value");
-      return a;
     }
     catch (Ark::exception &e) {
       std::ostringstream o;
@@ -102,6 +99,353 @@ namespace Ark {
       throw InputError(o.str());
     }
   }
+}
+
+namespace Ark {
+
+  namespace {
+    //! punctuation of the strict grammar.
+    const tokenizer::syntax strict_syn("{}<>[]=?","#");
+
+    const charset comment_end("\n",2);
+    const charset dquote_end("\"\\",3);
+    const charset squote_end("'\\",3);
+    const charset bquote_end("`\\",3);
+
+    /* Reads what printer writes straight from a buffer: no tokens, no
+       std::string for bare keys or atoms, tables filled in key order,
+       and vector elements gathered on a stack so that each vector is
+       allocated once at its final size.  Anything else it may meet is
+       only recognized well enough to give up on. */
+    class trusted_reader {
+      const char *p, *e;
+      bool check;             // check keys as key_t would
+      arena *pool;            // where nodes go; NULL for the heap
+      std::string buf;        // strings with escapes
+      std::vector<ark> stack; // elements of the vectors being read
+      unsigned char keychar[256]; // 1: may start a key, 2: may go on one
+
+      struct bad {}; // give up
+
+      void skip() {
+        for (;;) {
+          while (p!=e && scan::space.contains(*p)) ++p;
+          if (p==e || *p!='#') return;
+          p = comment_end.find_first_of(p,e);
+        }
+      }
+
+      bool valid(std::string_view k) const {
+        if (!(keychar[(unsigned char)k[0]] & 1)) return false;
+        for (size_t i=1; i<k.size(); ++i)
+          if (!(keychar[(unsigned char)k[i]] & 2)) return false;
+        return true;
+      }
+
+      void value(ark &a) {
+        if (p==e) throw bad();
+        switch (*p) {
+        case '{': ++p; table(a); return;
+        case '[': ++p; vector(a); return;
+        case '?': ++p; a.clear(); return;
+        case '"': case '\'': case '`': quoted(a); return;
+        }
+        const char *s = p;
+        p = strict_syn.symbol_stops().find_first_of(p,e);
+        if (p==s) throw bad();
+        a.be_atom(std::string_view(s,p-s),pool);
+      }
+
+      void quoted(ark &a) {
+        char q = *p++;
+        const charset &ends = q=='"' ? dquote_end
+                            : q=='\'' ? squote_end : bquote_end;
+        const char *s = p;
+        p = ends.find_first_of(p,e);
+        if (p!=e && *p==q) {
+          a.be_atom(std::string_view(s,p-s),pool);
+          ++p;
+          return;
+        }
+        buf.assign(s,p);
+        for (;;) {
+          if (p==e || *p!='\\') throw bad();
+          if (++p==e || !*p) throw bad();
+          buf += *p++;
+          s = p;
+          p = ends.find_first_of(p,e);
+          buf.append(s,p);
+          if (p!=e && *p==q) break;
+        }
+        ++p;
+        a.be_atom(buf,pool);
+      }
+
+      void table(ark &a) {
+        table_t &d = a.be(Table,pool).table();
+        for (;;) {
+          skip();
+          if (p==e) throw bad();
+          if (*p=='}') { ++p; return; }
+          const char *s = p;
+          p = strict_syn.symbol_stops().find_first_of(p,e);
+          if (p==s) throw bad();
+          std::string_view k(s,p-s);
+          if (check && !valid(k)) throw bad();
+          // long keys live on the heap even in an arena
+          if (pool && k.size() > std::string().capacity())
+            pool->note_heap_allocation();
+          size_t n = d.size();
+          // printed keys come in order, so each goes at the end
+          ark &slot = d.emplace_hint(d.end(),std::piecewise_construct,
+                                     std::forward_as_tuple(key_t::unchecked(k)),
+                                     std::forward_as_tuple())->second;
+          if (d.size()==n) {
+            if (check) throw bad();
+            slot.clear();
+          }
+          skip();
+          if (p==e || *p!='=') throw bad();
+          ++p;
+          skip();
+          value(slot);
+        }
+      }
+
+      void vector(ark &a) {
+        size_t start = stack.size();
+        for (;;) {
+          skip();
+          if (p==e) throw bad();
+          if (*p==']') { ++p; break; }
+          ark x;
+          value(x);
+          stack.emplace_back(std::move(x));
+        }
+        vector_t &v = a.be(Vector,pool).vector();
+        v.reserve(stack.size()-start);
+        for (size_t i=start; i<stack.size(); ++i)
+          v.emplace_back(std::move(stack[i]));
+        stack.resize(start);
+      }
+
+    public:
+      trusted_reader(const char *b,size_t n,bool c,arena *A)
+        : p(b), e(b+n), check(c), pool(A) {
+        for (unsigned i=0; i<256; ++i) {
+          keychar[i] = 0;
+          if (isalpha(i) || i=='_' || i==':') keychar[i] = 3;
+          else if (isdigit(i) || i=='-') keychar[i] = 2;
+        }
+      }
+
+      //! read the whole input into a; false if it isn't printer output.
+      bool read(ark &a) {
+        try {
+          skip();
+          value(a);
+          skip();
+          return p==e || !*p;
+        }
+        catch (bad &) {
+          return false;
+        }
+      }
+    };
+
+    const token_index strict_index(strict_syn);
+
+    /* The second stage of a two-stage parse: the strict grammar over
+       the tokens strict_index found, with vectors reserved at their
+       final length.  Errors read as top_parse() words them, with the
+       line and column worked out from the offset only then. */
+    class indexed_reader {
+      const char *b;
+      size_t n;
+      const std::vector<token_index::entry> &tk;
+      size_t k;                 // the current token; tk.size() at the end
+      tree_builder to;
+      std::string buf;          // strings with escapes
+
+      // the current token's syntax character, or 0
+      char syntax() const {
+        if (k==tk.size()) return 0;
+        char c = b[tk[k].at];
+        return strict_syn.is_syntax(c) ? c : 0;
+      }
+      char next() { ++k; return syntax(); }
+
+      // the current token's text, as token::view() gives it
+      std::string_view text() {
+        const token_index::entry &e = tk[k];
+        const char *s = b+e.at;
+        if (!strict_syn.is_quote(*s)) {
+          if (strict_syn.is_syntax(*s)) return std::string_view(s,1);
+          return std::string_view(s,e.end-e.at);
+        }
+        size_t end = e.end & ~token_index::escaped;
+        if (!(e.end & token_index::escaped))
+          return std::string_view(s+1,end-e.at-1);
+        buf.clear();
+        for (const char *c=s+1; c!=b+end; ++c) {
+          if (*c=='\\') ++c;
+          buf += *c;
+        }
+        return buf;
+      }
+
+      void value(ark *a) {
+        if (k==tk.size())
+          throw InputError("expecting '{' or '[' or '?' or string");
+        switch (syntax()) {
+        case 0:
+          to.atom(a,text());
+          return;
+        case '[': {
+          to.begin_vector(a);
+          a->vector().reserve(tk[k].end);
+          while (next()!=']') value(to.element(a));
+          to.end_vector(a);
+          return;
+        }
+        case '{':
+          to.begin_table(a);
+          while (next()!='}') {
+            if (k==tk.size() || strict_syn.is_quote(b[tk[k].at]) || syntax())
+              throw InputError("expecting a key symbol");
+            Ark::key_t key{std::string(text())};
+            ark *slot = to.new_key(a,key);
+            if (next()!='=') throw InputError("expecting a '='");
+            next();
+            value(slot);
+          }
+          to.end_table(a);
+          return;
+        case '?':
+          to.none(a);
+          return;
+        default:
+          throw InputError("expecting '{' or '[' or '?'");
+        }
+      }
+
+    public:
+      indexed_reader(const char *B,size_t N,
+                     const std::vector<token_index::entry> &T,arena *A)
+        : b(B), n(N), tk(T), k(0), to(A) {}
+
+      void read(ark &a) {
+        try {
+          value(&a);
+          if (++k!=tk.size())
+            throw InputError("extra stuff after the value");
+        }
+        catch (Ark::exception &e) {
+          // where a tokenizer would be, just past the current token
+          size_t off = n;
+          std::string what("<end of file>");
+          if (k<tk.size()) {
+            const token_index::entry &t = tk[k];
+            char c = b[t.at];
+            off = strict_syn.is_syntax(c) ? t.at+1
+                : strict_syn.is_quote(c) ? (t.end & ~token_index::escaped)+1
+                : t.end;
+            what = text();
+          }
+          unsigned line, col;
+          token_index::locate(b,off,line,col);
+          if (k==tk.size()) ++col;
+          std::ostringstream o;
+          o << e.what() << "\n"
+            <<"input error at line=" << line << ",col=" << col
+            << ":"<< what << std::endl;
+          throw InputError(o.str());
+        }
+      }
+    };
+
+    //! parse with the index, or as parse() does if it can't be had.
+    void indexed_parse(ark &a,const char *b,size_t n,arena *A) {
+      std::vector<token_index::entry> tk;
+      size_t m = n;
+      if (strict_index.scan(b,m,tk)) {
+        indexed_reader(b,m,tk,A).read(a);
+        return;
+      }
+      tokenizer t(b,n,strict_syn);
+      tree_builder to(A);
+      top_parse(to,&a,t);
+    }
+  }
+
+  ark parse(const std::string &s) {
+    tokenizer t(s,strict_syn);
+    ark a;
+    tree_builder to;
+    top_parse(to,&a,t);
+    return a;
+  }
+
+  ark parse(std::istream &in) {
+    tokenizer t(in,strict_syn);
+    ark a;
+    tree_builder to;
+    top_parse(to,&a,t);
+    return a;
+  }
+
+  ark parse_trusted(const char *b,size_t n,bool check) {
+    ark a;
+    if (trusted_reader(b,n,check,NULL).read(a)) return a;
+    // the usual result, or the usual error
+    tokenizer t(b,n,strict_syn);
+    ark c;
+    tree_builder to;
+    top_parse(to,&c,t);
+    return c;
+  }
+
+  const ark &parse_trusted_into(arena &A,const char *b,size_t n,bool check) {
+    ark &a = A.root();
+    if (trusted_reader(b,n,check,&A).read(a)) return a;
+    a.clear();
+    tokenizer t(b,n,strict_syn);
+    tree_builder to(&A);
+    top_parse(to,&a,t);
+    return a;
+  }
+
+  ark parse_trusted(const std::string &s,bool check) {
+    return parse_trusted(s.data(),s.size(),check);
+  }
+
+  ark parse_indexed(const char *b,size_t n) {
+    ark a;
+    indexed_parse(a,b,n,NULL);
+    return a;
+  }
+
+  ark parse_indexed(const std::string &s) {
+    return parse_indexed(s.data(),s.size());
+  }
+
+  const ark &parse_indexed_into(arena &A,const char *b,size_t n) {
+    ark &a = A.root();
+    indexed_parse(a,b,n,&A);
+    return a;
+  }
+
+  void parse(const std::string &s,handler &h) {
+    tokenizer t(s,strict_syn);
+    event_builder to(h);
+    top_parse(to,NULL,t);
+  }
+
+  void parse(std::istream &in,handler &h) {
+    tokenizer t(in,strict_syn);
+    event_builder to(h);
+    top_parse(to,NULL,t);
+  }
 }  
 
 
@@ -0,0 +1,319 @@
+#include "batch.hpp"
+
+#include <deque>
+#include <system_error>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define ARK_URING
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* Batched reads.  Each file takes a statx and an openat, submitted
+   together; once both are in, a read of the whole file (repeated if
+   it comes up short) and a close.  Operations go onto the ring as
+   room allows, and every call to the kernel submits all that are
+   waiting while it collects what has finished.  The ring is driven
+   with the raw system calls, so no library is needed. */
+
+namespace Ark {
+
+#ifdef ARK_URING
+  namespace {
+    enum op_t { Stat, Open, Read, Close };
+
+    // a read asks for no more than this at once
+    const size_t most = 1<<30;
+
+    int setup(unsigned entries,io_uring_params *p) {
+      return syscall(__NR_io_uring_setup,entries,p);
+    }
+    int enter(int fd,unsigned submit,unsigned wait) {
+      return syscall(__NR_io_uring_enter,fd,submit,wait,
+                     wait ? IORING_ENTER_GETEVENTS : 0,NULL,0);
+    }
+    int registered(int fd,unsigned what,void *arg,unsigned n) {
+      return syscall(__NR_io_uring_register,fd,what,arg,n);
+    }
+  }
+
+  struct file_batch::ring {
+    struct file {
+      const std::string *path;
+      void        *tag;
+      struct statx st;
+      int          fd;
+      int          error;
+      unsigned     waiting; // of the statx and openat
+      std::string  data;
+      size_t       got;
+    };
+
+    int          fd;
+    unsigned     entries;
+    void        *sq, *cq;
+    size_t       sq_len, cq_len;
+    unsigned    *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned    *cq_head, *cq_tail, *cq_mask;
+    io_uring_sqe *sqes;
+    io_uring_cqe *cqes;
+    unsigned     queued;   // on the ring, not yet submitted
+    unsigned     inflight; // submitted, not yet complete
+
+    std::deque<file> files;          // every file added; never moved
+    std::deque<std::pair<file *,op_t> > todo; // waiting for room
+    std::deque<file *> done;         // results to hand back
+    size_t       open;               // files added and not handed back
+
+    ring() : fd(-1), sq(MAP_FAILED), cq(MAP_FAILED), sqes(NULL),
+             queued(0), inflight(0), open(0) {}
+
+    ~ring() {
+      if (sqes) munmap(sqes,entries*sizeof(io_uring_sqe));
+      if (cq!=MAP_FAILED && cq!=sq) munmap(cq,cq_len);
+      if (sq!=MAP_FAILED) munmap(sq,sq_len);
+      if (fd!=-1) close(fd);
+    }
+
+    bool start(unsigned depth) {
+      io_uring_params p;
+      memset(&p,0,sizeof(p));
+      if ((fd = setup(depth,&p))==-1) return false;
+      entries = p.sq_entries;
+
+      // the operations needed came in 5.6, along with probing for them
+      size_t size = sizeof(io_uring_probe) + 256*sizeof(io_uring_probe_op);
+      std::string buf(size,'\0');
+      io_uring_probe *probe = (io_uring_probe *)&buf[0];
+      if (registered(fd,IORING_REGISTER_PROBE,probe,256)==-1) return false;
+      const unsigned needed[] = {
+        IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE
+      };
+      for (size_t i=0; i<sizeof(needed)/sizeof(needed[0]); ++i)
+        if (needed[i]>probe->last_op
+            || !(probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED))
+          return false;
+
+      sq_len = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+      cq_len = p.cq_off.cqes + p.cq_entries*sizeof(io_uring_cqe);
+      bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+      if (single && cq_len>sq_len) sq_len = cq_len;
+      sq = mmap(NULL,sq_len,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,
+                fd,IORING_OFF_SQ_RING);
+      if (sq==MAP_FAILED) return false;
+      cq = single ? sq
+        : mmap(NULL,cq_len,PROT_READ|PROT_WRITE,MAP_SHARED|MAP_POPULATE,
+               fd,IORING_OFF_CQ_RING);
+      if (cq==MAP_FAILED) return false;
+      void *s = mmap(NULL,entries*sizeof(io_uring_sqe),PROT_READ|PROT_WRITE,
+                     MAP_SHARED|MAP_POPULATE,fd,IORING_OFF_SQES);
+      if (s==MAP_FAILED) return false;
+      sqes = (io_uring_sqe *)s;
+
+      char *b = (char *)sq;
+      sq_head  = (unsigned *)(b + p.sq_off.head);
+      sq_tail  = (unsigned *)(b + p.sq_off.tail);
+      sq_mask  = (unsigned *)(b + p.sq_off.ring_mask);
+      sq_array = (unsigned *)(b + p.sq_off.array);
+      b = (char *)cq;
+      cq_head  = (unsigned *)(b + p.cq_off.head);
+      cq_tail  = (unsigned *)(b + p.cq_off.tail);
+      cq_mask  = (unsigned *)(b + p.cq_off.ring_mask);
+      cqes     = (io_uring_cqe *)(b + p.cq_off.cqes);
+      return true;
+    }
+
+    // put an operation on the ring; false if there's no room
+    bool put(file *f,op_t op) {
+      // keeping completions to what the ring holds
+      if (queued+inflight>=entries) return false;
+      unsigned tail = *sq_tail;
+      unsigned i = tail & *sq_mask;
+      io_uring_sqe *e = &sqes[i];
+      memset(e,0,sizeof(*e));
+      e->user_data = (unsigned long long)(uintptr_t)f | op;
+      switch (op) {
+      case Stat:
+        e->opcode = IORING_OP_STATX;
+        e->fd = AT_FDCWD;
+        e->addr = (uintptr_t)f->path->c_str();
+        e->len = STATX_TYPE|STATX_SIZE;
+        e->off = (uintptr_t)&f->st;
+        break;
+      case Open:
+        e->opcode = IORING_OP_OPENAT;
+        e->fd = AT_FDCWD;
+        e->addr = (uintptr_t)f->path->c_str();
+        e->open_flags = O_RDONLY|O_CLOEXEC;
+        break;
+      case Read: {
+        size_t n = f->data.size()-f->got;
+        e->opcode = IORING_OP_READ;
+        e->fd = f->fd;
+        e->addr = (uintptr_t)&f->data[f->got];
+        e->len = n<most ? n : most;
+        e->off = f->got;
+        break;
+      }
+      default:
+        e->opcode = IORING_OP_CLOSE;
+        e->fd = f->fd;
+        break;
+      }
+      sq_array[i] = i;
+      __atomic_store_n(sq_tail,tail+1,__ATOMIC_RELEASE);
+      ++queued;
+      return true;
+    }
+
+    void later(file *f,op_t op) {
+      if (!put(f,op)) todo.push_back(std::make_pair(f,op));
+    }
+
+    void finish(file *f) {
+      if (f->fd!=-1) later(f,Close);
+      if (f->error) f->data.clear();
+      done.push_back(f);
+    }
+
+    void complete(file *f,op_t op,int res) {
+      switch (op) {
+      case Stat:
+        if (res<0) f->error = -res;
+        else if (!S_ISREG(f->st.stx_mode)) f->error = EINVAL;
+        break;
+      case Open:
+        if (res<0) { if (!f->error) f->error = -res; }
+        else f->fd = res;
+        break;
+      case Read:
+        if (res==-EINTR || res==-EAGAIN) later(f,Read);
+        else if (res<0) {
+          f->error = -res;
+          finish(f);
+        }
+        else if (!res) {
+          // the end of a file with no size, or one that shrank while
+          // being read: what was there
+          f->data.resize(f->got);
+          finish(f);
+        }
+        else if ((f->got += res)<f->data.size()) later(f,Read);
+        else if (!f->st.stx_size) {
+          f->data.resize(2*f->data.size());
+          later(f,Read);
+        }
+        else finish(f);
+        return;
+      default:
+        return;
+      }
+      if (--f->waiting) return;
+      if (f->error) finish(f);
+      else {
+        // procfs, sysfs and some FUSE files report no size but have
+        // contents: those are read until end of file
+        f->data.resize(f->st.stx_size ? f->st.stx_size : 4096);
+        later(f,Read);
+      }
+    }
+
+    // submit what's queued; collect what's finished, waiting for
+    // something if asked to
+    void turn(bool wait) {
+      while (!todo.empty() && put(todo.front().first,todo.front().second))
+        todo.pop_front();
+      int n;
+      while ((n = enter(fd,queued,wait && inflight+queued ? 1 : 0))==-1)
+        if (errno!=EINTR && errno!=EAGAIN && errno!=EBUSY)
+          throw std::system_error(errno,std::generic_category(),
+                                  "io_uring_enter");
+      // any the kernel didn't take stay on the ring for next time
+      inflight += n;
+      queued -= n;
+
+      unsigned head = *cq_head;
+      unsigned tail = __atomic_load_n(cq_tail,__ATOMIC_ACQUIRE);
+      for (; head!=tail; ++head) {
+        io_uring_cqe *c = &cqes[head & *cq_mask];
+        unsigned long long u = c->user_data;
+        int res = c->res;
+        --inflight;
+        complete((file *)(uintptr_t)(u & ~(unsigned long long)7),
+                 (op_t)(u & 7),res);
+      }
+      __atomic_store_n(cq_head,head,__ATOMIC_RELEASE);
+    }
+  };
+#else
+  struct file_batch::ring {};
+#endif
+
+  file_batch::file_batch(unsigned depth) {
+#ifdef ARK_URING
+    R.reset(new ring);
+    if (!R->start(depth ? depth : 1)) R.reset();
+#endif
+  }
+
+  file_batch::~file_batch() {
+    // the kernel may still be writing into the files' buffers
+    try {
+      result r;
+      while (next(r)) {}
+    }
+    catch (std::system_error &) {}
+  }
+
+  void file_batch::add(const std::string &path,void *tag) {
+#ifdef ARK_URING
+    R->files.push_back(ring::file());
+    ring::file &f = R->files.back();
+    f.path = &path;
+    f.tag = tag;
+    f.fd = -1;
+    f.error = 0;
+    f.waiting = 2;
+    f.got = 0;
+    ++R->open;
+    R->later(&f,Stat);
+    R->later(&f,Open);
+#endif
+  }
+
+  size_t file_batch::pending() const {
+#ifdef ARK_URING
+    return R ? R->open : 0;
+#else
+    return 0;
+#endif
+  }
+
+  bool file_batch::next(result &r) {
+#ifdef ARK_URING
+    if (!R) return false;
+    // closes still in flight are seen to here too
+    while (R->done.empty() && (R->open || R->inflight || R->queued
+                               || !R->todo.empty()))
+      R->turn(true);
+    if (R->done.empty()) return false;
+    ring::file *f = R->done.front();
+    R->done.pop_front();
+    --R->open;
+    r.tag = f->tag;
+    r.error = f->error;
+    r.contents.swap(f->data);
+    std::string().swap(f->data);
+    return true;
+#else
+    return false;
+#endif
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef ark_batch_hpp
+#define ark_batch_hpp
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/*! \file ark/batch.hpp
+
+A file_batch reads many files at once.  On Linux it hands the kernel
+the stat, open and read of every file added through one io_uring, so
+that where each of those costs a round trip (network storage, say)
+the trips overlap instead of following one another; and it hands back
+each file's contents as soon as they are in, in whatever order they
+arrive.  The loader reads ahead with it (see loader.hpp).
+
+Where there is no io_uring (other systems, older kernels, or one that
+forbids it) ok() is false, and files have to be read some other way;
+file_source reads them one at a time.
+
+Example:
+<code>
+\verbatim
+    Ark::file_batch b;
+    if (b.ok()) {
+      for (size_t i=0; i<paths.size(); ++i) b.add(paths[i],&paths[i]);
+      Ark::file_batch::result r;
+      while (b.next(r))
+        if (!r.error) use(*(std::string *)r.tag,r.contents);
+    }
+\endverbatim
+</code>
+
+Only regular files are read; anything else fails with EINVAL, to be
+read in the usual way.  Files that report no size, as procfs and sysfs
+files do, are read until end of file.
+*/
+
+namespace Ark {
+
+  //! Reads files concurrently through io_uring.  Not thread-safe.
+  class file_batch {
+    struct ring;
+    std::unique_ptr<ring> R; //!< the ring, and the files in it.
+
+    file_batch(const file_batch &);            // not copyable
+    file_batch &operator=(const file_batch &); // not assignable
+
+  public:
+    //! a file read, or not.
+    struct result {
+      void       *tag;      //!< as given to add().
+      std::string contents; //!< what was read.
+      int         error;    //!< errno, or 0 if it was read.
+    };
+
+    /*! Constructor.  Sets up the ring, if there can be one.
+      @param depth operations in flight at most.
+    */
+    explicit file_batch(unsigned depth=256);
+    //! waits for anything still in flight.
+    ~file_batch();
+
+    //! whether io_uring is there to read with.
+    //! @return false if add() must not be used.
+    bool ok() const { return (bool)R; }
+
+    /*! read a file.  Nothing is submitted until next().
+      @param path file name; must stay valid until its result is in.
+      @param tag handed back with the result.
+    */
+    void add(const std::string &path,void *tag);
+
+    //! files added whose results haven't been handed back.
+    //! @return count.
+    size_t pending() const;
+
+    /*! submit whatever is waiting, and wait for a result.
+      @param r set to the result.
+      @return false if nothing was pending.
+    */
+    bool next(result &r);
+  };
+}
+
+#endif
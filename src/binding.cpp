@@ -0,0 +1,123 @@
+#include "binding.hpp"
+#include "exception.hpp"
+#include "tokens.hpp"
+
+#include <cstdlib>
+
+/* Bindings.  The bound superkeys are kept as a selection (see
+   select.cpp), so the parser skips what doesn't lead to them; each
+   point where a selection keeps everything below holds one value,
+   built as an ark while parsing.  A superkey is its table keys down
+   to one of those points, and the rest, looked up in that value with
+   xget() once the parse is done. */
+
+namespace Ark {
+
+  namespace {
+    // the table keys a superkey starts with, and the rest from its
+    // first index on
+    void split(const std::string &s,std::vector<std::string> &keys,
+               std::string &tail) {
+      static const tokenizer::syntax S("[].","");
+      tokenizer t(s,S);
+      if (t.next().kind()!=token::Symbol)
+        throw InputError("expecting a key symbol");
+      for (;;) {
+        if (tail.empty()) keys.push_back(t.current().text());
+        else tail += "." + t.current().text();
+        while (t.next().syntax()=='[') {
+          if (t.next().kind()!=token::Symbol)
+            throw InputError("expecting a number");
+          const std::string num = t.current().text();
+          const char *S=num.c_str();
+          char       *E=NULL;
+          strtoul(S,&E,10);
+          if (S==E || *E) throw InputError("unable to parse strange number");
+          if (t.next().syntax()!=']') throw InputError("expecting ']'");
+          tail += "[" + num + "]";
+        }
+        if (t.current().kind()==token::End) return;
+        if (t.current().syntax()!='.')
+          throw InputError("expecting '.' or '['");
+        if (t.next().kind()!=token::Symbol)
+          throw InputError("expecting a key symbol");
+      }
+    }
+  }
+
+  //protected:
+  void bindings::add(entry &e) {
+    try {
+      split(e.key,e.keys,e.tail);
+    }
+    catch (exception &x) {
+      throw InputError("unable to bind '" + e.key + "': " + x.what());
+    }
+    // a copy of this binding may share the keys
+    if (!kept) kept.reset(new selection);
+    else if (kept.use_count()>1) kept.reset(new selection(*kept));
+
+    selection *n = kept.get();
+    for (size_t i=0; i<e.keys.size() && !n->whole; ++i)
+      n = &n->keys[e.keys[i]];
+    entries.push_back(e);
+    if (n->whole) {
+      place(entries.back());
+      return;
+    }
+    n->whole = true;
+    if (n->keys.empty()) {
+      n->slot = nslots++;
+      place(entries.back());
+      return;
+    }
+    // keys below this one are now in its value
+    n->keys.clear();
+    nslots = 0;
+    number(*kept);
+    for (size_t i=0; i<entries.size(); ++i) place(entries[i]);
+  }
+
+  //private:
+  void bindings::number(selection &s) {
+    if (s.whole) s.slot = nslots++;
+    else
+      for (selection::key_map::iterator i=s.keys.begin(); i!=s.keys.end(); ++i)
+        number(i->second);
+  }
+
+  //private:
+  void bindings::place(entry &e) const {
+    const selection *n = kept.get();
+    size_t i=0;
+    while (!n->whole) n = &n->keys.find(e.keys[i++])->second;
+    e.slot = n->slot;
+    e.rest.clear();
+    for (; i<e.keys.size(); ++i) {
+      if (!e.rest.empty()) e.rest += ".";
+      e.rest += e.keys[i];
+    }
+    e.rest += e.tail;
+  }
+
+  //private:
+  void bindings::assign(void *obj,const std::vector<ark> &values) const {
+    for (size_t i=0; i<entries.size(); ++i) {
+      const entry &e = entries[i];
+      const ark *v = &values[e.slot];
+      try {
+        if (!e.rest.empty()) v = v->xget(e.rest);
+        if (v && v->kind()!=None) {
+          e.set(obj,reader(*v));
+          continue;
+        }
+      }
+      catch (exception &x) {
+        throw InputError("unable to set '" + e.key + "': " + x.what());
+      }
+      if (e.fallback) e.fallback(obj);
+      else if (e.required)
+        throw InputError("no value for required key '" + e.key + "'");
+    }
+  }
+}
@@ -0,0 +1,144 @@
+#ifndef ark_binding_hpp
+#define ark_binding_hpp
+
+#include "base.hpp"
+#include "parser.hpp"
+#include "reader.hpp"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*! \file ark/binding.hpp
+
+A binding lists superkeys and the members of a struct their values go
+into, and the parser reads keyvals straight into the struct with it:
+no ark is built for the input, only for the bound values.  Statements
+that touch no bound key are skipped the way parser::select() skips
+them, with bracketed values passed over by bracket matching, and a
+file stops being read once nothing after that point could set a bound
+key.
+
+Example:
+<code>
+\verbatim
+    struct mdsim { double temp; int steps; std::string name; };
+
+    static const Ark::binding<mdsim> B = Ark::binding<mdsim>()
+      .bind("mdsim.temp",&mdsim::temp)
+      .bind("mdsim.steps",&mdsim::steps,1000)
+      .bind_opt("mdsim.name",&mdsim::name);
+
+    mdsim m;
+    Ark::parser().parse_file(m,B,argv[1]);
+\endverbatim
+</code>
+
+Overrides, enclosures, !erase and !include work as they do in a full
+parse: each member gets the value xget() of its key would find in the
+tree, converted as reader::set() would convert it.  Members are set
+once the input has been read, so a value that is overridden is never
+converted.  A ? value counts as no value, as it does for a reader.
+*/
+
+namespace Ark {
+
+  //! Superkeys, and how to set what they hold; see binding.
+  class bindings {
+  protected:
+    //! a superkey bound.
+    struct entry {
+      std::string key;      //!< the superkey.
+      std::vector<std::string> keys; //!< its table keys up to an index.
+      std::string tail;     //!< from the index on.
+      std::string rest;     //!< below its value, for xget().
+      size_t slot;          //!< which value it is in or below.
+      bool required;        //!< missing is an error.
+      std::function<void(void *,const reader &)> set; //!< sets the member.
+      std::function<void(void *)> fallback; //!< sets a default, or empty.
+    };
+    std::vector<entry> entries;
+    std::shared_ptr<selection> kept; //!< the keys, with a slot for each value.
+    size_t nslots;                   //!< values a parse keeps.
+
+    //! add a superkey.  Throws InputError if it isn't one.
+    void add(entry &e);
+
+  private:
+    void number(selection &s);
+    void place(entry &e) const;
+
+    friend class parser;
+    //! set an object's members from the values of a parse.
+    void assign(void *obj,const std::vector<ark> &values) const;
+
+  public:
+    bindings() : nslots(0) {}
+    //! number of superkeys bound.
+    //! @return count.
+    size_t size() const { return entries.size(); }
+  };
+
+  //! Superkeys bound to members of a T.
+  template <typename T>
+  class binding : public bindings {
+  public:
+    /*! bind a required superkey; a parse without it throws.
+      @param superkey key, as ark::xget() takes it.
+      @param m the member its value goes into.
+      @return reference to this binding.
+    */
+    template <typename M>
+    binding &bind(const std::string &superkey,M T::*m) {
+      entry e;
+      e.key = superkey;
+      e.required = true;
+      e.set = [m](void *o,const reader &r) { r.set(static_cast<T *>(o)->*m); };
+      add(e);
+      return *this;
+    }
+
+    /*! bind a superkey with a default.
+      @param superkey key, as ark::xget() takes it.
+      @param m the member its value goes into.
+      @param value what the member is set to if there is no value.
+      @return reference to this binding.
+    */
+    template <typename M,typename D>
+    binding &bind(const std::string &superkey,M T::*m,const D &value) {
+      bind(superkey,m);
+      entry &e = entries.back();
+      e.required = false;
+      M d(value);
+      e.fallback = [m,d](void *o) { static_cast<T *>(o)->*m = d; };
+      return *this;
+    }
+
+    /*! bind an optional superkey; without it, the member is left as
+      it was.
+      @param superkey key, as ark::xget() takes it.
+      @param m the member its value goes into.
+      @return reference to this binding.
+    */
+    template <typename M>
+    binding &bind_opt(const std::string &superkey,M T::*m) {
+      bind(superkey,m);
+      entries.back().required = false;
+      return *this;
+    }
+  };
+
+  template <typename T>
+  void parser::parse_file(T &t,const binding<T> &b,const std::string &s) const {
+    bind_file(b,&t,s);
+  }
+
+  template <typename T>
+  void parser::parse_keyvals(T &t,const binding<T> &b,
+                             const std::string &s) const {
+    bind_text(b,&t,s.data(),s.size());
+  }
+}
+
+#endif
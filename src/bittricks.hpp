@@ -2,6 +2,7 @@
 #define ark_bittricks_hpp
 
 #include <cstdint>
+#include <cstddef>
 
 /*! \file ark/bittricks.hpp
 
@@ -25,11 +26,16 @@ namespace Ark {
     static const bits_t vector   =UINT64_C(2);
     //! a table pointer has bit  1<<61 set.
     static const bits_t table    =UINT64_C(4);
-    /* We don't have boxes anymore, but if we wanted
-       a new variant, there is room for one more.
-    //! box has all three high bits set.
-    static const bits_t box      =UINT64_C(6);
-    */
+    //! an atom whose characters belong to someone else (an arena)
+    //! has the atom and vector bits set; it never frees them.
+    static const bits_t borrowed =UINT64_C(3);
+    //! a table not parsed yet (see parser::lazy()) has the vector
+    //! and table bits set.
+    static const bits_t deferred_table  =UINT64_C(6);
+    //! a vector not parsed yet has all three bits set.
+    static const bits_t deferred_vector =UINT64_C(7);
+    //! both deferred kinds have these bits set; nothing else does.
+    static const bits_t deferred =UINT64_C(6);
 
     /*! mask the bits.
       @param b bits to mask.
@@ -43,7 +49,9 @@ namespace Ark {
   }
 
   /*! A string storage device optimized to take up
-    minimal space for short strings.
+    minimal space for short strings.  Characters on the heap are
+    never changed in place, so copies share them, preceded by a count
+    of their holders.
   */
   struct atom_storage_t {
     //! variadic pointer: either bits or a char *.
@@ -53,7 +61,8 @@ namespace Ark {
     };
     ptr_t u; //!< member bits.
 
-    //! if the ptr field is active deallocate the large string.
+    //! if the ptr field is active let go of the large string, which
+    //! is deallocated when no other storage holds it.
     void destroy();
 
     //! Copy string from a C-string.  Does not deallocate.  For use
@@ -61,6 +70,34 @@ namespace Ark {
     //! @param c C-string.
     void init(const char *c);
 
+    //! Copy n characters, which must not include a NUL.  Does not
+    //! deallocate.
+    //! @param c characters.
+    //! @param n number of characters.
+    void init(const char *c,size_t n);
+
+    //! Initialize to the empty string without allocating.  Does not
+    //! deallocate.
+    void init_empty();
+
+    //! Refer to characters owned elsewhere, which must be
+    //! NUL-terminated, 8-byte aligned and outlive this storage.  Does
+    //! not deallocate, and destroy() will not free them either.
+    //! @param c C-string.
+    void borrow(const char *c);
+
+    //! Hold the same characters as another storage, counting one more
+    //! holder of them; borrowed characters are copied.  Does not
+    //! deallocate.
+    //! @param o other storage.
+    void share(const atom_storage_t &o);
+
+    //! exchange contents with another storage; never allocates.
+    //! @param o other storage.
+    void swap(atom_storage_t &o) {
+      bitmasks::bits_t b = u.bits; u.bits = o.u.bits; o.u.bits = b;
+    }
+
     //! return a C-style string.
     //! @return a C-string.
     const char *c_str() const;
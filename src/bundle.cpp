@@ -0,0 +1,89 @@
+#include "exception.hpp"
+#include "parser.hpp"
+
+#include <cstring>
+#include <ostream>
+
+/* A bundle is a file and everything it includes, packed so that the
+   parser needs one open and one read instead of a round trip to the
+   filesystem per include.  The format is text:
+
+     #!arkbundle 1
+     #@ <length> <path>
+     <length bytes of the file>
+     #@ <length> <path>
+     ...
+
+   with a newline after each file's bytes.  The first section is the
+   bundled file itself; the rest are its includes, each under the path
+   include_file() would have opened, so lookups, !file values and error
+   messages match the loose files. */
+
+namespace Ark {
+
+  namespace {
+    const char magic[] = "#!arkbundle 1\n";
+    const size_t magic_len = sizeof(magic)-1;
+
+    void malformed(const char *what) {
+      std::string s("malformed bundle: ");
+      throw InputError(s + what);
+    }
+  }
+
+  //private:
+  bool parser::is_bundle(const char *b,size_t n) {
+    return n>=magic_len && memcmp(b,magic,magic_len)==0;
+  }
+
+  //private:
+  const std::string *parser::index_bundle(const char *b,size_t n,
+                                          bundle_map &m) {
+    if (!is_bundle(b,n)) return NULL;
+    const char *p = b+magic_len, *e = b+n;
+    const std::string *top = NULL;
+    while (p!=e) {
+      if (e-p<3 || memcmp(p,"#@ ",3)) malformed("expecting a section");
+      p += 3;
+      size_t len=0;
+      const char *digits = p;
+      for (; p!=e && *p>='0' && *p<='9'; ++p) {
+        if (len > (size_t(-1)-9)/10) malformed("section too long");
+        len = len*10 + (*p-'0');
+      }
+      if (p==digits || p==e || *p!=' ') malformed("expecting a length");
+      const char *name = ++p;
+      p = static_cast<const char *>(memchr(p,'\n',e-p));
+      if (!p || p==name) malformed("expecting a path");
+      std::string path(name,p++);
+      if (size_t(e-p) < len+1 || p[len]!='\n') malformed("section too short");
+      std::pair<bundle_map::iterator,bool> r =
+        m.insert(bundle_map::value_type(path,std::string_view(p,len)));
+      if (!r.second) malformed("repeated path");
+      if (!top) top = &r.first->first;
+      p += len+1;
+    }
+    if (!top) malformed("no sections");
+    return top;
+  }
+
+  //public:
+  void parser::write_bundle(std::ostream &out,const std::string &s) const {
+    file_texts files;
+    parser rec(*this);
+    rec.bundling = &files;
+    ark scratch;
+    rec.parse_file(scratch,s);
+
+    out << magic;
+    for (size_t i=0; i<files.size(); ++i) {
+      const std::string &path = files[i].first;
+      const std::string &text = files[i].second;
+      if (path.find('\n')!=std::string::npos)
+        throw InputError("cannot bundle a path with a newline: " + path);
+      out << "#@ " << text.size() << ' ' << path << '\n';
+      out.write(text.data(),text.size());
+      out << '\n';
+    }
+  }
+}
@@ -0,0 +1,93 @@
+#include "cache.hpp"
+
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#include <sys/stat.h>
+
+namespace Ark {
+
+  namespace {
+    struct entry {
+      include_cache::stamp             st;
+      std::shared_ptr<const script_t>  script;
+    };
+
+    // constructed on first use, so parsers in static initializers
+    // can use the cache too
+    std::mutex &lock() {
+      static std::mutex m;
+      return m;
+    }
+    std::map<std::string,entry> &entries() {
+      static std::map<std::string,entry> m;
+      return m;
+    }
+
+    std::atomic<size_t> nhits(0), nmisses(0);
+  }
+
+  bool include_cache::stat(const std::string &path,stamp &st) {
+    struct stat s;
+    if (::stat(path.c_str(),&s)==-1 || !S_ISREG(s.st_mode)) return false;
+    st.dev  = s.st_dev;
+    st.ino  = s.st_ino;
+    st.size = s.st_size;
+    st.sec  = s.st_mtim.tv_sec;
+    st.nsec = s.st_mtim.tv_nsec;
+    return true;
+  }
+
+  bool include_cache::check(const std::string &path,std::string &key,
+                            stamp &st) {
+    if (!stat(path,st)) return false;
+    char buf[PATH_MAX];
+    if (!realpath(path.c_str(),buf)) return false;
+    // !file values depend on how the path was spelled
+    key = std::string(buf) + '\0' + path;
+    return true;
+  }
+
+  std::shared_ptr<const script_t>
+  include_cache::find(const std::string &key,const stamp &st) {
+    std::lock_guard<std::mutex> g(lock());
+    std::map<std::string,entry>::const_iterator i = entries().find(key);
+    if (i!=entries().end() && i->second.st==st) {
+      ++nhits;
+      return i->second.script;
+    }
+    ++nmisses;
+    return std::shared_ptr<const script_t>();
+  }
+
+  void include_cache::store(const std::string &key,const stamp &st,
+                            std::shared_ptr<const script_t> s) {
+    std::lock_guard<std::mutex> g(lock());
+    entry &e = entries()[key];
+    e.st = st;
+    e.script = std::move(s);
+  }
+
+  size_t include_cache::hits() { return nhits; }
+  size_t include_cache::misses() { return nmisses; }
+
+  size_t include_cache::size() {
+    std::lock_guard<std::mutex> g(lock());
+    return entries().size();
+  }
+
+  void include_cache::clear() {
+    std::lock_guard<std::mutex> g(lock());
+    entries().clear();
+  }
+
+  void include_cache::reset() {
+    std::lock_guard<std::mutex> g(lock());
+    entries().clear();
+    nhits = 0;
+    nmisses = 0;
+  }
+}
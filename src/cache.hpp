@@ -0,0 +1,92 @@
+#ifndef ark_cache_hpp
+#define ark_cache_hpp
+
+#include "script.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/*! \file ark/cache.hpp
+
+The include cache keeps parsed include files in memory, so that a file
+!included many times (a shared forcefield table included by every
+replica, say) is read and parsed once per process.  Parsers use it
+once parser::cache_includes() is turned on; a cached file is replayed
+into the including table with the same override and !erase semantics,
+and the same error messages, as a fresh parse.
+
+Entries are keyed by canonical path, together with the path as it
+was spelled (relative !file values are resolved against it), and
+checked against the file's device, inode, size and modification time
+on every use, so a file that changes on disk is parsed again.  The
+cache is shared by every parser in the process and may be used from
+several threads at once.
+
+Example:
+<code>
+\verbatim
+    Ark::parser P;
+    P.cache_includes(true);
+    for (int i=0; i<n; ++i) P.parse_file(replicas[i],"forcefield.ark");
+    printf("%zu hits\n", Ark::include_cache::hits());
+\endverbatim
+</code>
+*/
+
+namespace Ark {
+
+  class parser;
+
+  //! Process-wide cache of parsed include files.  Thread-safe.
+  class include_cache {
+  public:
+    //! what a file looked like when it was parsed.
+    typedef file_stamp stamp;
+
+    /*! stat a file.
+      @param path file name.
+      @param st set to the file's stamp.
+      @return false unless path names a regular file.
+    */
+    static bool stat(const std::string &path,stamp &st);
+
+  private:
+    friend class parser;
+
+
+    /*! canonicalize a path and stat the file it names.
+      @param path file name.
+      @param key set to the canonical path and path itself.
+      @param st set to the file's stamp.
+      @return false unless path names a regular file.
+    */
+    static bool check(const std::string &path,std::string &key,stamp &st);
+    /*! the cached statements for key, if they were parsed from st.
+      Counts a hit or a miss.
+      @return the statements, or NULL.
+    */
+    static std::shared_ptr<const script_t> find(const std::string &key,
+                                                const stamp &st);
+    //! remember the statements parsed from key as it was at st.
+    static void store(const std::string &key,const stamp &st,
+                      std::shared_ptr<const script_t> s);
+
+  public:
+    //! lookups that found a current entry.
+    //! @return count since the process started or reset() was called.
+    static size_t hits();
+    //! lookups that had to read and parse the file.
+    //! @return count since the process started or reset() was called.
+    static size_t misses();
+    //! files held.
+    //! @return number of entries.
+    static size_t size();
+    //! drop every entry.
+    static void clear();
+    //! drop every entry and zero the counters.
+    static void reset();
+  };
+}
+
+#endif
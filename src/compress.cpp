@@ -0,0 +1,371 @@
+#include "compress.hpp"
+#include "exception.hpp"
+
+#include <cstring>
+#include <vector>
+
+#ifdef ARK_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef ARK_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+/* Compressed streams.  Each direction is a streambuf that works a
+   chunk at a time: inflate_buf reads compressed bytes from its source
+   and hands out what they inflate to, and deflate_buf compresses what
+   is written to it whenever its buffer fills, and at the end. */
+
+namespace Ark {
+
+  namespace {
+    const size_t chunk = 1<<16;
+
+    std::string library(compression_t z) {
+      return z==Gzip ? "zlib (ARK_WITH_ZLIB)" : "zstd (ARK_WITH_ZSTD)";
+    }
+    std::string format(compression_t z) {
+      return z==Gzip ? "gzip" : "zstd";
+    }
+
+    // a buffer read as a stream
+    struct span_buf : public std::streambuf {
+      span_buf(const char *b,size_t n) {
+        char *p = const_cast<char *>(b);
+        setg(p,p,p+n);
+      }
+    };
+
+    class inflate_buf : public std::streambuf {
+      std::streambuf   *src;   // compressed bytes
+      compression_t     kind;
+      std::vector<char> in;    // bytes read from src
+      size_t            at,end;// the ones not inflated yet
+      std::vector<char> out;   // what they inflated to
+      bool              drained; // src has nothing more
+      bool              ended;   // at the end of a compressed file
+#ifdef ARK_WITH_ZLIB
+      z_stream          z;
+#endif
+#ifdef ARK_WITH_ZSTD
+      ZSTD_DStream     *d;
+#endif
+
+      bool fill() {
+        if (drained) return false;
+        std::streamsize n = src->sgetn(in.data(),in.size());
+        at = 0;
+        end = n>0 ? n : 0;
+        drained = !end;
+        return end;
+      }
+
+      // the input is over: fine between compressed files, not in one
+      size_t over() const {
+        if (!ended) throw InputError(format(kind) + " data is cut short");
+        return 0;
+      }
+
+      size_t inflate_some() {
+#ifdef ARK_WITH_ZLIB
+        z.next_out = (Bytef *)out.data();
+        z.avail_out = out.size();
+        while (z.avail_out == out.size()) {
+          if (at==end && !fill()) return over();
+          if (ended) {
+            // another file follows
+            inflateReset(&z);
+            ended = false;
+          }
+          z.next_in = (Bytef *)&in[at];
+          z.avail_in = end-at;
+          int r = inflate(&z,Z_NO_FLUSH);
+          at = end-z.avail_in;
+          if (r==Z_STREAM_END) ended = true;
+          else if (r!=Z_OK && !(r==Z_BUF_ERROR && at==end))
+            throw InputError(std::string("gzip data is corrupt: ")
+                             + (z.msg ? z.msg : zError(r)));
+        }
+        return out.size()-z.avail_out;
+#else
+        return 0;
+#endif
+      }
+
+      size_t zstd_some() {
+#ifdef ARK_WITH_ZSTD
+        ZSTD_outBuffer o = { out.data(), out.size(), 0 };
+        while (!o.pos) {
+          if (at==end && !fill()) return over();
+          ZSTD_inBuffer i = { &in[at], end-at, 0 };
+          size_t r = ZSTD_decompressStream(d,&o,&i);
+          at += i.pos;
+          if (ZSTD_isError(r))
+            throw InputError(std::string("zstd data is corrupt: ")
+                             + ZSTD_getErrorName(r));
+          ended = !r;
+        }
+        return o.pos;
+#else
+        return 0;
+#endif
+      }
+
+    public:
+      explicit inflate_buf(std::streambuf *s)
+        : src(s), kind(Uncompressed), in(chunk), at(0), end(0),
+          drained(false), ended(true) {
+        // enough to recognize it
+        while (end<4 && !drained) {
+          std::streamsize n = src->sgetn(&in[end],in.size()-end);
+          if (n>0) end += n;
+          else drained = true;
+        }
+        kind = compression_of(in.data(),end);
+        if (!compression_supported(kind))
+          throw InputError(format(kind) + " data, but ark was built without "
+                           + library(kind));
+        if (kind!=Uncompressed) out.resize(chunk);
+        ended = kind==Uncompressed;
+#ifdef ARK_WITH_ZLIB
+        if (kind==Gzip) {
+          memset(&z,0,sizeof(z));
+          // gzip or zlib headers
+          if (inflateInit2(&z,15+32)!=Z_OK)
+            throw InputError("can't start inflating gzip data");
+        }
+#endif
+#ifdef ARK_WITH_ZSTD
+        d = NULL;
+        if (kind==Zstd && !(d = ZSTD_createDStream()))
+          throw InputError("can't start inflating zstd data");
+#endif
+      }
+
+      ~inflate_buf() {
+#ifdef ARK_WITH_ZLIB
+        if (kind==Gzip) inflateEnd(&z);
+#endif
+#ifdef ARK_WITH_ZSTD
+        if (d) ZSTD_freeDStream(d);
+#endif
+      }
+
+      compression_t compression() const { return kind; }
+
+    protected:
+      int_type underflow() {
+        if (gptr()<egptr()) return traits_type::to_int_type(*gptr());
+        size_t n = 0;
+        switch (kind) {
+        case Uncompressed:
+          // hand over the bytes as they were read
+          if (at==end && !fill()) return traits_type::eof();
+          setg(&in[at],&in[at],&in[end]);
+          at = end;
+          return traits_type::to_int_type(*gptr());
+        case Gzip:
+          n = inflate_some();
+          break;
+        case Zstd:
+          n = zstd_some();
+          break;
+        }
+        if (!n) return traits_type::eof();
+        setg(out.data(),out.data(),out.data()+n);
+        return traits_type::to_int_type(*gptr());
+      }
+    };
+
+    class deflate_buf : public std::streambuf {
+      std::ostream     *dst;
+      compression_t     kind;
+      std::vector<char> in, out;
+      bool              finished;
+#ifdef ARK_WITH_ZLIB
+      z_stream          z;
+#endif
+#ifdef ARK_WITH_ZSTD
+      ZSTD_CStream     *c;
+#endif
+
+      // compress what has been written, and end the data if last
+      void put(bool last) {
+        const char *b = pbase();
+        size_t n = pptr()-pbase();
+        setp(in.data(),in.data()+in.size());
+        switch (kind) {
+        case Uncompressed:
+          dst->write(b,n);
+          break;
+        case Gzip: {
+#ifdef ARK_WITH_ZLIB
+          z.next_in = (Bytef *)b;
+          z.avail_in = n;
+          int r;
+          do {
+            z.next_out = (Bytef *)out.data();
+            z.avail_out = out.size();
+            r = deflate(&z,last ? Z_FINISH : Z_NO_FLUSH);
+            if (r==Z_STREAM_ERROR) throw exception("gzip compression failed");
+            dst->write(out.data(),out.size()-z.avail_out);
+          } while (z.avail_out==0 || (last && r!=Z_STREAM_END));
+#endif
+          break;
+        }
+        case Zstd: {
+#ifdef ARK_WITH_ZSTD
+          ZSTD_inBuffer i = { b, n, 0 };
+          size_t r;
+          do {
+            ZSTD_outBuffer o = { out.data(), out.size(), 0 };
+            r = ZSTD_compressStream2(c,&o,&i,last ? ZSTD_e_end : ZSTD_e_continue);
+            if (ZSTD_isError(r))
+              throw exception(std::string("zstd compression failed: ")
+                              + ZSTD_getErrorName(r));
+            dst->write(out.data(),o.pos);
+          } while (i.pos<i.size || (last && r));
+#endif
+          break;
+        }
+        }
+      }
+
+    public:
+      deflate_buf(std::ostream &o,compression_t k,int level)
+        : dst(&o), kind(k), in(chunk), finished(false) {
+        if (!compression_supported(kind))
+          throw exception("can't write " + format(kind)
+                          + ": ark was built without " + library(kind));
+        if (kind!=Uncompressed) out.resize(chunk);
+        setp(in.data(),in.data()+in.size());
+#ifdef ARK_WITH_ZLIB
+        if (kind==Gzip) {
+          memset(&z,0,sizeof(z));
+          // with a gzip header
+          if (deflateInit2(&z,level ? level : Z_DEFAULT_COMPRESSION,
+                           Z_DEFLATED,15+16,8,Z_DEFAULT_STRATEGY)!=Z_OK)
+            throw exception("can't start gzip compression");
+        }
+#endif
+#ifdef ARK_WITH_ZSTD
+        c = NULL;
+        if (kind==Zstd) {
+          if (!(c = ZSTD_createCStream()))
+            throw exception("can't start zstd compression");
+          if (level) ZSTD_CCtx_setParameter(c,ZSTD_c_compressionLevel,level);
+          // so that damage is found, as gzip's CRC finds it
+          ZSTD_CCtx_setParameter(c,ZSTD_c_checksumFlag,1);
+        }
+#endif
+      }
+
+      ~deflate_buf() {
+#ifdef ARK_WITH_ZLIB
+        if (kind==Gzip) deflateEnd(&z);
+#endif
+#ifdef ARK_WITH_ZSTD
+        if (c) ZSTD_freeCStream(c);
+#endif
+      }
+
+      void finish() {
+        if (finished) return;
+        finished = true;
+        put(true);
+        setp(NULL,NULL);
+        dst->flush();
+      }
+
+    protected:
+      int_type overflow(int_type ch) {
+        if (finished) return traits_type::eof();
+        put(false);
+        if (!traits_type::eq_int_type(ch,traits_type::eof())) {
+          *pptr() = traits_type::to_char_type(ch);
+          pbump(1);
+        }
+        return traits_type::not_eof(ch);
+      }
+
+      int sync() {
+        if (finished) return 0;
+        put(false);
+        dst->flush();
+        return dst->good() ? 0 : -1;
+      }
+    };
+  }
+
+  compression_t compression_of(const char *b,size_t n) {
+    const unsigned char *p = (const unsigned char *)b;
+    if (n>=2 && p[0]==0x1f && p[1]==0x8b) return Gzip;
+    if (n>=4 && p[0]==0x28 && p[1]==0xb5 && p[2]==0x2f && p[3]==0xfd)
+      return Zstd;
+    return Uncompressed;
+  }
+
+  compression_t compression_for(const std::string &path) {
+    size_t n = path.size();
+    if (n>3 && !path.compare(n-3,3,".gz")) return Gzip;
+    if (n>4 && !path.compare(n-4,4,".zst")) return Zstd;
+    return Uncompressed;
+  }
+
+  bool compression_supported(compression_t z) {
+    switch (z) {
+    case Gzip:
+#ifdef ARK_WITH_ZLIB
+      return true;
+#else
+      return false;
+#endif
+    case Zstd:
+#ifdef ARK_WITH_ZSTD
+      return true;
+#else
+      return false;
+#endif
+    default:
+      return true;
+    }
+  }
+
+  inflater::inflater(const char *b,size_t n)
+    : std::istream(NULL), from(new span_buf(b,n)),
+      buf(new inflate_buf(from.get())) {
+    rdbuf(buf.get());
+    // so that a read meeting bad data throws what it met
+    exceptions(std::ios::badbit);
+  }
+
+  inflater::inflater(std::istream &in)
+    : std::istream(NULL), buf(new inflate_buf(in.rdbuf())) {
+    rdbuf(buf.get());
+    exceptions(std::ios::badbit);
+  }
+
+  inflater::~inflater() {}
+
+  compression_t inflater::compression() const {
+    return static_cast<inflate_buf *>(buf.get())->compression();
+  }
+
+  deflater::deflater(std::ostream &out,compression_t z,int level)
+    : std::ostream(NULL), buf(new deflate_buf(out,z,level)) {
+    rdbuf(buf.get());
+  }
+
+  deflater::~deflater() {
+    try {
+      finish();
+    }
+    catch (...) {
+      setstate(std::ios::badbit);
+    }
+  }
+
+  void deflater::finish() {
+    static_cast<deflate_buf *>(buf.get())->finish();
+  }
+}
@@ -0,0 +1,117 @@
+#ifndef ark_compress_hpp
+#define ark_compress_hpp
+
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <string>
+
+/*! \file ark/compress.hpp
+
+Files compressed with gzip or zstd are read wherever the parser reads
+a file: parse_file(), !include, the loader and arkget all recognize
+them by their first bytes, and tokenize them as they are inflated, a
+piece at a time, so the text is never all in memory at once.  Output
+is compressed by writing through a deflater, or with
+printer::printer_ref::save() to a file named *.gz or *.zst.
+
+Each library is optional: zlib is used if the library is built with
+ARK_WITH_ZLIB defined, and zstd if ARK_WITH_ZSTD is.  Without it,
+input in that format is an InputError saying so, and a deflater for
+it throws an exception.
+
+Example:
+<code>
+\verbatim
+    Ark::parser().parse_file(a,"trajectory.ark.zst");
+
+    std::ofstream f("state.ark.gz");
+    Ark::deflater z(f,Ark::Gzip);
+    z << Ark::printer().no_delim(1)(a);
+    z.finish();
+\endverbatim
+</code>
+
+Compressed files are parsed by a single thread, and aren't deferred
+by lazy parsing or read as bundles.
+*/
+
+namespace Ark {
+
+  //! how a file is compressed.
+  enum compression_t {
+    Uncompressed, //!< not at all.
+    Gzip,         //!< with gzip (or zlib).
+    Zstd          //!< with zstd.
+  };
+
+  /*! recognize compressed data by its first bytes.
+    @param b start of the data.
+    @param n its length.
+    @return how it is compressed.
+  */
+  compression_t compression_of(const char *b,size_t n);
+
+  /*! how a file of this name would be compressed.
+    @param path file name.
+    @return Gzip for *.gz, Zstd for *.zst, else Uncompressed.
+  */
+  compression_t compression_for(const std::string &path);
+
+  /*! whether the library was built to read and write a format.
+    @param z the format.
+    @return true if it can.
+  */
+  bool compression_supported(compression_t z);
+
+  /*! An input stream of the data in a buffer or another stream,
+    inflated as it is read if it is compressed, and passed through as
+    it is if not.  Corrupt or truncated data throws InputError from
+    whichever read meets it.  Concatenated compressed files read as
+    one.
+  */
+  class inflater : public std::istream {
+    std::unique_ptr<std::streambuf> from; //!< the buffer, if reading one.
+    std::unique_ptr<std::streambuf> buf;  //!< inflates from the source.
+
+  public:
+    /*! read a buffer.
+      @param b start of the data; must outlive the inflater.
+      @param n its length.
+    */
+    inflater(const char *b,size_t n);
+    /*! read a stream.
+      @param in stream to read; must outlive the inflater.
+    */
+    explicit inflater(std::istream &in);
+    ~inflater();
+
+    //! how the data is compressed.
+    //! @return format.
+    compression_t compression() const;
+  };
+
+  /*! An output stream that compresses what is written to it onto
+    another stream.
+  */
+  class deflater : public std::ostream {
+    std::unique_ptr<std::streambuf> buf; //!< compresses onto the target.
+
+  public:
+    /*! Constructor.
+      @param out stream to write to; must outlive the deflater.
+      @param z format; Uncompressed passes the data through.
+      @param level compression level, or 0 for the library's default.
+    */
+    deflater(std::ostream &out,compression_t z,int level=0);
+    //! finish(), but no exceptions; failures set badbit instead.
+    ~deflater();
+
+    //! write everything still held, and end the compressed data.
+    //! Nothing can be written after.
+    void finish();
+  };
+}
+
+#endif
@@ -0,0 +1,210 @@
+#include "exception.hpp"
+#include "feeder.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+/* Parsing text that comes in pieces.  A quick look at each new piece
+   follows strings, escapes, comments and brackets, to find the last
+   point at top level where every token before it is whole.  The text
+   up to there is compiled into statements (see script.hpp), each
+   applied as soon as it is complete; a statement that runs into the
+   end of that text is compiled again once more text comes. */
+
+namespace Ark {
+
+  namespace {
+    // where look() has to stop in plain text, in strings and in comments
+    const charset plain_stops("{}[]#\"'`",9);
+    const charset comment_end("\n",2);
+    const charset dquote_end("\"\\",3);
+    const charset squote_end("'\\",3);
+    const charset bquote_end("`\\",3);
+
+    const charset &quote_end(char q) {
+      switch (q) {
+      case '\'': return squote_end;
+      case '`':  return bquote_end;
+      default:   return dquote_end;
+      }
+    }
+
+    // bytes that end a token in every keyvals syntax
+    bool breaks(char c) {
+      return scan::space.contains(c) || c=='<' || c=='>';
+    }
+  }
+
+  feeder::feeder(ark &A,const parser &p,const std::string &file)
+    : P(p), a(&A), name(file), used(0), line(1), col(0), mode(Plain),
+      quote(0), depth(0), seen(0), ready(0), tried(0), ended(false),
+      broken(false) {
+    P.current_file = name.empty() ? NULL : name.c_str();
+    a->be(Table);
+  }
+
+  //private:
+  void feeder::look() {
+    const char *b = buf.data(), *p = b+seen, *e = b+buf.size();
+    while (p!=e) {
+      const char *q;
+      switch (mode) {
+      case Plain:
+        q = plain_stops.find_first_of(p,e);
+        if (!depth) {
+          const char *r = q;
+          while (r!=p && !breaks(r[-1])) --r;
+          if (r!=p) ready = r-b;
+        }
+        if (q==e) { p = e; break; }
+        p = q+1;
+        switch (*q) {
+        case '\0':
+          // the text ends here
+          ended = true;
+          buf.resize(q-b);
+          seen = buf.size();
+          return;
+        case '#':
+          mode = Comment;
+          break;
+        case '"': case '\'': case '`':
+          mode = Quoted;
+          quote = *q;
+          break;
+        case '{': case '[':
+          if (!depth++) ready = q-b;
+          break;
+        default: // '}' or ']'
+          if (depth) --depth;
+          if (!depth) ready = q+1-b;
+          break;
+        }
+        break;
+      case Quoted:
+        q = quote_end(quote).find_first_of(p,e);
+        if (q==e) { p = e; break; }
+        if (!*q) { p = q; mode = Plain; break; } // ends the text
+        p = q+1;
+        if (*q=='\\') mode = Escaped;
+        else {
+          mode = Plain;
+          if (!depth) ready = p-b;
+        }
+        break;
+      case Escaped:
+        if (!*p) { mode = Plain; break; }
+        ++p;
+        mode = Quoted;
+        break;
+      case Comment:
+        q = comment_end.find_first_of(p,e);
+        if (q==e) { p = e; break; }
+        if (!*q) { p = q; mode = Plain; break; }
+        p = q+1;
+        mode = Plain;
+        if (!depth) ready = p-b;
+        break;
+      }
+    }
+    seen = buf.size();
+  }
+
+  //private:
+  void feeder::drop(size_t n) {
+    const char *b = buf.data(), *e = b+n;
+    line += std::count(b,e,'\n');
+    const char *s = e;
+    while (s!=b && s[-1]!='\n') --s;
+    col = (s==b) ? col+n : e-s;
+    used += n;
+    buf.erase(0,n);
+    seen -= n;
+    ready = ready>n ? ready-n : 0;
+    tried = tried>n ? tried-n : 0;
+  }
+
+  //private:
+  std::string feeder::spell(const statement &s) const {
+    std::ostringstream o;
+    const ark *p = a;
+    for (size_t j=0; j<s.path.size(); ++j) {
+      const statement::step &k = s.path[j];
+      if (!k.key.empty()) {
+        if (j) o << '.';
+        o << k.key;
+        p = p && p->kind()==Table ? p->get(k.key) : NULL;
+      }
+      else {
+        size_t n = p && p->kind()==Vector ? p->vector().size() : 0;
+        size_t i = k.append ? n : k.offset;
+        o << '[' << i << ']';
+        p = i<n ? &p->vector()[i] : NULL;
+      }
+    }
+    return o.str();
+  }
+
+  //private:
+  void feeder::parse(size_t n,bool last) {
+    const char *b = buf.data();
+    tokenizer t(b,n,parser::no_syn,line,col);
+    size_t end = 0; // just past the last keyval applied
+    for (;;) {
+      statement s;
+      try {
+        if (t.next(parser::key_syn).kind()==token::End) {
+          end = n;
+          break;
+        }
+        P.compile_keyvalue(s,t);
+      }
+      catch (exception &e) {
+        // it may yet be finished
+        if (!last && t.current().kind()==token::End) break;
+        broken = true;
+        std::ostringstream o;
+        o << e.what() << "\n"
+          << "parse problem at " << (name.empty() ? "???" : name.c_str())
+          << ":" << t.lineno() << ":" << t.colno();
+        // a direct parse from the same keyval says why, as it would
+        // have for all of the text at once; it goes into a copy, which
+        // shares a's nodes, so a keeps no part of the failing keyval
+        drop(end);
+        tokenizer r(buf.data(),n-end,parser::no_syn,line,col);
+        ark scratch(*a);
+        P.parse_keyvals(scratch,r);
+        throw InputError(o.str());
+      }
+      done.push_back(spell(s));
+      try {
+        P.apply(*a,s);
+      }
+      catch (...) {
+        broken = true;
+        throw;
+      }
+      end = t.position()-b;
+    }
+    drop(end);
+    tried = ready;
+  }
+
+  const std::vector<std::string> &feeder::feed(const char *b,size_t n) {
+    if (broken) throw InputError("feeder used after an error");
+    done.clear();
+    if (ended) return done;
+    buf.append(b,n);
+    look();
+    if (ready > tried) parse(ready,false);
+    return done;
+  }
+
+  const std::vector<std::string> &feeder::finish() {
+    if (broken) throw InputError("feeder used after an error");
+    done.clear();
+    parse(buf.size(),true);
+    return done;
+  }
+}
@@ -0,0 +1,110 @@
+#ifndef ark_feeder_hpp
+#define ark_feeder_hpp
+
+#include "parser.hpp"
+
+#include <string>
+#include <vector>
+
+/*! \file ark/feeder.hpp
+
+A feeder parses keyvals text handed to it in pieces, as it arrives
+from a pipe or socket, without ever blocking for more.  Each call to
+feed() parses whatever top-level keyvals the text so far completes,
+applies them to the ark, and says which they were; the rest is kept
+until more text, or finish(), comes.  Pieces may break the text
+anywhere: inside a key, a string, an escape or a comment.
+
+Example:
+<code>
+\verbatim
+    Ark::ark a;
+    Ark::feeder f(a);
+    while ((n = read(fd,buf,sizeof(buf))) > 0)
+      for (const std::string &k : f.feed(buf,n))
+        publish(k,*a.xget(k));
+    f.finish();
+\endverbatim
+</code>
+
+The result, and any error, is what parser::parse_keyvals() gives for
+all of the text at once, with lines and columns counted from the
+start of it.  Keyvals are applied as parse_keyvals() applies them;
+the parser's select(), lazy(), threads() and cache settings don't
+apply, though included files go through the include cache if the
+parser uses it.  After an error the feeder can't be used again.
+*/
+
+namespace Ark {
+
+  //! Parses keyvals text fed to it in pieces.
+  class feeder {
+    parser      P;      //!< compiles and applies.
+    ark        *a;      //!< what the keyvals go into.
+    std::string name;   //!< for messages and relative paths.
+    std::string buf;    //!< text not parsed yet.
+    size_t      used;   //!< bytes before buf, already parsed.
+    unsigned    line,col; //!< where buf starts.
+    std::vector<std::string> done; //!< what the last call completed.
+
+    // how far the text has been looked at, and what was there
+    enum { Plain, Quoted, Escaped, Comment } mode; //!< at the end of buf.
+    char        quote;  //!< the quote of an open string.
+    unsigned    depth;  //!< brackets open at the end of buf.
+    size_t      seen;   //!< bytes of buf looked at.
+    size_t      ready;  //!< end of the last token at top level.
+    size_t      tried;  //!< ready when buf was last parsed.
+    bool        ended;  //!< a NUL ended the text.
+    bool        broken; //!< an error was thrown.
+
+    void look();
+    void parse(size_t n,bool last);
+    void drop(size_t n);
+    std::string spell(const statement &s) const;
+
+  public:
+    /*! Constructor.  a becomes a table, if it isn't one.
+      @param a ark to parse into; must outlive the feeder.
+      @param p parser to compile and apply with.
+      @param file file name used in error messages and to resolve
+      relative !include and !file paths; may be empty.
+    */
+    explicit feeder(ark &a,const parser &p=parser(),
+                    const std::string &file=std::string());
+    feeder(const feeder &) = delete;
+    feeder &operator=(const feeder &) = delete;
+
+    /*! take more text, and parse the keyvals it completes.
+      @param b start of the text.
+      @param n its length.  A NUL ends the text, as it does for
+      parse_keyvals(); anything fed after it is ignored.
+      @return the superkey of each keyval applied, in order and
+      spelled as ark::xget() takes it, with a "[+]" given as the index
+      it became; an !include gives an empty string, as it may have
+      changed anything.  Valid until the next call.
+    */
+    const std::vector<std::string> &feed(const char *b,size_t n);
+    /*! feed() of a string.
+      @param s the text.
+      @return as for feed(const char*,size_t).
+    */
+    const std::vector<std::string> &feed(const std::string &s) {
+      return feed(s.data(),s.size());
+    }
+
+    /*! the text is over: parse what is left of it, throwing any error
+      that parse_keyvals() would at the end of its input.
+      @return as for feed().
+    */
+    const std::vector<std::string> &finish();
+
+    //! bytes taken so far and parsed into keyvals.
+    //! @return count.
+    size_t parsed() const { return used; }
+    //! bytes taken so far and waiting for the rest of a keyval.
+    //! @return count.
+    size_t pending() const { return buf.size(); }
+  };
+}
+
+#endif
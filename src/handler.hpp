@@ -0,0 +1,99 @@
+#ifndef ark_handler_hpp
+#define ark_handler_hpp
+
+#include "base.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+/*! \file ark/handler.hpp
+
+Both grammars can be parsed without building an ark: a handler is
+told what the parser reads, in input order, and keeps what it likes.
+This suits consumers that walk the input once (indexers, validators,
+converters) and have no use for the tree.
+
+A value is told as on_atom(), on_none(), begin_table() followed by the
+table's keyvals and end_table(), or begin_vector() followed by the
+elements and end_vector().  In the strict grammar a keyval is an
+on_key() followed by the value.  In the parser grammar a keyval is its
+superkey, as on_key() and on_index() calls, followed by its value, by
+on_erase(), or, for an enclosure, by begin_enclosure(), the keyvals
+inside and end_enclosure().  The top level of a keyvals input is told
+as its keyvals alone.  Includes are followed and told in place, and a
+!file value is told as the path it names.
+
+Nothing is merged: a later keyval that overrides, extends or erases
+an earlier one is told as it is read, and the strict grammar's check
+for duplicate keys is left to the handler.  Payloads point into the
+parser's buffers and are only good during the call.
+
+Example:
+<code>
+\verbatim
+    struct counter : Ark::handler {
+      size_t atoms = 0;
+      void on_atom(std::string_view) { ++atoms; }
+    } c;
+    Ark::parser().parse_file(c,argv[1]);
+\endverbatim
+</code>
+*/
+
+namespace Ark {
+
+  /*! What a parse tells.  Every callback does nothing by default.  A
+    callback may throw an Ark::exception, which ends the parse and
+    comes out with the input position, just as a syntax error does.
+  */
+  class handler {
+  public:
+    //! the index on_index() is given for "[+]".
+    static const size_t append = size_t(-1);
+
+    virtual ~handler() {}
+
+    //! a string value.
+    //! @param s its text, unquoted.
+    virtual void on_atom(std::string_view s) {}
+    //! a ? value.
+    virtual void on_none() {}
+    //! a table value starts.
+    virtual void begin_table() {}
+    //! the table value ends.
+    virtual void end_table() {}
+    //! a vector value starts.
+    virtual void begin_vector() {}
+    //! the vector value ends.
+    virtual void end_vector() {}
+
+    //! a key, or the next step of a superkey.
+    //! @param k the key.
+    virtual void on_key(std::string_view k) {}
+    //! the next step of a superkey is a vector index.
+    //! @param i the index, or append for "[+]".
+    virtual void on_index(size_t i) {}
+    //! the superkey just told is erased.
+    virtual void on_erase() {}
+    //! an enclosure of the superkey just told starts.
+    virtual void begin_enclosure() {}
+    //! the enclosure ends.
+    virtual void end_enclosure() {}
+  };
+
+  /*! parse the input stream with the strict grammar (see
+    ark::parse()), telling a handler.
+    @param in input stream.
+    @param h handler.
+  */
+  void parse(std::istream &in,handler &h);
+  /*! parse a string with the strict grammar, telling a handler.
+    @param s input string.
+    @param h handler.
+  */
+  void parse(const std::string &s,handler &h);
+}
+
+#endif
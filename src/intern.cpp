@@ -0,0 +1,193 @@
+#include "intern.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Interning.  Values are looked up bottom up: the elements of a table
+   or vector are interned before it, so two tables or vectors are
+   equal when their keys are and their elements are the very same kept
+   values, which is a comparison of addresses.  A value whose node or
+   characters are kept already is known by that address alone, so
+   interning a tree again, or a copy of one interned before with a few
+   changes, only looks into what is new. */
+
+namespace Ark {
+
+  namespace {
+    void mix(size_t &h,size_t x) {
+      h ^= x + UINT64_C(0x9e3779b97f4a7c15) + (h<<6) + (h>>2);
+    }
+
+    // what tells kept values apart: their node or characters
+    const void *id(const ark &a) {
+      switch (a.kind()) {
+      case Atom:   return a.atom().c_str();
+      case Vector: return &a.vector();
+      case Table:  return &a.table();
+      default:     return NULL;
+      }
+    }
+
+    // bytes of a's own node or characters, without its elements; the
+    // count of holders in front of each is a size_t (see base.cpp)
+    size_t own(const ark &a) {
+      switch (a.kind()) {
+      case Atom: {
+        size_t n = strlen(a.atom().c_str());
+        return n ? sizeof(size_t)+n+1 : 0;
+      }
+      case Vector:
+        return sizeof(size_t)+sizeof(vector_t)
+          + a.vector().capacity()*sizeof(ark);
+      case Table: {
+        const table_t &t = a.table();
+        // a map node is three links and a colour besides its pair
+        size_t n = sizeof(size_t)+sizeof(table_t)
+          + t.size()*(4*sizeof(void *)+sizeof(table_t::value_type));
+        for (const table_t::value_type &e : t)
+          if (e.first.size() > std::string().capacity()) n += e.first.size()+1;
+        return n;
+      }
+      default:
+        return 0;
+      }
+    }
+  }
+
+  //private:
+  // the kept value equal to a, or NULL if a holds it already; h is
+  // set to its hash
+  const ark *interner::find(const ark &a,size_t &h) {
+    kind_t k = a.kind();
+    h = k;
+    if (k==None) return NULL;
+    std::unordered_map<const void *,size_t>::const_iterator
+      i = known.find(id(a));
+    if (i!=known.end()) {
+      h = i->second;
+      return NULL;
+    }
+    typedef std::unordered_multimap<size_t,ark>::iterator iterator;
+    std::pair<iterator,iterator> r;
+
+    if (k==Atom) {
+      std::string_view s(a.atom().c_str());
+      mix(h,std::hash<std::string_view>()(s));
+      for (r = values.equal_range(h); r.first!=r.second; ++r.first)
+        if (r.first->second.kind()==Atom
+            && s==r.first->second.atom().c_str()) {
+          _saved += own(a);
+          return &r.first->second;
+        }
+      return kept_unless_own(a,h);
+    }
+
+    // each element, as kept
+    std::vector<const ark *> e;
+    bool kept = true;
+    if (k==Vector) {
+      const vector_t &v = a.vector();
+      e.reserve(v.size());
+      for (const ark &x : v) {
+        size_t xh;
+        const ark *f = find(x,xh);
+        e.push_back(f ? f : &x);
+        kept = kept && !f;
+        mix(h,xh);
+      }
+      for (r = values.equal_range(h); r.first!=r.second; ++r.first) {
+        const ark &c = r.first->second;
+        if (c.kind()!=Vector || c.vector().size()!=e.size()) continue;
+        size_t j=0;
+        while (j<e.size() && id(c.vector()[j])==id(*e[j])) ++j;
+        if (j<e.size()) continue;
+        _saved += own(a);
+        return &c;
+      }
+    }
+    else {
+      const table_t &t = a.table();
+      e.reserve(t.size());
+      for (const table_t::value_type &x : t) {
+        size_t xh;
+        const ark *f = find(x.second,xh);
+        e.push_back(f ? f : &x.second);
+        kept = kept && !f;
+        mix(h,std::hash<std::string>()(x.first.str()));
+        mix(h,xh);
+      }
+      for (r = values.equal_range(h); r.first!=r.second; ++r.first) {
+        const ark &c = r.first->second;
+        if (c.kind()!=Table || c.table().size()!=e.size()) continue;
+        size_t j=0;
+        table_t::const_iterator x=c.table().begin(), y=t.begin();
+        for (; j<e.size() && x->first==y->first && id(x->second)==id(*e[j]);
+             ++j, ++x, ++y) ;
+        if (j<e.size()) continue;
+        _saved += own(a);
+        return &c;
+      }
+    }
+    if (kept) return kept_unless_own(a,h);
+
+    // a copy of a holding the kept elements
+    ark c(a);
+    size_t j=0;
+    if (k==Vector)
+      for (ark &x : c.vector()) {
+        if (id(x)!=id(*e[j])) x = *e[j];
+        ++j;
+      }
+    else
+      for (table_t::value_type &x : c.table()) {
+        if (id(x.second)!=id(*e[j])) x.second = *e[j];
+        ++j;
+      }
+    return &keep(c,h);
+  }
+
+  //private:
+  const ark &interner::keep(const ark &a,size_t h) {
+    const ark &k = values.emplace(h,a)->second;
+    known.emplace(id(k),h);
+    return k;
+  }
+
+  //private:
+  // keep a; the kept value, or NULL if a shares it (it may not, if
+  // a's characters are borrowed)
+  const ark *interner::kept_unless_own(const ark &a,size_t h) {
+    const ark &k = keep(a,h);
+    return id(k)==id(a) ? NULL : &k;
+  }
+
+  //private:
+  void interner::atom(ark &a,std::string_view s) {
+    size_t h = Atom;
+    mix(h,std::hash<std::string_view>()(s));
+    typedef std::unordered_multimap<size_t,ark>::iterator iterator;
+    std::pair<iterator,iterator> r = values.equal_range(h);
+    for (; r.first!=r.second; ++r.first)
+      if (r.first->second.kind()==Atom && s==r.first->second.atom().c_str()) {
+        a = r.first->second;
+        if (!s.empty()) _saved += sizeof(size_t)+s.size()+1;
+        return;
+      }
+    a.be_atom(s,NULL);
+    keep(a,h);
+  }
+
+  size_t interner::intern(ark &a) {
+    size_t before=_saved, h;
+    if (const ark *r = find(a,h)) a = *r;
+    return _saved-before;
+  }
+
+  void interner::clear() {
+    values.clear();
+    known.clear();
+  }
+}
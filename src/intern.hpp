@@ -0,0 +1,83 @@
+#ifndef ark_intern_hpp
+#define ark_intern_hpp
+
+#include "base.hpp"
+
+#include <cstddef>
+#include <string_view>
+#include <unordered_map>
+
+/*! \file ark/intern.hpp
+
+An interner makes equal values share their storage.  Every table,
+vector and atom it is given is looked up among the values it has seen
+before, and one that is already there is replaced by a copy of the
+one kept, which, as for any copy, shares its nodes and characters
+(see ark).  Generated configurations that repeat the same small tables
+and atoms thousands of times then take memory in proportion to their
+distinct content.
+
+Example:
+<code>
+\verbatim
+    Ark::interner I;
+    Ark::ark topology;
+    Ark::parser().intern(&I).parse_file(topology,"topology.ark");
+    printf("%zu bytes saved\n", I.saved());
+\endverbatim
+</code>
+
+Interned values are ordinary arks: changing one through a non-const
+accessor copies the node changed, as for any shared subtree.  The
+interner holds one copy of every distinct value it has seen until it
+is cleared or destroyed, so it is meant to live for a parse or a
+batch of them.  It is not thread-safe.
+*/
+
+namespace Ark {
+
+  struct tree_builder;
+
+  //! Shares equal subtrees and atoms; see intern.hpp.
+  class interner {
+    //! every distinct value seen, by hash.
+    std::unordered_multimap<size_t,ark> values;
+    //! the node or characters of each value kept, with its hash.
+    std::unordered_map<const void *,size_t> known;
+    size_t _saved; //!< bytes of the duplicates replaced.
+
+    interner(const interner &);            // not copyable
+    interner &operator=(const interner &); // not assignable
+
+    const ark *find(const ark &a,size_t &h);
+    const ark &keep(const ark &a,size_t h);
+    const ark *kept_unless_own(const ark &a,size_t h);
+
+    friend struct tree_builder;
+    //! make a an atom holding s, shared with an equal one if kept.
+    void atom(ark &a,std::string_view s);
+
+  public:
+    interner() : _saved(0) {}
+
+    /*! share a's value, and everything below it, with equal values
+      interned before.  Deferred subtrees are parsed.
+      @param a the ark.
+      @return bytes taken by duplicates that a no longer holds.
+    */
+    size_t intern(ark &a);
+
+    //! bytes saved so far, counted as the nodes and characters of
+    //! the duplicates replaced.
+    //! @return count.
+    size_t saved() const { return _saved; }
+    //! number of distinct values kept.
+    //! @return count.
+    size_t size() const { return values.size(); }
+    //! let go of every value kept; values interned before are not
+    //! shared with values interned after.
+    void clear();
+  };
+}
+
+#endif
@@ -2,6 +2,8 @@
 #define __ark_key_hpp
 
 #include <string>
+#include <string_view>
+#include <utility>
 
 namespace Ark {
 
@@ -17,6 +19,8 @@ namespace Ark {
     std::string _s;
     // key must be of the form [a-zA-Z0-9_][a-zA-Z0-9_:-]*
     void check_valid_key() const;
+    struct no_check {};
+    key_t(std::string_view s,no_check) : _s(s) {}
 
   public:
     static bool valid_key(std::string const& s);
@@ -35,6 +39,28 @@ namespace Ark {
     */
     key_t(const char *s) : _s(s) { check_valid_key(); }
 
+    /*! Constructor.  Checks validity of the string value, taking over
+      its storage.
+      @param s C++-string.
+    */
+    key_t(std::string &&s) : _s(std::move(s)) { check_valid_key(); }
+
+    /*! A key from a string already known to be valid, such as one
+      printed from another key; no check is made.
+      @param s the key.
+      @return the key.
+    */
+    static key_t unchecked(std::string_view s) { return key_t(s,no_check()); }
+
+    //! Copy.
+    key_t(const key_t &) = default;
+    //! Move; keys are already valid so no check is made.
+    key_t(key_t &&) noexcept = default;
+    //! Assignment.
+    key_t &operator=(const key_t &) = default;
+    //! Move assignment.
+    key_t &operator=(key_t &&) noexcept = default;
+
     //! get a C++-string.
     //! @return a C++-string.
     const std::string &str() const { return _s; }
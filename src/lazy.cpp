@@ -0,0 +1,209 @@
+#include "compress.hpp"
+#include "exception.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+
+/* Lazy parsing.  A file parsed with parser::lazy() is mapped and
+   indexed once: a pass over its bytes pairs every '{' and '[' with
+   the bracket that closes it.  When the parser then meets a table or
+   vector in value position it makes a deferred node that remembers
+   the bracketed bytes, and skips to the closing bracket.  The first
+   access that needs the contents parses them with the same parser
+   settings, deferring any values nested inside in turn. */
+
+namespace Ark {
+
+  namespace {
+    const size_t npos = size_t(-1);
+    // smaller values are cheaper to parse than to defer
+    const size_t min_deferred = 256;
+
+    // the bytes the index has to look at
+    const charset stops("{}[]#\"'`",9);
+    const charset comment_end("\n",2);
+    const charset dquote_end("\"\\",3);
+    const charset squote_end("'\\",3);
+    const charset bquote_end("`\\",3);
+  }
+
+  struct lazy_input {
+    file_source src;   //!< the file's bytes.
+    std::string file;  //!< its path, as include_file() formed it.
+    parser settings;   //!< how to parse it, without lazy_in.
+    //! offset of each '{' and '[' with that of the bracket closing
+    //! it, or npos, in input order.
+    std::vector<std::pair<size_t,size_t> > brackets;
+
+    explicit lazy_input(const std::string &path) : src(path), file(path) {}
+
+    /* Pair up brackets.  Quotes and comments are skipped just as the
+       tokenizer skips them, and, as for the tokenizer, a NUL ends the
+       input.  A stray or mismatched closing bracket or an unterminated
+       string ends the index: brackets still open there, and any after
+       it, are parsed eagerly, so the parse reports the problem as
+       usual. */
+    void index() {
+      const char *b=src.data(), *p=b, *e=b+src.size();
+      std::vector<size_t> open;
+      while ((p = stops.find_first_of(p,e)) != e) {
+        char c = *p;
+        switch (c) {
+        case '\0':
+          return;
+        case '#':
+          p = comment_end.find_first_of(p,e);
+          break;
+        case '"': case '\'': case '`': {
+          const charset &ends = c=='"' ? dquote_end
+                              : c=='\'' ? squote_end : bquote_end;
+          for (++p; ; p+=2) {
+            p = ends.find_first_of(p,e);
+            if (p==e || *p!='\\' || p+1==e) break;
+          }
+          if (p==e || *p!=c) return;
+          ++p;
+          break;
+        }
+        case '{': case '[':
+          open.push_back(brackets.size());
+          brackets.push_back(std::make_pair(size_t(p-b),npos));
+          ++p;
+          break;
+        default: // '}' or ']'
+          if (open.empty() || b[brackets[open.back()].first]!=(c=='}'?'{':'['))
+            return;
+          brackets[open.back()].second = p-b;
+          open.pop_back();
+          ++p;
+        }
+      }
+    }
+
+    //! offset of the bracket closing the one at o, or npos.
+    size_t close(size_t o) const {
+      std::vector<std::pair<size_t,size_t> >::const_iterator i =
+        std::lower_bound(brackets.begin(),brackets.end(),
+                         std::make_pair(o,size_t(0)));
+      return (i==brackets.end() || i->first!=o) ? npos : i->second;
+    }
+  };
+
+  struct deferred_t {
+    std::shared_ptr<const lazy_input> in; //!< the file.
+    size_t         begin,end; //!< offsets of the brackets, end past.
+    unsigned       line,col;  //!< where the opening bracket is.
+    std::once_flag once;      //!< guards value.
+    ark            value;     //!< the contents, once parsed.
+
+    deferred_t(const std::shared_ptr<const lazy_input> &i,size_t b,size_t e,
+               unsigned l,unsigned c)
+      : in(i), begin(b), end(e), line(l), col(c) {}
+
+    //! make a an unparsed table or vector.
+    static void attach(ark &a,deferred_t *d,bool table) {
+      a.clear();
+      a.u.deferred = d;
+      a.mask(table ? bitmasks::deferred_table : bitmasks::deferred_vector);
+    }
+
+    //! parse the bracketed bytes into value.
+    void expand() {
+      parser p(in->settings);
+      p.lazy_in = in;
+      tokenizer t(in->src.data()+begin,end-begin,parser::no_syn,line,col);
+      ark v;
+      try {
+        t.next(parser::val_syn);
+        p.parse_bracket(v,t);
+        if (t.next().kind() != token::End)
+          throw InputError("extra stuff after the value");
+      }
+      catch (exception &e) {
+        std::ostringstream o;
+        o << "unable to parse file: " << in->file << "\n"
+          << e.what() << "\n"
+          << "parse problem at " << in->file
+          << ":" << t.lineno() << ":" << t.colno();
+        throw InputError(o.str());
+      }
+      value.swap(v);
+    }
+  };
+
+  //private:
+  const ark &ark::forced() const {
+    deferred_t *d = unmasked().deferred;
+    std::call_once(d->once,&deferred_t::expand,d);
+    return d->value;
+  }
+
+  //private:
+  void ark::undefer(bool keep) {
+    deferred_t *d = unmasked().deferred;
+    if (keep) forced(); // may throw, leaving this as it was
+    u.bits = bitmasks::none;
+    if (keep) std::swap(u,d->value.u);
+    delete d;
+  }
+
+  //private:
+  void parser::parse_lazy(ark &a) const {
+    std::shared_ptr<lazy_input> in(new lazy_input(current_file));
+    const char *b = in->src.data();
+    size_t n = in->src.size();
+
+    // compressed files and bundles are read eagerly
+    if (compression_of(b,n)) {
+      inflater z(b,n);
+      tokenizer t(z,no_syn);
+      parse_keyvals(a,t);
+      return;
+    }
+    bundle_map sections;
+    if (const std::string *top = index_bundle(b,n,sections)) {
+      parser tmp(*this);
+      std::string_view s = sections.find(*top)->second;
+      tmp.bundled = &sections;
+      tmp.current_file = top->c_str();
+      tmp.parse_text(a,s.data(),s.size());
+      return;
+    }
+
+    in->index();
+    in->settings = *this;
+    in->settings.current_file = in->file.c_str();
+    in->settings.preloaded = NULL;
+    in->settings.deps = NULL;
+    in->settings.graph = NULL;
+    in->settings.bundled = NULL;
+    in->settings.bundling = NULL;
+    in->settings.dedup = NULL;
+
+    parser tmp(in->settings);
+    tmp.lazy_in = in;
+    tmp.parse_text(a,b,n);
+  }
+
+  //private:
+  bool parser::defer(ark &a,tokenizer &t) const {
+#ifdef ANARKY_NOW
+    // deferred nodes don't carry annotations
+    return false;
+#endif
+    const char *b = lazy_in->src.data();
+    const char *o = t.current().view().data();
+    if (o<b || o>=b+lazy_in->src.size()) return false; // not from the file
+    size_t c = lazy_in->close(o-b);
+    if (c==npos || c-(o-b) < min_deferred) return false;
+
+    deferred_t::attach(a,new deferred_t(lazy_in,o-b,c+1,
+                                        t.lineno(),t.colno()-1),
+                       *o=='{');
+    t.skip_to(b+c+1);
+    return true;
+  }
+}
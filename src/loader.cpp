@@ -0,0 +1,282 @@
+#include "batch.hpp"
+#include "compress.hpp"
+#include "exception.hpp"
+#include "loader.hpp"
+#include "source.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace Ark {
+
+  loader::loader(const parser &p) : P(p) {}
+
+  loader &loader::include(const std::string &path) {
+    source s;
+    s.kind = source::File;
+    s.text = path;
+    s.in   = NULL;
+    sources.push_back(s);
+    return *this;
+  }
+
+  loader &loader::keyvals(const std::string &text) {
+    source s;
+    s.kind = source::Text;
+    s.text = text;
+    s.in   = NULL;
+    sources.push_back(s);
+    return *this;
+  }
+
+  loader &loader::keyvals(std::istream &in) {
+    source s;
+    s.kind = source::Stream;
+    s.in   = &in;
+    sources.push_back(s);
+    return *this;
+  }
+
+  namespace {
+    // include_file() refuses to include from deeper than this
+    const unsigned max_depth = 20;
+
+    // something to parse ahead of time
+    struct job {
+      const std::string *path;  // file name, or NULL for text
+      const std::string *text;  // the text, if not a file
+      compiled_t        *out;
+      unsigned           depth; // include depth of its contents
+      std::string       *bytes; // the file's contents, if read ahead
+    };
+
+    // the files a script includes, as written
+    void includes(const script_t &s,std::vector<std::string> &files) {
+      for (size_t i=0; i<s.size(); ++i) {
+        if (s[i].op==statement::Include) files.push_back(s[i].file);
+        else includes(s[i].body,files);
+      }
+    }
+  }
+
+  ark &loader::load(ark &a) const {
+    unsigned nt = P.threads() ? P.threads() : std::thread::hardware_concurrency();
+#ifdef ANARKY_NOW
+    nt = 1; // statements don't carry annotations
+#endif
+    // snapshots load in turn faster than files can be read ahead
+    if (nt < 2 || !P.cachedir.empty()) {
+      for (size_t i=0; i<sources.size(); ++i) {
+        const source &s = sources[i];
+        switch (s.kind) {
+        case source::File:   P.parse_file(a,s.text);    break;
+        case source::Text:   P.parse_keyvals(a,s.text); break;
+        case source::Stream: P.parse_keyvals(a,*s.in);  break;
+        }
+      }
+      return a;
+    }
+
+    include_map             files;
+    std::vector<compiled_t> texts(sources.size());
+    std::deque<job>         queue;
+    std::mutex              lock;
+    std::condition_variable ready;
+    size_t                  busy=0;
+    std::exception_ptr      fatal;
+
+    // with io_uring, this thread reads every file, and the others
+    // parse what it has read
+    file_batch              batch;
+    std::deque<job>         unread;  // files for it to read
+    std::deque<job>         reading; // read or being read
+    std::deque<std::string> contents;
+    size_t                  reads=0; // files not yet read
+
+    // a file or text to parse, under the lock
+    auto want = [&](const job &j) {
+      if (j.path && batch.ok()) {
+        unread.push_back(j);
+        ++reads;
+      }
+      else queue.push_back(j);
+    };
+
+    for (size_t i=0; i<sources.size(); ++i) {
+      const source &s = sources[i];
+      if (s.kind==source::File) {
+        // parse_file() names it as given, and parses it one level down
+        include_map::iterator f = files.find(s.text);
+        if (f!=files.end()) continue;
+        f = files.insert(include_map::value_type(s.text,compiled_t())).first;
+        job j = { &f->first, NULL, &f->second, 1, NULL };
+        want(j);
+      }
+      else if (s.kind==source::Text) {
+        job j = { NULL, &s.text, &texts[i], 0, NULL };
+        want(j);
+      }
+    }
+
+    // parse the job at the front of the queue, with the lock held;
+    // false if that ended in a fatal error
+    auto step = [&](std::unique_lock<std::mutex> &g) {
+      job j = queue.front();
+      queue.pop_front();
+      ++busy;
+      g.unlock();
+
+      std::vector<std::string> found;
+      try {
+        parser w(P);
+        w.nthreads = 1;
+        w.dedup = NULL; // interned as it is applied, below
+        w.include_depth = j.depth;
+        if (j.path) {
+          w.current_file = j.path->c_str();
+          std::unique_ptr<file_source> in;
+          if (!j.bytes) in.reset(new file_source(*j.path));
+          const char *b = in ? in->data() : j.bytes->data();
+          size_t n = in ? in->size() : j.bytes->size();
+          if (parser::is_bundle(b,n))
+            throw InputError("bundles are read in turn");
+          if (compression_of(b,n)) {
+            inflater z(b,n);
+            tokenizer t(z,parser::no_syn);
+            w.compile(j.out->script,t);
+          }
+          else {
+            tokenizer t(b,n,parser::no_syn);
+            w.compile(j.out->script,t);
+          }
+        }
+        else {
+          tokenizer t(*j.text,parser::no_syn);
+          w.compile(j.out->script,t);
+        }
+        j.out->ok = true;
+        if (j.depth <= max_depth) includes(j.out->script,found);
+      }
+      catch (exception &) {
+        // left for include_file() to report in turn
+        j.out->script.clear();
+      }
+      catch (...) {
+        g.lock();
+        if (!fatal) fatal = std::current_exception();
+        --busy;
+        ready.notify_all();
+        return false;
+      }
+      if (j.bytes) std::string().swap(*j.bytes);
+
+      g.lock();
+      for (size_t i=0; i<found.size(); ++i) {
+        std::string path = parser::pathify(found[i],j.path ? j.path->c_str()
+                                                         : P.current_file);
+        if (files.find(path)!=files.end()) continue;
+        include_map::iterator f =
+          files.insert(include_map::value_type(path,compiled_t())).first;
+        job k = { &f->first, NULL, &f->second, j.depth+1, NULL };
+        want(k);
+      }
+      --busy;
+      ready.notify_all();
+      return true;
+    };
+
+    auto work = [&]() {
+      std::unique_lock<std::mutex> g(lock);
+      for (;;) {
+        while (queue.empty() && (busy || reads) && !fatal)
+          ready.wait(g);
+        if (queue.empty() || fatal) { ready.notify_all(); return; }
+        if (!step(g)) return;
+      }
+    };
+
+    // submit reads for the files found, and queue what has been read
+    auto drive = [&]() {
+      std::unique_lock<std::mutex> g(lock);
+      while (!fatal) {
+        while (!unread.empty()) {
+          reading.push_back(unread.front());
+          unread.pop_front();
+          batch.add(*reading.back().path,&reading.back());
+        }
+        if (batch.pending()) {
+          g.unlock();
+          file_batch::result r;
+          batch.next(r);
+          g.lock();
+          --reads;
+          job &j = *(job *)r.tag;
+          if (r.error) {
+            // left for include_file() to report in turn
+            j.out->script.clear();
+            ready.notify_all();
+            continue;
+          }
+          contents.push_back(std::move(r.contents));
+          j.bytes = &contents.back();
+          queue.push_back(j);
+          ready.notify_all();
+        }
+        // nothing to read: help parse
+        else if (!queue.empty()) step(g);
+        else if (busy) ready.wait(g);
+        else break;
+      }
+      ready.notify_all();
+    };
+
+    std::vector<std::thread> threads;
+    try {
+      for (unsigned i=1; i<nt; ++i) threads.emplace_back(work);
+    }
+    catch (std::system_error &) {
+      // make do with the threads we have
+    }
+    try {
+      if (batch.ok()) drive();
+      else work();
+    }
+    catch (...) {
+      std::unique_lock<std::mutex> g(lock);
+      if (!fatal) fatal = std::current_exception();
+      ready.notify_all();
+    }
+    for (size_t i=0; i<threads.size(); ++i) threads[i].join();
+    if (fatal) std::rethrow_exception(fatal);
+
+    // apply everything in order
+    parser R(P);
+    R.preloaded = &files;
+    for (size_t i=0; i<sources.size(); ++i) {
+      const source &s = sources[i];
+      switch (s.kind) {
+      case source::File:
+        R.parse_file(a,s.text);
+        break;
+      case source::Text:
+        if (texts[i].ok) {
+          script_t &t = texts[i].script;
+          a.be(Table);
+          for (size_t j=0; j<t.size(); ++j) R.apply(a,t[j]);
+        }
+        else R.parse_keyvals(a,s.text);
+        break;
+      case source::Stream:
+        R.parse_keyvals(a,*s.in);
+        break;
+      }
+    }
+    R.intern_built(a);
+    return a;
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef ark_loader_hpp
+#define ark_loader_hpp
+
+#include "parser.hpp"
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/*! \file ark/loader.hpp
+
+A loader builds one ark from a list of keyvals sources, the files and
+text given by --include and --cfg options, with the same result as
+parsing each of them in turn with parser::parse_file() or
+parser::parse_keyvals().  It gets there faster when the sources pull
+in many files: before applying anything it reads and parses every
+source, and every file they !include (directly or through other
+included files), on a pool of threads, so the opens and reads overlap
+instead of following one another.  On Linux the files are read
+through io_uring (see batch.hpp): the calling thread submits the
+stat, open and read of every file known so far in one batch, and the
+pool parses each file as its contents come in, so that new includes
+join the next batch.  Without io_uring the pool's threads read the
+files themselves.
+
+Example:
+<code>
+\verbatim
+    Ark::ark a;
+    Ark::loader(Ark::parser().threads(8))
+      .include("base.ark")
+      .keyvals("mdsim.last_time = 100")
+      .load(a);
+\endverbatim
+</code>
+
+Files that fail to read or parse ahead of time are read again when
+their turn comes, so errors are reported exactly as a serial parse
+would report them.
+*/
+
+namespace Ark {
+
+  //! Parses keyvals sources, and the files they include, concurrently.
+  class loader {
+    //! a file, a string, or a stream (read in turn, never ahead).
+    struct source {
+      enum { File, Text, Stream } kind;
+      std::string   text; //!< file name or keyvals.
+      std::istream *in;   //!< the stream.
+    };
+
+    parser              P;       //!< parses and applies.
+    std::vector<source> sources; //!< in the order given.
+
+  public:
+    /*! Constructor.
+      @param p parser to use.  Its threads() setting is the number of
+      threads that read and parse, with 0 meaning one per core; if it
+      is 1, or a cache_dir() is set, the sources are simply parsed in
+      turn.
+    */
+    explicit loader(const parser &p=parser());
+
+    /*! add a file, as parser::parse_file() reads it.
+      @param path file name.
+      @return reference to this loader.
+    */
+    loader &include(const std::string &path);
+
+    /*! add keyvals text, as parser::parse_keyvals() reads it.
+      @param text keyvals.
+      @return reference to this loader.
+    */
+    loader &keyvals(const std::string &text);
+
+    /*! add a stream of keyvals, read when its turn comes.
+      @param in input stream; must stay valid until load() returns.
+      @return reference to this loader.
+    */
+    loader &keyvals(std::istream &in);
+
+    /*! parse every source into an ark, in the order they were added.
+      @param a input ark.
+      @return reference to a.
+    */
+    ark &load(ark &a) const;
+  };
+}
+
+#endif
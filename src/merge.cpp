@@ -11,4 +11,22 @@ namespace Ark {
     return *this;
   }
 
+  ark &ark::merge(ark &&b) {
+    if (kind()==b.kind() && kind()==Table) {
+      // a table b shares is copied from, which shares its elements,
+      // rather than copied whole to be moved from
+      const ark &r = b.resolved();
+      if (holders(r.unmasked().table).load(std::memory_order_acquire)!=1)
+        return merge(r);
+      table_t &t = table();
+      for (table_t::value_type &e : b.table()) {
+        table_t::iterator i=t.find(e.first);
+        if (i==t.end()) t.emplace(e.first,std::move(e.second));
+        else            i->second.merge(std::move(e.second));
+      }
+    }
+    else *this = std::move(b);
+    return *this;
+  }
+
 }
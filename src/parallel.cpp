@@ -0,0 +1,203 @@
+#include "exception.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+/* Parsing large keyvals inputs on several threads.  A prescan splits
+   the input between top-level keyvals, threads compile the pieces
+   into statements, and the statements are applied in input order on
+   the calling thread. */
+
+namespace Ark {
+
+  namespace {
+    // smaller inputs aren't worth the threads
+    const size_t min_parallel = size_t(1)<<20;
+    // nor are smaller pieces
+    const size_t min_piece = size_t(1)<<18;
+
+    // the bytes the prescan has to look at, at and below top level
+    const charset top_stops("{}[]=#\"'`\n",11);
+    const charset inner_stops("{}[]#\"'`",9);
+    const charset comment_end("\n",2);
+    const charset dquote_end("\"\\",3);
+    const charset squote_end("'\\",3);
+    const charset bquote_end("`\\",3);
+
+    /* Find offsets, about every `every' bytes, where one top-level
+       keyval ends and the next begins.  A '}' that closes a top-level
+       bracket always ends a keyval (a table value or an enclosure),
+       and so does a ']' that closes a vector value; other ']'s close
+       indices in superkeys.  A value that is a single token ends its
+       keyval too, so a newline after one, followed by what can start
+       a key, is a place to cut flat inputs of "a.b.c = v" lines.
+       Quotes and comments are skipped just as the tokenizer skips
+       them.  If the input looks malformed the scan stops early, or a
+       cut lands inside a keyval: the piece holding the problem then
+       fails to compile and the caller falls back to a serial parse. */
+    std::vector<size_t> split(const char *b,size_t n,size_t every) {
+      std::vector<size_t> cuts;
+      const char *p=b, *e=b+n;
+      const char *eq=NULL;    // just past the last top-level '=', or
+                              // the comments after it
+      unsigned depth=0;
+      bool value=false;       // the open top-level bracket is a value
+      size_t next=every;
+      while ((p = (depth ? inner_stops : top_stops).find_first_of(p,e)) != e) {
+        char c = *p;
+        switch (c) {
+        case '\0':
+          return cuts;        // input ends here
+        case '#': {
+          const char *h = p;
+          p = comment_end.find_first_of(p,e);
+          if (eq && scan::space.find_first_not_of(eq,h)==h) eq = p;
+          break;
+        }
+        case '\n': {
+          // after "key = value", unless the value is still to come
+          ++p;
+          if (!eq || scan::space.find_first_not_of(eq,p)==p) break;
+          eq = NULL;
+          const char *k = scan::space.find_first_not_of(p,e);
+          if (size_t(p-b)>=next && k!=e
+              && (*k=='!' || !(parser::key_syn.is_reserved(*k)
+                               || parser::key_syn.is_quote(*k)
+                               || *k=='#' || *k=='\0'))) {
+            cuts.push_back(p-b);
+            next = p-b+every;
+          }
+          break;
+        }
+        case '"': case '\'': case '`': {
+          const charset &ends = c=='"' ? dquote_end
+                              : c=='\'' ? squote_end : bquote_end;
+          for (++p; ; p+=2) {
+            p = ends.find_first_of(p,e);
+            if (p==e || *p!='\\' || p+1==e) break;
+          }
+          if (p==e || *p!=c) return cuts;
+          ++p;
+          break;
+        }
+        case '=':
+          eq = ++p;
+          break;
+        case '{': case '[':
+          if (!depth++)
+            value = c=='{' || (eq && scan::space.find_first_not_of(eq,p)==p);
+          ++p;
+          break;
+        default: // '}' or ']'
+          ++p;
+          if (!depth) return cuts;
+          if (--depth) break;
+          eq = NULL;
+          if (value && size_t(p-b)>=next && p!=e) {
+            cuts.push_back(p-b);
+            next = p-b+every;
+          }
+          break;
+        }
+      }
+      return cuts;
+    }
+
+    // a piece of the input, with its starting line and column
+    struct piece {
+      const char *b;
+      size_t      n;
+      unsigned    line,col;
+      script_t    script;
+      bool        failed;
+    };
+  }
+
+  //private:
+  bool parser::parse_parallel(ark &a,const char *b,size_t n) const {
+#ifdef ANARKY_NOW
+    // statements don't carry annotations
+    return false;
+#endif
+    if (n < min_parallel) return false;
+    unsigned nt = nthreads ? nthreads : std::thread::hardware_concurrency();
+    if (nt < 2) return false;
+
+    std::vector<size_t> cuts = split(b,n,std::max(min_piece,n/(4*nt)));
+    if (cuts.empty()) return false;
+    cuts.push_back(n);
+
+    std::vector<piece> pieces(cuts.size());
+    size_t start=0;
+    unsigned line=1, col=0;
+    for (size_t i=0; i<cuts.size(); ++i) {
+      piece &P = pieces[i];
+      P.b = b+start;
+      P.n = cuts[i]-start;
+      P.line = line;
+      P.col = col;
+      P.failed = false;
+      // where the next piece starts
+      line += std::count(P.b,P.b+P.n,'\n');
+      const char *q = P.b+P.n;
+      while (q!=P.b && q[-1]!='\n') --q;
+      col = (q==P.b) ? col+P.n : (P.b+P.n)-q;
+      start = cuts[i];
+    }
+
+    // compile the pieces
+    parser worker(*this);
+    worker.nthreads = 1;
+    worker.dedup = NULL; // the caller interns what is applied
+    std::atomic<size_t> next(0);
+    std::atomic<bool>   stop(false);
+    std::mutex          lock;
+    std::exception_ptr  fatal;
+    auto work = [&]() {
+      for (size_t i; !stop && (i = next++) < pieces.size(); ) {
+        piece &P = pieces[i];
+        try {
+          tokenizer t(P.b,P.n,no_syn,P.line,P.col);
+          worker.compile(P.script,t);
+        }
+        catch (exception &) {
+          P.failed = true;
+          stop = true;
+        }
+        catch (...) {
+          std::lock_guard<std::mutex> g(lock);
+          if (!fatal) fatal = std::current_exception();
+          stop = true;
+        }
+      }
+    };
+    std::vector<std::thread> threads;
+    try {
+      for (unsigned i=1; i<nt && i<pieces.size(); ++i)
+        threads.emplace_back(work);
+    }
+    catch (std::system_error &) {
+      // make do with the threads we have
+    }
+    work();
+    for (size_t i=0; i<threads.size(); ++i) threads[i].join();
+
+    if (fatal) std::rethrow_exception(fatal);
+    for (size_t i=0; i<pieces.size(); ++i)
+      if (pieces[i].failed) return false; // let the serial parse say why
+
+    // apply in input order
+    a.be(Table);
+    for (size_t i=0; i<pieces.size(); ++i) {
+      script_t &s = pieces[i].script;
+      for (size_t j=0; j<s.size(); ++j) apply(a,s[j]);
+      script_t().swap(s);
+    }
+    return true;
+  }
+}
@@ -1,14 +1,16 @@
+#include "binding.hpp"
+#include "cache.hpp"
+#include "compress.hpp"
 #include "exception.hpp"
 #include "parser.hpp"
+#include "parser_impl.hpp"
+#include "source.hpp"
 
 #include <sstream>
-#include <fstream>
 #include <cstring>
 #include <cstdlib>
 #include <climits>
 
-#include <sys/stat.h>
-
 namespace Ark {
 
   // static member initialization
@@ -28,9 +30,87 @@ namespace Ark {
     throw InputError(o.str());
   }
 
+  namespace {
+    /* Builds only the values a binding keeps.  A node is a table on
+       the way to bound keys, or a place in one of the values.  A write
+       that makes one of those tables something else loses whatever
+       was below it, as it would in a tree. */
+    struct bind_builder {
+      struct node {
+        const selection *at; // the table's keys, or NULL
+        ark *a;              // the place in a value, or NULL
+        bool operator==(const node &n) const { return at==n.at && a==n.a; }
+      };
+      static const bool tree = false;
+      tree_builder in;
+      std::vector<ark> &values;
+
+      explicit bind_builder(std::vector<ark> &v) : values(v) {}
+
+      void lose(const selection &s) {
+        if (s.whole) values[s.slot] = ark();
+        else
+          for (selection::key_map::const_iterator i=s.keys.begin();
+               i!=s.keys.end(); ++i)
+            lose(i->second);
+      }
+
+#ifdef ANARKY_NOW
+      void annotate(node a,const ark::annotation_t &an) {
+        if (a.a) in.annotate(a.a,an);
+      }
+      void annotate(node a,const ark::annotation_t &an,kind_t k) {
+        if (a.a) in.annotate(a.a,an,k);
+      }
+#endif
+
+      void table(node a) { if (a.a) in.table(a.a); }
+      // the parser only goes down keys in the selection
+      node key(node a,key_t &k) {
+        if (a.a) return node{NULL,in.key(a.a,k)};
+        const selection &s = a.at->keys.find(k.str())->second;
+        return s.whole ? node{NULL,&values[s.slot]} : node{&s,NULL};
+      }
+      void erase(node a,const key_t &k) {
+        if (a.a) in.erase(a.a,k);
+        else lose(a.at->keys.find(k.str())->second);
+      }
+
+      // and selected keys are all table keys
+      void vector(node a) { if (a.a) in.vector(a.a); else lose(*a.at); }
+      node index(node a,size_t i) { return node{NULL,in.index(a.a,i)}; }
+      void erase(node a,node e) { in.erase(a.a,e.a); }
+
+      void enclose(node a) { if (a.a) in.enclose(a.a); }
+      void enclosed(node) {}
+
+      void atom(node a,std::string_view s) {
+        if (a.a) in.atom(a.a,s); else lose(*a.at);
+      }
+      void none(node a) { if (a.a) in.none(a.a); else lose(*a.at); }
+      void begin_table(node a) {
+        if (a.a) in.begin_table(a.a); else lose(*a.at);
+      }
+      void end_table(node) {}
+      void begin_vector(node a) {
+        if (a.a) in.begin_vector(a.a); else lose(*a.at);
+      }
+      node element(node a) { return node{NULL,in.element(a.a)}; }
+      void end_vector(node) {}
+    };
+  }
+
   //public:
   ark &parser::parse(ark &a,std::istream &in) const {
     tokenizer t(in,no_syn);
+    return parse(a,t);
+  }
+  ark &parser::parse(ark &a,const std::string &s) const {
+    tokenizer t(s,no_syn);
+    return parse(a,t);
+  }
+  //private:
+  ark &parser::parse(ark &a,tokenizer &t) const {
     try {
       t.next(val_syn);
       a = parse_value(t);
@@ -42,44 +122,185 @@ namespace Ark {
     }
     return a;
   }
-  ark &parser::parse(ark &a,const std::string &s) const {
-    std::istringstream In(s);
-    return parse(a,In);
-  }
   //public:
   ark &parser::parse_keyvals(ark &a,std::istream &in) const {
     tokenizer t(in,no_syn);
+    return parse_keyvals(a,t);
+  }
+  ark &parser::parse_keyvals(ark &a,const std::string &s) const {
+    return parse_text(a,s.data(),s.size());
+  }
+  void parser::parse_keyvals(handler &h,std::istream &in) const {
+    event_builder to(h);
+    tokenizer t(in,no_syn);
+    parse_keyvals(to,NULL,t,NULL);
+  }
+  void parser::parse_keyvals(handler &h,const std::string &s) const {
+    event_builder to(h);
+    parse_text(to,NULL,s.data(),s.size());
+  }
+  ark &parser::parse_buffer(ark &a,const char *b,size_t n,
+                            const char *name) const {
+    parser tmp(*this);
+    tmp.current_file = name;
+    return tmp.parse_text(a,b,n);
+  }
+  void parser::parse_file(handler &h,const std::string &s) const {
+    event_builder to(h);
+    include_file(to,NULL,s,select_at);
+  }
+  const ark &parser::parse_file_into(arena &A,const std::string &s) const {
+    parser tmp(*this);
+    tmp.pool = &A;
+    return tmp.parse_file(A.root(),s);
+  }
+  const ark &parser::parse_keyvals_into(arena &A,const std::string &s) const {
+    parser tmp(*this);
+    tmp.pool = &A;
+    tokenizer t(s,no_syn);
+    return tmp.parse_keyvals(A.root(),t);
+  }
+  //private:
+  void parser::bind_file(const bindings &b,void *obj,
+                         const std::string &s) const {
+    std::vector<ark> values(b.nslots);
+    bind_builder to(values);
+    parser tmp(*this);
+    tmp.selected = b.kept;
+    tmp.select_at = b.kept.get();
+    if (tmp.select_at)
+      tmp.include_file(to,bind_builder::node{tmp.select_at,NULL},s,
+                       tmp.select_at);
+    b.assign(obj,values);
+  }
+  void parser::bind_text(const bindings &b,void *obj,
+                         const char *p,size_t n) const {
+    std::vector<ark> values(b.nslots);
+    bind_builder to(values);
+    parser tmp(*this);
+    tmp.selected = b.kept;
+    tmp.select_at = b.kept.get();
+    if (tmp.select_at)
+      tmp.parse_text(to,bind_builder::node{tmp.select_at,NULL},p,n);
+    b.assign(obj,values);
+  }
+  //private:
+  ark &parser::parse_text(ark &a,const char *b,size_t n) const {
+    tree_builder to(pool,dedup);
+    parse_text(to,&a,b,n);
+    intern_built(a);
+    return a;
+  }
+  //private:
+  ark &parser::parse_keyvals(ark &a,tokenizer &t,const char *until) const {
+    tree_builder to(pool,dedup);
+    parse_keyvals(to,&a,t,until);
+    intern_built(a);
+    return a;
+  }
+  //private:
+  ark parser::parse_value(tokenizer &t,const selection *sel,
+                          bool *includes) const {
+    ark a;
+    tree_builder to(pool,dedup);
+    to.includes = includes;
+    parse_value(to,&a,t,sel);
+    return a;
+  }
+  //private:
+  void parser::parse_bracket(ark &a,tokenizer &t) const {
+    tree_builder to(pool,dedup);
+    parse_bracket(to,&a,t);
+  }
+  //private:
+  void parser::include_file(ark &a,const std::string &f,
+                            const selection *sel) const {
+    tree_builder to(pool,dedup);
+    include_file(to,&a,f,sel);
+    intern_built(a);
+  }
+  //private:
+  void parser::intern_built(ark &a) const {
+    // interning a lazy parse would parse everything it deferred
+    if (dedup && !pool && !lazy_parse) dedup->intern(a);
+  }
+  //private:
+  std::string parser::pathify(const std::string &s,const char *path) {
+    if (!path || (s.size() && s[0]=='/')) return s;
+    const char *ind = strrchr(path,'/');
+    if (!ind) return s;
+    return std::string(path,ind+1)+s;
+  }
+
+  //private:
+  template <typename B>
+  void parser::parse_text(B &to,typename B::node a,
+                          const char *b,size_t n) const {
+    if constexpr (B::tree) {
+      if (nthreads!=1 && !pool && !lazy_in && !select_at
+          && parse_parallel(*a,b,n)) return;
+    }
+    tokenizer t(b,n,no_syn);
+    parse_keyvals(to,a,t,select_at ? b+relevant_end(b,n) : NULL);
+  }
+  //private:
+  template <typename B>
+  void parser::parse_keyvals(B &to,typename B::node a,tokenizer &t,
+                             const char *until) const {
+    // where the keyval before went, for keyvals that start the same
+    // way; selections would need their own bookkeeping
+    cursors<typename B::node> steps;
+    cursors<typename B::node> *cs = B::tree && !select_at ? &steps : NULL;
     try {
 #ifdef ANARKY_NOW
-      ark::annotation_t anno(current_file,t.lineno(),t.colno());
-      if (a.kind()!=Table) a.annotate(anno);
+      to.annotate(a,ark::annotation_t(current_file,t.lineno(),t.colno()),
+                  Table);
 #endif
-      a.be(Table);
-      while( t.next(key_syn).kind()!=token::End ) parse_keyvalue(a,t);
+      to.table(a);
+      // nothing from until on can touch the selection
+      while( (!until || t.position()<until)
+             && t.next(key_syn).kind()!=token::End )
+        parse_keyvalue(to,a,t,select_at,cs,0);
     }
     catch (exception &e) {
       throwInputError(e,"parse problem",current_file,t);
     }
-    return a;
   }
-  ark &parser::parse_keyvals(ark &a,const std::string &s) const {
-    std::istringstream In(s);
-    return parse_keyvals(a,In);
+  //private:
+  bool parser::erasing(tokenizer &t) {
+    // possible special syntax for !erase
+    if (t.current().kind()!=token::Syntax || t.current().syntax()!='!')
+      return false;
+    if (t.next().kind() != token::Symbol)
+      throw InputError("expecting a special symbol");
+    if (t.current().view()!="erase")
+      throw InputError("unknown special token");
+    return true;
   }
+  /* With cs, steps of the superkey are recorded in (*cs)[depth] and
+     on, and a step the keyval before also took is not taken again.
+     Anything that can change the tree below a step cuts the record
+     back to the steps above it first, so what is left always points
+     at live nodes. */
   //private:
-  void parser::parse_keyvalue(ark &a,tokenizer &t) const {
+  template <typename B>
+  void parser::parse_keyvalue(B &to,typename B::node a,tokenizer &t,
+                              const selection *sel,
+                              cursors<typename B::node> *cs,
+                              size_t depth) const {
     // check for !include and other key-like specials
     if (t.current().kind()==token::Syntax
         && t.current().syntax()=='!') {
       if (t.next().kind() != token::Symbol)
         throw InputError("expecting a special symbol");
 
-      if (t.current().text()=="include") {
+      if (t.current().view()=="include") {
         t.next();
         if (t.current().kind()==token::Symbol
             || t.current().kind()==token::String) {
+          if (cs) cs->resize(depth);
           try {
-            include_file(a,t.current().text());
+            include_file(to,a,t.current().text(),sel);
           }
           catch (exception &e) {
             throwInputError(e,"include problem",current_file,t);
@@ -98,51 +319,83 @@ namespace Ark {
       throw InputError("expecting a key symbol");
 
 #ifdef ANARKY_NOW
-    ark::annotation_t anno(current_file,t.lineno(),t.colno());
-    if (a.kind()!=Table) a.annotate(anno);
+    to.annotate(a,ark::annotation_t(current_file,t.lineno(),t.colno()),Table);
 #endif
 
-    table_t &d=a.be(Table).table(); // I must be a table
-    key_t k=t.current().text();     // this must be my key
-    t.next(key_syn);
+    to.table(a); // I must be a table
 
-    // possible special syntax for !erase
-    if (t.current().kind()==token::Syntax
-        && t.current().syntax()=='!') {
-      if (t.next().kind() != token::Symbol)
-        throw InputError("expecting a special symbol");
+    // keys off the selection aren't kept
+    if (sel) {
+      selection::key_map::const_iterator i=sel->keys.find(t.current().view());
+      if (i==sel->keys.end()) {
+        t.next(key_syn);
+        skip_descend(t);
+        return;
+      }
+      sel = i->second.whole ? NULL : &i->second;
+    }
 
-      if (t.current().text()=="erase") {
-        d.erase(k);
+    // the keyval before took this step too
+    if (cs && depth<cs->size() && (*cs)[depth].parent==a
+        && !(*cs)[depth].key.empty()
+        && (*cs)[depth].key==t.current().view()) {
+      t.next(key_syn);
+      if (erasing(t)) {
+        to.erase(a,key_t::unchecked((*cs)[depth].key));
+        cs->resize(depth);
       }
-      else
-        throw InputError("unknown special token");
+      else descend(to,(*cs)[depth].child,t,sel,cs,depth+1);
       return;
-    } // nothing special
+    }
 
-    descend(d[k],t);
+    key_t k=t.current().text();          // this must be my key
+    t.next(key_syn);
+
+    if (erasing(t)) {
+      if (cs) cs->resize(depth);
+      to.erase(a,k);
+      return;
+    }
+
+    if (!cs) {
+      descend(to,to.key(a,k),t,sel);
+      return;
+    }
+    cs->resize(depth);
+    cs->push_back({a,k.str(),0,typename B::node()});
+    typename B::node c = cs->back().child = to.key(a,k);
+    descend(to,c,t,sel,cs,depth+1);
   }
   // private:
-  void parser::descend(ark &a,tokenizer &t) const {
+  template <typename B>
+  void parser::descend(B &to,typename B::node a,tokenizer &t,
+                       const selection *sel,
+                       cursors<typename B::node> *cs,
+                       size_t depth) const {
 #ifdef ANARKY_NOW
     ark::annotation_t anno(current_file,t.lineno(),t.colno());
 #endif
     if (t.current().syntax()=='[') {
-      unsigned offset;
-#ifdef ANARKY_NOW      
-      if (a.kind()!=Vector) a.annotate(anno);
+      unsigned offset=0;
+#ifdef ANARKY_NOW
+      to.annotate(a,anno,Vector);
 #endif
       // we have a vector access
-      vector_t &v=a.be(Vector).vector();
+      to.vector(a);
+
+      // selected keys are all table keys, so none are below here
+      if (sel) {
+        skip_descend(t);
+        return;
+      }
 
       // read a number or "+"
       if (t.next(key_syn).kind()!=token::Symbol)
         throw InputError("expecting a number");
-      if (t.current().text()=="+") {
-        offset = v.size();
-      }
-      else {
-        const char * S=t.current().text().c_str();
+      bool append = t.current().view()=="+";
+      if (!append) {
+        const std::string num = t.current().text();
+        const char * S=num.c_str();
         char       * E=NULL;
         offset = strtoul(S,&E,10);
         if (S==E || *E) throw InputError("unable to parse strange number");
@@ -150,75 +403,69 @@ namespace Ark {
       // read ']'
       if (t.next(key_syn).syntax()!=']') throw InputError("expecting ']'");
 
-      if (offset==v.size()) v.push_back(ark(None));
-      else if (offset > v.size())
-        throw InputError("non-contiguous vector set not allowed");
+      typename B::node e;
+      if (cs && !append && depth<cs->size() && (*cs)[depth].parent==a
+          && (*cs)[depth].key.empty() && (*cs)[depth].index==offset)
+        e = (*cs)[depth].child; // the keyval before took this step too
+      else {
+        // a new element may move the others
+        if (cs) cs->resize(depth);
+        e = to.index(a,append ? handler::append : offset);
+        if (cs && !append) cs->push_back({a,std::string(),offset,e});
+      }
       t.next(key_syn); // get next and keep descending
 
-      // possible special syntax for !erase
-      if (t.current().kind()==token::Syntax
-          && t.current().syntax()=='!') {
-        if (t.next().kind() != token::Symbol)
-          throw InputError("expecting a special symbol");
-
-        if (t.current().text()=="erase") {
-          v.erase(v.begin()+offset);
-        }
-        else
-          throw InputError("unknown special token");
+      if (erasing(t)) {
+        if (cs) cs->resize(depth);
+        to.erase(a,e);
         return;
-      } // nothing special
+      }
 
-      descend(v[offset],t);
+      if (cs && depth<cs->size()) descend(to,e,t,sel,cs,depth+1);
+      else descend(to,e,t,NULL);
     }
     // t now is on a . is more key or an = if value is next
     // now follow any array references after it
     else if (t.current().syntax()=='.') {
       t.next(key_syn); // back into a keyvals context
-      parse_keyvalue(a,t);
+      parse_keyvalue(to,a,t,sel,cs,depth);
     }
     else if (t.current().syntax()=='{') {
 #ifdef ANARKY_NOW
-      if (a.kind()!=Table) a.annotate(anno);
+      to.annotate(a,anno,Table);
 #endif
+      if (cs) cs->resize(depth);
       // namespace
-      a.be(Table);
-      while( t.next(key_syn).syntax()!='}') parse_keyvalue(a,t);
+      to.enclose(a);
+      while( t.next(key_syn).syntax()!='}') parse_keyvalue(to,a,t,sel);
+      to.enclosed(a);
     }
     else if (t.current().syntax()=='=') {
+      if (cs) cs->resize(depth);
       // assignment
       t.next(val_syn);
-      a = parse_value(t);
-      //a.annotate(anno);
+      parse_value(to,a,t,sel);
     }
     else throw InputError("expecting '.' or '=' or '{'");
   }
-  namespace {
-    std::string pathify(const std::string &s,const char *path) {
-      if (!path || (s.size() && s[0]=='/')) return s;
-      const char *ind = strrchr(path,'/');
-      if (!ind) return s;
-      return std::string(path,ind+1)+s;
-    }
-  }
   //private:
-  ark parser::parse_value(tokenizer &t) const {
-    ark a;
+  template <typename B>
+  void parser::parse_value(B &to,typename B::node a,tokenizer &t,
+                           const selection *sel) const {
 #ifdef ANARKY_NOW
-    ark::annotation_t anno(current_file,t.lineno(),t.colno());
-    a.annotate(anno);
+    to.annotate(a,ark::annotation_t(current_file,t.lineno(),t.colno()));
 #endif
     // check for special form
     if (t.current().syntax()=='!') {
       if (t.next().kind() != token::Symbol)
         throw InputError("expecting a special symbol");
 
-      if (t.current().text()=="file") {
+      if (t.current().view()=="file") {
         t.next();
         if (t.current().kind()==token::Symbol
             || t.current().kind()==token::String) {
-          a.be(Atom); // use current_file to get relative path
-          a.atom() = pathify(t.current().text(),current_file);
+          // use current_file to get relative path
+          to.atom(a,pathify(t.current().text(),current_file));
         }
         else
           throw InputError("!file expected a string or quoted string");
@@ -230,22 +477,32 @@ namespace Ark {
       switch(t.current().kind()) {
       case token::Symbol:
       case token::String:
-        a.be(Atom);
-        a.atom() = t.current().text();
+        to.atom(a,t.current().view());
         break;
       case token::Syntax:
         switch( t.current().syntax() ) {
         case '[':
-          a.be(Vector);
-          for(int i=0; t.next(val_syn).syntax()!=']'; i++)
-            a.vector().push_back(parse_value(t));
-          break;
         case '{':
-          a.be(Table);
-          while( t.next(key_syn).syntax()!='}') parse_keyvalue(a,t);
+          if (sel) {
+            // a vector holds no selected keys
+            if (t.current().syntax()=='[') {
+              to.begin_vector(a);
+              t.skip_brackets();
+              to.end_vector(a);
+            }
+            else {
+              to.begin_table(a);
+              while( t.next(key_syn).syntax()!='}') parse_keyvalue(to,a,t,sel);
+              to.end_table(a);
+            }
+          }
+          else if constexpr (B::tree) {
+            if (!lazy_in || !defer(*a,t)) parse_bracket(to,a,t);
+          }
+          else parse_bracket(to,a,t);
           break;
         case '?':
-          a.be(None);
+          to.none(a);
           break;
         default:
           throw InputError("expecting '{' or '[' or '?'");
@@ -255,43 +512,95 @@ namespace Ark {
         throw InputError("expecting '{' or '[' or '?' or string");
       }
     }
-    return a;
   }
   //private:
-  void parser::include_file(ark &a,const std::string &f) const {
+  template <typename B>
+  void parser::parse_bracket(B &to,typename B::node a,tokenizer &t) const {
+    if (t.current().syntax()=='[') {
+      to.begin_vector(a);
+      while( t.next(val_syn).syntax()!=']')
+        parse_value(to,to.element(a),t,NULL);
+      to.end_vector(a);
+    }
+    else {
+      to.begin_table(a);
+      while( t.next(key_syn).syntax()!='}') parse_keyvalue(to,a,t,NULL);
+      to.end_table(a);
+    }
+  }
+  //private:
+  template <typename B>
+  void parser::include_file(B &to,typename B::node a,const std::string &f,
+                            const selection *sel) const {
+    if constexpr (B::tree)
+      if (to.includes) { *to.includes = true; return; } // see compile_value()
     if (f.empty())        throw InputError("include filename is empty");
     if (include_depth>20) throw InputError("include depth exceeded");
 
     // form path
     std::string path = pathify(f,current_file);
+    if (graph) {
+      // stamped before it is read, so that a rewrite from here on is
+      // seen as a change
+      include_edge e = { current_file ? current_file : "", path,
+                         file_stamp(), false };
+      e.there = include_cache::stat(path,e.st);
+      graph->push_back(e);
+    }
 
-    parser tmp;
+    parser tmp(*this);
     tmp.current_file = path.c_str();
     tmp.include_depth = include_depth+1;
+    tmp.lazy_in.reset();
+    tmp.select_at = sel;
 
-    try {
-      std::ifstream F;
-      // need this because ifstream will open a dir without complaining
-      // and act as if it is an empty file.
-      struct stat statbuf;
-      if(stat(tmp.current_file, &statbuf) == -1) {
-        std::ostringstream o;
-        o << "unable to stat file: " << tmp.current_file;
-        o << " (" << strerror(errno) << ")";
-        throw InputError(o.str());
+    // a bundle's files are parsed as if they had been included
+    bundle_map sections;
+    auto contents = [&](const char *b,size_t n) {
+      if (compression_of(b,n)) {
+        // tokenized as it is inflated
+        inflater z(b,n);
+        tokenizer t(z,no_syn);
+        tmp.parse_keyvals(to,a,t,NULL);
       }
-      if (!S_ISREG(statbuf.st_mode)){
-        std::ostringstream o;
-        o << "not a regular file: " << tmp.current_file;
-        throw InputError(o.str());
+      else if (const std::string *top = index_bundle(b,n,sections)) {
+        std::string_view s = sections.find(*top)->second;
+        tmp.bundled = &sections;
+        tmp.current_file = top->c_str();
+        tmp.parse_text(to,a,s.data(),s.size());
+      }
+      else tmp.parse_text(to,a,b,n);
+    };
+
+    try {
+      bundle_map::const_iterator s;
+      if (bundled && (s=bundled->find(path))!=bundled->end())
+        contents(s->second.data(),s->second.size());
+      else if constexpr (B::tree) {
+        include_map::const_iterator i;
+        if (bundling) {
+          file_source in(path);
+          file_texts::const_iterator j = bundling->begin();
+          while (j!=bundling->end() && j->first!=path) ++j;
+          if (j==bundling->end())
+            bundling->emplace_back(path,std::string(in.data(),in.size()));
+          contents(in.data(),in.size());
+        }
+        else if (lazy_parse && !pool)
+          tmp.parse_lazy(*a);
+        else if (preloaded && !deps
+                 && (i=preloaded->find(path))!=preloaded->end()
+                 && i->second.ok)
+          tmp.replay(*a,i->second.script);
+        else if (pool || (!caching && cachedir.empty())
+                 || !tmp.replay_stored(*a)) {
+          file_source in(path);
+          contents(in.data(),in.size());
+        }
       }
-      F.open(tmp.current_file);
-      // ok, done with that mess
-      if (F) tmp.parse_keyvals(a,F);
       else {
-        std::ostringstream o;
-        o << "unable to read file: " << tmp.current_file;
-        throw InputError(o.str());
+        file_source in(path);
+        contents(in.data(),in.size());
       }
     }
     catch (exception &e) {
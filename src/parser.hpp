@@ -2,7 +2,14 @@
 #define ark_parser_hpp
 
 #include "base.hpp"
+#include "handler.hpp"
 #include "tokens.hpp" // for my private members
+#include "script.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 /*! \file ark/parser.hpp
 
@@ -39,6 +46,23 @@ INT is a base 10 non-negative integer.
 
 namespace Ark {
 
+  //! a file being parsed lazily; see lazy.cpp.
+  struct lazy_input;
+  class bindings;
+  class interner;
+  template <typename T> class binding;
+
+  //! the superkeys a parser keeps, as a tree of table keys; see
+  //! parser::select().
+  struct selection {
+    //! keys, looked up without making strings of them.
+    typedef std::map<std::string,selection,std::less<> > key_map;
+    key_map keys; //!< keys to keep below this table, and what below them.
+    bool whole; //!< keep everything below this point.
+    size_t slot; //!< for a binding, where a whole key's value goes.
+    selection() : whole(false), slot(0) {}
+  };
+
 /*! parser defines a helper type used for parsing arks.  In theory,
   having a helper type for the parser allows some user-level control
   over the parsing.  In practice, the parser type isn't that
@@ -67,12 +91,106 @@ namespace Ark {
   class parser {
     unsigned include_depth;    //!< current include file depth.
     const char *current_file;  //!< name of current include file.
+    arena *pool;               //!< where new nodes go; NULL for the heap.
+    unsigned nthreads;         //!< threads for large inputs; 0 for all.
+    const include_map *preloaded; //!< files parsed ahead of time, or NULL.
+    bool caching;              //!< use the include_cache.
+    std::string cachedir;      //!< where snapshots go; empty for none.
+    dep_list *deps;            //!< files read, when recording a snapshot.
+    include_graph *graph;      //!< includes met, when watching them.
+    const bundle_map *bundled; //!< the bundle being read, or NULL.
+    file_texts *bundling;      //!< files read, when writing a bundle.
+    bool lazy_parse;           //!< defer tables and vectors in files.
+    std::shared_ptr<const lazy_input> lazy_in; //!< the file, when deferring.
+    std::shared_ptr<const selection> selected; //!< what to keep, or NULL.
+    const selection *select_at; //!< what to keep at the top of this parse.
+    interner *dedup;           //!< shares equal values, or NULL.
+
+    friend class loader;
+    friend class feeder;
+    friend class watcher;
+    friend class patch_scan;
+    friend struct deferred_t;
+
+    ark parse_value(tokenizer &t,const selection *sel=NULL,
+                    bool *includes=NULL) const;
+    void parse_bracket(ark &a,tokenizer &t) const;
+    ark &parse(ark &a,tokenizer &t) const;
+    ark &parse_keyvals(ark &a,tokenizer &t,const char *until=NULL) const;
+    ark &parse_text(ark &a,const char *b,size_t n) const;
+    void include_file(ark &a,const std::string &f,
+                      const selection *sel=NULL) const;
+    static std::string pathify(const std::string &s,const char *path);
 
-    ark parse_value(tokenizer &t) const;
+    // the grammar, for a tree_builder or an event_builder (parser_impl.hpp)
+    template <typename B>
+    void parse_keyvals(B &to,typename B::node a,tokenizer &t,
+                       const char *until) const;
+    template <typename B>
+    void parse_text(B &to,typename B::node a,const char *b,size_t n) const;
+    //! a step a superkey took; see parse_keyvalue().
+    template <typename Node>
+    struct cursor {
+      Node parent;     //!< the table or vector stepped from.
+      std::string key; //!< the key stepped to, or empty for an index.
+      size_t index;    //!< the index stepped to.
+      Node child;      //!< where the step led.
+    };
+    template <typename Node>
+    using cursors = std::vector<cursor<Node> >;
+    static bool erasing(tokenizer &t);
+    template <typename B>
+    void parse_keyvalue(B &to,typename B::node a,tokenizer &t,
+                        const selection *sel,
+                        cursors<typename B::node> *cs=NULL,
+                        size_t depth=0) const;
+    template <typename B>
+    void descend(B &to,typename B::node a,tokenizer &t,
+                 const selection *sel,
+                 cursors<typename B::node> *cs=NULL,
+                 size_t depth=0) const;
+    template <typename B>
+    void parse_value(B &to,typename B::node a,tokenizer &t,
+                     const selection *sel) const;
+    template <typename B>
+    void parse_bracket(B &to,typename B::node a,tokenizer &t) const;
+    template <typename B>
+    void include_file(B &to,typename B::node a,const std::string &f,
+                      const selection *sel) const;
 
-    void descend(ark &a,tokenizer &t) const;
-    void parse_keyvalue(ark &a,tokenizer &t) const;
-    void include_file(ark &a,const std::string &f) const;
+    // two-step parsing; see script.hpp
+    bool parse_parallel(ark &a,const char *b,size_t n) const;
+    void compile(script_t &s,tokenizer &t) const;
+    void compile_keyvalue(statement &s,tokenizer &t) const;
+    void compile_descend(statement &s,tokenizer &t) const;
+    void compile_value(statement &s,tokenizer &t) const;
+    template <typename Statement>
+    void apply(ark &a,Statement &s) const;
+    void replay(ark &a,const script_t &s) const;
+    bool replay_stored(ark &a) const;
+    bool replay_merged(ark &a) const;
+    std::shared_ptr<const script_t> load_script() const;
+
+    // bundles; see bundle.cpp
+    static bool is_bundle(const char *b,size_t n);
+    static const std::string *index_bundle(const char *b,size_t n,
+                                           bundle_map &m);
+
+    // selective parsing; see select.cpp
+    void skip_descend(tokenizer &t) const;
+    void skip_value(tokenizer &t) const;
+    size_t relevant_end(const char *b,size_t n) const;
+
+    // lazy parsing; see lazy.cpp
+    void parse_lazy(ark &a) const;
+    bool defer(ark &a,tokenizer &t) const;
+
+    // interning what a tree_builder didn't; see intern.hpp
+    void intern_built(ark &a) const;
+
+    // parsing into bound members; see binding.hpp
+    void bind_file(const bindings &b,void *obj,const std::string &s) const;
+    void bind_text(const bindings &b,void *obj,const char *p,size_t n) const;
 
   public:
     static tokenizer::syntax key_syn; //!< punctuation for tokens in a key context.
@@ -82,7 +200,114 @@ namespace Ark {
     /*! Constructor.
       Sets the syntax and initializes the include file meta-information.
     */
-    parser() : include_depth(0),current_file(NULL) {};
+    parser() : include_depth(0),current_file(NULL),pool(NULL),nthreads(1),
+               preloaded(NULL),caching(false),deps(NULL),graph(NULL),
+               bundled(NULL),
+               bundling(NULL),lazy_parse(false),select_at(NULL),
+               dedup(NULL) {};
+
+    /*! Parse large keyvals inputs (files, buffers and strings of a
+      megabyte or more) on several threads.  The input is split
+      between top-level keyvals (after bracketed values, or at line
+      ends after others), the pieces are parsed concurrently, and the
+      results are applied in input order, so the outcome, including
+      any error message, is the same as a serial parse.  Smaller
+      inputs, streams, arena parses and inputs with no split points
+      are parsed serially.
+      @param n number of threads; 1 (the default) parses serially
+      and 0 uses every core.
+      @return reference to this parser.
+    */
+    parser &threads(unsigned n) { nthreads = n; return *this; }
+    //! the threads setting.
+    //! @return the number of threads, or 0 for every core.
+    unsigned threads() const { return nthreads; }
+
+    /*! Parse files lazily.  A quick pass over each file finds every
+      bracketed value, and a table or vector given as a value (after
+      '=' or inside another value) is left as a reference to its bytes
+      until it is first looked into, by get(), xget(), table(),
+      vector(), a reader or a printer; kind() does not need to parse
+      it.  The file stays mapped while any such reference is left.
+      Parsing on first touch is thread-safe, and a touched subtree is
+      exactly what an eager parse gives, but a syntax error inside a
+      subtree is thrown by the access that parses it, and never if it
+      isn't touched.  Copying a subtree parses it.  Lazy parses don't
+      use threads(), the include cache or snapshots, and arena parses
+      and bundles are parsed eagerly.
+      @param on whether to defer; off by default.
+      @return reference to this parser.
+    */
+    parser &lazy(bool on) { lazy_parse = on; return *this; }
+    //! the lazy setting.
+    //! @return true if subtrees are deferred.
+    bool lazy() const { return lazy_parse; }
+
+    /*! Parse only what some superkeys need.  Keyvals inputs (files,
+      their includes, strings and streams) then keep just the parts of
+      the tree on the way to, or below, the selected keys.  Statements
+      and values off those paths are skipped, with bracketed values
+      passed over at the speed of bracket matching and nothing
+      allocated for them, and a buffer or file stops being parsed once
+      nothing after that point could touch a selected key.  Overrides,
+      !erase and includes are followed as usual, so xget() of any
+      selected key gives what it would after a full parse; other keys
+      may be missing or incomplete.  Syntax errors in skipped parts
+      are not reported.  A key with a vector index keeps the whole
+      vector.
+      @param keys superkeys, in the syntax ark::xget() accepts; an
+      empty list, or an empty key, keeps everything (the default).
+      @return reference to this parser.
+    */
+    parser &select(const std::vector<std::string> &keys);
+
+    /*! Share equal values as they are parsed (see intern.hpp).  Each
+      atom, and each table or vector given as a value, is interned as
+      soon as it has been read, so a duplicate is let go before the
+      rest of the input is parsed; what else the parse built (keys
+      set one by one, includes replayed from the cache or snapshots,
+      threaded parses) is interned once the parse is done.  Arena and
+      lazy parses are not interned.
+      @param I the interner, which must outlive the parses and is
+      used by one parse at a time; NULL (the default) turns interning
+      off.
+      @return reference to this parser.
+    */
+    parser &intern(interner *I) { dedup = I; return *this; }
+    //! the intern setting.
+    //! @return the interner, or NULL.
+    interner *intern() const { return dedup; }
+
+    /*! Keep parsed include files in the process-wide include_cache
+      (see cache.hpp) and replay them on later includes instead of
+      reading and parsing them again.  Arena parses don't use it.
+      @param on whether to use the cache; off by default.
+      @return reference to this parser.
+    */
+    parser &cache_includes(bool on) { caching = on; return *this; }
+    //! the cache_includes setting.
+    //! @return true if the include cache is used.
+    bool cache_includes() const { return caching; }
+
+    /*! Keep compiled snapshots of parsed files in a directory, and
+      load them instead of tokenizing when the files are unchanged.
+      Each file's statements are stored, and so is the merged result
+      of each file given to parse_file() (or included at the top
+      level) together with the files it pulled in.  A snapshot is
+      used only if every file it was built from still has the same
+      contents, checked by size and modification time and, when those
+      differ, by a fingerprint of the bytes; anything else is parsed
+      again and its snapshot rewritten.  Snapshots are written
+      atomically, so processes can share a directory.  Arena parses
+      don't use them.
+      @param dir the directory, created with any missing parents; empty turns
+      snapshots off (the default).
+      @return reference to this parser.
+    */
+    parser &cache_dir(const std::string &dir) { cachedir = dir; return *this; }
+    //! the cache_dir setting.
+    //! @return the directory, or empty if snapshots are off.
+    const std::string &cache_dir() const { return cachedir; }
     /*! parse into an ark from a C++ stream.
       Starts from the production rule for ARK in the grammar.
       @param a input ark.
@@ -112,18 +337,101 @@ namespace Ark {
     */
     ark &parse_keyvals(ark &a,const std::string &s) const;
 
+    /*! parse_keyvals() over bytes the caller already holds, which are
+      tokenized in place (not copied).
+      @param a input ark.
+      @param b start of the input.
+      @param n length of the input.
+      @param name file name used in error messages and to resolve
+      relative !include and !file paths; may be NULL.
+      @return reference to a.
+    */
+    ark &parse_buffer(ark &a,const char *b,size_t n,const char *name) const;
+
+    /*! parse_keyvals() from a C++ stream, telling a handler instead
+      of building an ark (see handler.hpp).
+      @param h handler.
+      @param in input stream.
+    */
+    void parse_keyvals(handler &h,std::istream &in) const;
+    /*! parse_keyvals() from a string, telling a handler.
+      @param h handler.
+      @param s input string.
+    */
+    void parse_keyvals(handler &h,const std::string &s) const;
+
     /*! parse the contents of a file as a sequence of key-value pairs.
       Useful for reading config files.
       Starts from the production rule for KEYVAL* in the grammar.
       Checks include depth and updated the include file meta-information.
+      Regular files are mapped and tokenized in place; pipes and other
+      readable non-directories are read into memory first.
       @param a input ark.
       @param s file to read.
       @return reference to a.
     */
     ark &parse_file(ark &a,const std::string &s) const {
-      include_file(a,s);
+      include_file(a,s,select_at);
       return a;
     }
+
+    /*! parse_file(), telling a handler instead of building an ark
+      (see handler.hpp).  Includes are read as they are met: the
+      include cache, snapshots, threads() and lazy() don't apply.
+      @param h handler.
+      @param s file to read.
+    */
+    void parse_file(handler &h,const std::string &s) const;
+
+    /*! parse_file() into a new tree whose nodes, containers and atom
+      characters are all allocated from an arena (table keys too,
+      unless they are too long for std::string's inline storage).
+      Nothing is freed until the arena is destroyed, which then
+      releases the whole tree at once.
+      @param A arena; must outlive every use of the result.
+      @param s file to read.
+      @return the parsed tree, owned by A.
+    */
+    const ark &parse_file_into(arena &A,const std::string &s) const;
+
+    /*! parse_keyvals() into a new tree allocated from an arena, as
+      parse_file_into() does.
+      @param A arena; must outlive every use of the result.
+      @param s input string.
+      @return the parsed tree, owned by A.
+    */
+    const ark &parse_keyvals_into(arena &A,const std::string &s) const;
+
+    /*! Write a bundle: a file and every file it includes, directly or
+      not, packed into one file that parse_file() reads with a single
+      open.  Each file keeps the path it was included by, so !file
+      values, relative includes and error messages come out exactly as
+      they do from the loose files.  The file is parsed to find its
+      includes; parse errors are thrown.
+      @param out stream for the bundle.
+      @param s file to pack, as it would be given to parse_file().
+    */
+    void write_bundle(std::ostream &out,const std::string &s) const;
+
+    /*! parse_file() straight into the members of a struct (see
+      binding.hpp).  The binding replaces any select(), and threads(),
+      lazy(), the include cache and snapshots don't apply.  Throws
+      InputError for a required key with no value, or a value that
+      doesn't convert.
+      @param t the struct.
+      @param b superkeys bound to its members.
+      @param s file to read.
+    */
+    template <typename T>
+    void parse_file(T &t,const binding<T> &b,const std::string &s) const;
+    /*! parse_keyvals() from a string straight into the members of a
+      struct, as parse_file() does.
+      @param t the struct.
+      @param b superkeys bound to its members.
+      @param s input string.
+    */
+    template <typename T>
+    void parse_keyvals(T &t,const binding<T> &b,const std::string &s) const;
   };
 }
 
@@ -0,0 +1,126 @@
+#ifndef ark_parser_impl_hpp
+#define ark_parser_impl_hpp
+
+#include "base.hpp"
+#include "handler.hpp"
+#include "intern.hpp"
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+/* Not installed.  The grammars, the parser's (parser.cpp) and the
+   strict one (base_io.cpp), are written once, against a builder:
+   tree_builder makes the ark the parse describes, and event_builder
+   tells a handler (see handler.hpp).  node is where a value goes. */
+
+namespace Ark {
+
+  //! builds an ark, with its nodes from an arena if there is one,
+  //! and its atoms and bracketed values interned if there is an
+  //! interner instead.
+  struct tree_builder {
+    typedef ark *node;
+    static const bool tree = true;
+    arena *pool;
+    interner *dedup;
+    bool *includes; //!< set for an include met, which isn't followed.
+
+    explicit tree_builder(arena *A=NULL,interner *I=NULL)
+      : pool(A), dedup(A ? NULL : I), includes(NULL) {}
+
+#ifdef ANARKY_NOW
+    void annotate(node a,const ark::annotation_t &an) { a->annotate(an); }
+    void annotate(node a,const ark::annotation_t &an,kind_t k) {
+      if (a->kind()!=k) a->annotate(an);
+    }
+#endif
+
+    //! a is the table keyvals go into.
+    void table(node a) { a->be(Table,pool); }
+    node key(node a,key_t &k) {
+      // long keys live on the heap even in an arena
+      if (pool && k.size() > std::string().capacity())
+        pool->note_heap_allocation();
+      return &a->table()[std::move(k)];
+    }
+    //! a key that must be new to its table, as the strict grammar has.
+    node new_key(node a,key_t &k) {
+      if (pool && k.size() > std::string().capacity())
+        pool->note_heap_allocation();
+      size_t n = a->table().size();
+      ark &slot = a->emplace(k);
+      if (a->table().size() == n) {
+        std::string err("duplicate key: ");
+        throw InputError(err+k.str());
+      }
+      return &slot;
+    }
+    void erase(node a,const key_t &k) { a->table().erase(k); }
+
+    //! a is the vector a superkey indexes.
+    void vector(node a) { a->be(Vector,pool); }
+    node index(node a,size_t i) {
+      vector_t &v=a->vector();
+      if (i==handler::append) i = v.size();
+      if (i==v.size()) v.emplace_back();
+      else if (i > v.size())
+        throw InputError("non-contiguous vector set not allowed");
+      return &v[i];
+    }
+    void erase(node a,node e) {
+      vector_t &v=a->vector();
+      v.erase(v.begin()+(e-&v[0]));
+    }
+
+    void enclose(node a) { a->be(Table,pool); }
+    void enclosed(node) {}
+
+    void atom(node a,std::string_view s) {
+      if (dedup) dedup->atom(*a,s);
+      else a->be_atom(s,pool);
+    }
+    void none(node a) { a->be(None); }
+    void begin_table(node a) { a->clear(); a->be(Table,pool); }
+    void end_table(node a) { if (dedup) dedup->intern(*a); }
+    void begin_vector(node a) { a->clear(); a->be(Vector,pool); }
+    node element(node a) { return &a->emplace_back(); }
+    void end_vector(node a) { if (dedup) dedup->intern(*a); }
+  };
+
+  //! tells a handler.
+  struct event_builder {
+    typedef std::nullptr_t node;
+    static const bool tree = false;
+    handler &h;
+
+    explicit event_builder(handler &H) : h(H) {}
+
+#ifdef ANARKY_NOW
+    void annotate(node,const ark::annotation_t &) {}
+    void annotate(node,const ark::annotation_t &,kind_t) {}
+#endif
+
+    void table(node) {}
+    node key(node,key_t &k) { h.on_key(k.str()); return node(); }
+    node new_key(node,key_t &k) { h.on_key(k.str()); return node(); }
+    void erase(node,const key_t &k) { h.on_key(k.str()); h.on_erase(); }
+
+    void vector(node) {}
+    node index(node,size_t i) { h.on_index(i); return node(); }
+    void erase(node,node) { h.on_erase(); }
+
+    void enclose(node) { h.begin_enclosure(); }
+    void enclosed(node) { h.end_enclosure(); }
+
+    void atom(node,std::string_view s) { h.on_atom(s); }
+    void none(node) { h.on_none(); }
+    void begin_table(node) { h.begin_table(); }
+    void end_table(node) { h.end_table(); }
+    void begin_vector(node) { h.begin_vector(); }
+    node element(node) { return node(); }
+    void end_vector(node) { h.end_vector(); }
+  };
+}
+
+#endif
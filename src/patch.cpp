@@ -0,0 +1,395 @@
+#include "compress.hpp"
+#include "exception.hpp"
+#include "parser.hpp"
+#include "patch.hpp"
+#include "printer.hpp"
+#include "source.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Patching.  A scan walks the keyvals as the parser does, keeping the
+   superkey each statement writes instead of building anything, and
+   notes for each key set where the value it would end up with is
+   written.  Whatever else writes over, into or around that value
+   since, an !include that could, or a change of kind above it, means
+   it is no longer all in one place, and the key is appended instead.
+   Bracketed values are only looked into when a key set is inside
+   them; otherwise the tokenizer skips them by bracket matching. */
+
+namespace Ark {
+
+  namespace {
+    // a step of a superkey: a key, or an index if key is empty
+    struct step {
+      std::string key;
+      size_t      index;
+      bool        append; // "[+]"
+    };
+    typedef std::vector<step> path_t;
+
+    // how a write at p bears on the value at t
+    enum relation {
+      Apart,  // not at all
+      Same,   // it writes that value
+      Above,  // it writes a value t is inside
+      Below,  // it writes inside t's value
+      Across  // it changes the kind of a value above both
+    };
+
+    relation relate(const path_t &p,const path_t &t) {
+      size_t n = std::min(p.size(),t.size());
+      for (size_t i=0; i<n; ++i) {
+        const step &a = p[i], &b = t[i];
+        if (a.key.empty()!=b.key.empty()) return Across;
+        // "[+]" makes a new element, which can't be one written before
+        if (a.key.empty() ? a.append || a.index!=b.index : a.key!=b.key)
+          return Apart;
+      }
+      return p.size()<t.size() ? Above : p.size()>t.size() ? Below : Same;
+    }
+
+    path_t steps_of(const std::string &s) {
+      static const tokenizer::syntax S("[].","");
+      tokenizer t(s,S);
+      path_t p;
+      for (t.next(); ; ) {
+        if (t.current().syntax()=='[') {
+          if (t.next().kind()!=token::Symbol)
+            throw InputError("expecting a number");
+          const std::string num = t.current().text();
+          if (num=="+")
+            throw InputError("'[+]' appends to a vector; it can't be set");
+          const char *S=num.c_str();
+          char       *E=NULL;
+          size_t i = strtoul(S,&E,10);
+          if (S==E || *E) throw InputError("unable to parse strange number");
+          if (t.next().syntax()!=']') throw InputError("expecting ']'");
+          if (p.empty()) throw InputError("a superkey starts with a key");
+          p.push_back({std::string(),i,false});
+        }
+        else if (t.current().kind()==token::Symbol)
+          p.push_back({key_t(t.current().text()).str(),0,false});
+        else throw InputError("expecting a key symbol");
+
+        if (t.next().kind()==token::End) return p;
+        if (t.current().syntax()=='.') t.next();
+        else if (t.current().syntax()!='[')
+          throw InputError("expecting '.' or '['");
+      }
+    }
+
+    // spelled for a keyval
+    std::string spelled(const path_t &p) {
+      std::string s;
+      for (size_t i=0; i<p.size(); ++i)
+        if (p[i].key.empty()) s += "[" + std::to_string(p[i].index) + "]";
+        else s += (i ? "." : "") + p[i].key;
+      return s;
+    }
+
+    // a key set, and where its value is written
+    struct target {
+      path_t path;
+      bool   found;
+      size_t begin, end;
+    };
+  }
+
+  // walks keyvals; a friend of the parser for its syntaxes
+  class patch_scan {
+    const char          *b, *e;
+    tokenizer            t;
+    const char          *at; // start of the current token
+    std::vector<target> &ts;
+    path_t               p;  // what the statement read so far writes
+
+    const token &next(const tokenizer::syntax &s) {
+      const char *q = t.position();
+      const token &k = t.next(s);
+      // the token starts after the blanks and comments next() skipped
+      for (;;) {
+        q = scan::space.find_first_not_of(q,e);
+        if (q==e || *q!='#') break;
+        const char *n = static_cast<const char *>(memchr(q,'\n',e-q));
+        q = n ? n : e;
+      }
+      at = q;
+      return k;
+    }
+
+    // a write at p: nothing it bears on is kept, except, if p is
+    // only made a table, what is under its keys
+    void wrote(bool table) {
+      for (size_t i=0; i<ts.size(); ++i) {
+        relation r = relate(p,ts[i].path);
+        if (r!=Apart && !(table && r==Above
+                          && !ts[i].path[p.size()].key.empty()))
+          ts[i].found = false;
+      }
+    }
+
+    // whether some key set is inside the value at p
+    bool inside() const {
+      for (size_t i=0; i<ts.size(); ++i)
+        if (relate(p,ts[i].path)==Above) return true;
+      return false;
+    }
+
+    void value() {
+      size_t begin = at-b;
+      wrote(false);
+      switch (t.current().kind()) {
+      case token::Symbol:
+      case token::String:
+        break;
+      case token::Syntax:
+        switch (t.current().syntax()) {
+        case '!':
+          if (t.next().kind() != token::Symbol)
+            throw InputError("expecting a special symbol");
+          if (t.current().view()!="file")
+            throw InputError("unknown special token");
+          t.next();
+          if (t.current().kind()!=token::Symbol
+              && t.current().kind()!=token::String)
+            throw InputError("!file expected a string or quoted string");
+          break;
+        case '[':
+          if (!inside()) t.skip_brackets();
+          else
+            for (size_t i=0; next(parser::val_syn).syntax()!=']'; ++i) {
+              p.push_back({std::string(),i,false});
+              value();
+              p.pop_back();
+            }
+          break;
+        case '{':
+          if (!inside()) t.skip_brackets();
+          else while (next(parser::key_syn).syntax()!='}') keyval();
+          break;
+        case '?':
+          break;
+        default:
+          throw InputError("expecting '{' or '[' or '?'");
+        }
+        break;
+      default:
+        throw InputError("expecting '{' or '[' or '?' or string");
+      }
+      for (size_t i=0; i<ts.size(); ++i)
+        if (relate(p,ts[i].path)==Same) {
+          ts[i].found = true;
+          ts[i].begin = begin;
+          ts[i].end = t.position()-b;
+        }
+    }
+
+    void keyval() {
+      size_t depth = p.size();
+      if (t.current().syntax()=='!') {
+        if (t.next().kind() != token::Symbol)
+          throw InputError("expecting a special symbol");
+        if (t.current().view()!="include")
+          throw InputError("unknown special token");
+        t.next();
+        if (t.current().kind()!=token::Symbol
+            && t.current().kind()!=token::String)
+          throw InputError("!include expected a string or quoted string");
+        // what the file writes is anyone's guess
+        for (size_t i=0; i<ts.size(); ++i)
+          if (relate(p,ts[i].path)!=Apart) ts[i].found = false;
+        return;
+      }
+      if (t.current().kind()!=token::Symbol)
+        throw InputError("expecting a key symbol");
+      p.push_back({key_t(t.current().text()).str(),0,false});
+      next(parser::key_syn);
+
+      for (;;) {
+        char c = t.current().syntax();
+        if (c=='[') {
+          if (t.next(parser::key_syn).kind()!=token::Symbol)
+            throw InputError("expecting a number");
+          step s = { std::string(), 0, t.current().view()=="+" };
+          if (!s.append) {
+            const std::string num = t.current().text();
+            const char *S=num.c_str();
+            char       *E=NULL;
+            s.index = strtoul(S,&E,10);
+            if (S==E || *E) throw InputError("unable to parse strange number");
+          }
+          if (t.next(parser::key_syn).syntax()!=']')
+            throw InputError("expecting ']'");
+          p.push_back(s);
+          next(parser::key_syn);
+        }
+        else if (c=='.') {
+          next(parser::key_syn);
+          keyval();
+          break;
+        }
+        else if (parser::erasing(t)) {
+          erased();
+          break;
+        }
+        else if (c=='{') {
+          wrote(true);
+          while (next(parser::key_syn).syntax()!='}') keyval();
+          break;
+        }
+        else if (c=='=') {
+          next(parser::val_syn);
+          value();
+          break;
+        }
+        else throw InputError("expecting '.' or '=' or '{'");
+      }
+      p.resize(depth);
+    }
+
+    void erased() {
+      wrote(false);
+      if (!p.back().key.empty()) return;
+      // the elements after it move down
+      path_t v(p.begin(),p.end()-1);
+      for (size_t i=0; i<ts.size(); ++i)
+        if (relate(v,ts[i].path)==Above && ts[i].path[v.size()].key.empty())
+          ts[i].found = false;
+    }
+
+  public:
+    patch_scan(const char *begin,size_t n,std::vector<target> &targets)
+      : b(begin), e(begin+n), t(begin,n,parser::no_syn), at(begin),
+        ts(targets) {}
+
+    void run(const std::string &name) {
+      try {
+        while (next(parser::key_syn).kind()!=token::End) keyval();
+      }
+      catch (exception &x) {
+        std::ostringstream o;
+        o << x.what() << "\n"
+          << "parse problem at " << (name.empty() ? "???" : name.c_str())
+          << ":" << t.lineno() << ":" << t.colno();
+        throw InputError(o.str());
+      }
+    }
+  };
+
+  patch &patch::set(const std::string &superkey,const ark &value) {
+    edit d;
+    d.key = spelled(steps_of(superkey));
+    std::ostringstream o;
+    o << printer()(value);
+    d.text = o.str();
+    edits.push_back(d);
+    return *this;
+  }
+
+  size_t patch::apply(std::ostream &out,const char *b,size_t n,
+                      const std::string &name) const {
+    std::vector<target> ts(edits.size());
+    for (size_t i=0; i<ts.size(); ++i) {
+      ts[i].path = steps_of(edits[i].key);
+      ts[i].found = false;
+    }
+    patch_scan(b,n,ts).run(name);
+
+    // values set twice, or one inside another, are appended in order
+    for (size_t i=0; i<ts.size(); ++i)
+      for (size_t j=i+1; j<ts.size(); ++j)
+        if (ts[i].found && ts[j].found
+            && ts[i].begin<ts[j].end && ts[j].begin<ts[i].end)
+          ts[i].found = ts[j].found = false;
+    // and so is anything set after an appended key it bears on
+    for (size_t i=0; i<ts.size(); ++i)
+      if (!ts[i].found)
+        for (size_t j=i+1; j<ts.size(); ++j)
+          if (relate(ts[i].path,ts[j].path)!=Apart) ts[j].found = false;
+
+    std::vector<size_t> order;
+    for (size_t i=0; i<ts.size(); ++i) if (ts[i].found) order.push_back(i);
+    std::sort(order.begin(),order.end(),[&](size_t x,size_t y) {
+        return ts[x].begin<ts[y].begin;
+      });
+    size_t from = 0;
+    for (size_t k=0; k<order.size(); ++k) {
+      const target &g = ts[order[k]];
+      out.write(b+from,g.begin-from);
+      out << edits[order[k]].text;
+      from = g.end;
+    }
+    out.write(b+from,n-from);
+
+    bool line = !n || b[n-1]=='\n';
+    for (size_t i=0; i<ts.size(); ++i)
+      if (!ts[i].found) {
+        if (!line) out << '\n';
+        line = true;
+        out << edits[i].key << " = " << edits[i].text << '\n';
+      }
+    return order.size();
+  }
+
+  size_t patch::apply_file(const std::string &path,const std::string &to) const {
+    file_source in(path);
+    const char *b = in.data();
+    size_t n = in.size();
+    std::string plain;
+    if (compression_of(b,n)) {
+      inflater z(b,n);
+      std::ostringstream o;
+      o << z.rdbuf();
+      plain = o.str();
+      b = plain.data();
+      n = plain.size();
+    }
+
+    std::string out = to.empty() ? path : to;
+    std::string tmp = out + ".XXXXXX";
+    int fd = mkstemp(&tmp[0]);
+    if (fd==-1)
+      throw exception("unable to write file: " + out + " (" + strerror(errno) + ")");
+    // mkstemp makes it private; the result is as readable as the input
+    struct stat st;
+    if (stat(path.c_str(),&st)==0) fchmod(fd,st.st_mode & 07777);
+    close(fd);
+
+    size_t done;
+    try {
+      std::ofstream f(tmp.c_str(),std::ios::binary|std::ios::trunc);
+      deflater z(f,compression_for(out));
+      done = apply(z,b,n,path);
+      z.finish();
+      f.close();
+      if (!z || !f) throw exception("unable to write file: " + out);
+      if (rename(tmp.c_str(),out.c_str())==-1)
+        throw exception("unable to replace file: " + out + " ("
+                        + strerror(errno) + ")");
+    }
+    catch (...) {
+      unlink(tmp.c_str());
+      throw;
+    }
+    return done;
+  }
+
+  bool patch::locate(const char *b,size_t n,const std::string &superkey,
+                     size_t &begin,size_t &end) {
+    std::vector<target> ts(1);
+    ts[0].path = steps_of(superkey);
+    ts[0].found = false;
+    patch_scan(b,n,ts).run("");
+    begin = ts[0].begin;
+    end = ts[0].end;
+    return ts[0].found;
+  }
+}
@@ -0,0 +1,96 @@
+#ifndef ark_patch_hpp
+#define ark_patch_hpp
+
+#include "base.hpp"
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/*! \file ark/patch.hpp
+
+A patch sets superkeys in keyvals text without parsing it into an ark
+and printing it again.  The text is tokenized once, building nothing,
+to find where the value each superkey ends up with is written; the
+new value, printed, goes in its place, and everything else is copied
+through as it was, layout and comments included.  Making one variant
+of a large generated file then costs a scan and a copy.
+
+Example:
+<code>
+\verbatim
+    Ark::ark t;
+    t = "310";
+    Ark::patch().set("mdsim.temperature",t).apply_file("base.ark","run17.ark");
+\endverbatim
+</code>
+
+The text parses as it would have with each superkey assigned at its
+end, in the order they were set; that is what a patch appends when
+the value can't be replaced where it stands: when the key isn't in
+the text, or a later keyval or !include changes part of its value,
+or another key set overlaps it.  Includes aren't read, so a key
+whose value only comes from an included file is appended too.
+*/
+
+namespace Ark {
+
+  //! Sets superkeys in keyvals text, in place where it can.
+  class patch {
+    //! one superkey to set.
+    struct edit {
+      std::string key;   //!< the superkey.
+      std::string text;  //!< its value, printed.
+    };
+    std::vector<edit> edits;
+
+  public:
+    /*! set a superkey.
+      @param superkey key, as ark::xget() takes it; "[+]" isn't one.
+      Throws InputError if it can't be parsed.
+      @param value its new value.
+      @return reference to this patch.
+    */
+    patch &set(const std::string &superkey,const ark &value);
+
+    /*! write keyvals text with the keys set.  Throws InputError for
+      the syntax errors the scan meets; values it skips over are only
+      checked for matching brackets and quotes, and errors that only
+      applying the keyvals would find, such as an index past the end
+      of a vector, aren't looked for.  Text that doesn't parse may
+      then be patched anyway.
+      @param out where to write it.
+      @param b start of the text.
+      @param n its length.
+      @param name file name for error messages.
+      @return how many keys were set in place; the rest were appended.
+    */
+    size_t apply(std::ostream &out,const char *b,size_t n,
+                 const std::string &name="") const;
+
+    /*! patch a file, replacing the output atomically: it is written
+      to a new file in the same directory, which is then renamed over
+      the output.  A compressed file is inflated first, and the
+      output compressed by its name, as printer_ref::save() does.
+      @param path file to read.
+      @param to file to write, or empty for path itself.
+      @return how many keys were set in place.
+    */
+    size_t apply_file(const std::string &path,const std::string &to="") const;
+
+    /*! where a superkey's value is written in keyvals text, if it is
+      written in one place that could be replaced.
+      @param b start of the text.
+      @param n its length.
+      @param superkey the key.
+      @param begin set to the offset of the value's first byte.
+      @param end set to the offset just past it.
+      @return false if the value can't be replaced in place.
+    */
+    static bool locate(const char *b,size_t n,const std::string &superkey,
+                       size_t &begin,size_t &end);
+  };
+}
+
+#endif
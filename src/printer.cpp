@@ -1,18 +1,35 @@
 #include "printer.hpp"
+#include "compress.hpp"
 #include "parser.hpp" // for syntax definitions
 
+#include <fstream>
 #include <sstream>
 #include <climits>
+#include <cstring>
 
 namespace Ark {
 
   static bool requires_quotes(atom_t const& a) {
-    if (a.c_str()[0] == '\0') return true;
-    tokenizer::syntax const& syn = parser::val_syn;
-    for (const char* c = a.c_str(); *c; ++c) {
-      if (syn.is_reserved(*c) || isspace(*c) || *c=='\\') return true;
+    const char *s = a.c_str();
+    if (s[0] == '\0') return true;
+    // anything that would end a bare symbol, plus escapes
+    static const charset special =
+      charset(parser::val_syn.symbol_stops()).add('\\');
+    const char *e = s+strlen(s);
+    return special.find_first_of(s,e) != e;
+  }
+
+  // write s with backslashes in front of backslashes and double quotes
+  static void write_escaped(std::ostream &o,const char *s) {
+    static const charset escapes("\\\"",2);
+    const char *e = s+strlen(s);
+    for (;;) {
+      const char *p = escapes.find_first_of(s,e);
+      o.write(s,p-s);
+      if (p==e) break;
+      o << '\\' << *p;
+      s = p+1;
     }
-    return false;
   }
 
   void fdump(FILE *f,const ark &a) {
@@ -77,8 +94,7 @@ namespace Ark {
         }
         const bool with_quotes = !whitespace || requires_quotes(a.atom());
         if (with_quotes) oss<<"\"";
-        for(; *s ; oss<<*s, ++s)
-          if (*s=='\\' || *s=='"') oss<<"\\";
+        write_escaped(oss,s);
         if (with_quotes) oss<<"\"";
         o<<oss.str();
       } break;
@@ -130,8 +146,7 @@ namespace Ark {
         }
         const bool with_quotes = !whitespace || requires_quotes(a.atom());
         if (with_quotes) oss<<"\"";
-        for(; *s ; oss<<*s, ++s)
-          if (*s=='\\' || *s=='"') oss<<"\\";
+        write_escaped(oss,s);
         if (with_quotes) oss<<"\"";
         o<<oss.str(), col+=oss.str().size();
       }
@@ -231,6 +246,17 @@ namespace Ark {
     output(fs);
   }
 
+  void printer::printer_ref::save(const std::string &path) const {
+    std::ofstream f(path.c_str(),std::ios::binary);
+    if (!f) throw exception("unable to write file: " + path);
+    deflater z(f,compression_for(path));
+    output(z);
+    if (!flags.whitespace) z << '\n';
+    z.finish();
+    f.close();
+    if (!z || !f) throw exception("unable to write file: " + path);
+  }
+
 }
 
 std::ostream &operator<<(std::ostream &o,const Ark::printer::printer_ref &x) {
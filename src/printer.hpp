@@ -80,6 +80,11 @@ namespace Ark {
       //! public function to be called on C-style streams.
       //! @param f C-style stream.
       void fprint(FILE *f) const;
+      /*! write to a file, replacing it, compressed if its name ends in
+        .gz or .zst (see compress.hpp).  Throws exception if it can't.
+        @param path file name.
+      */
+      void save(const std::string &path) const;
     };
 
     //! trivial default constructor.
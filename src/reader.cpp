@@ -105,9 +105,8 @@ namespace Ark {
   }
 
   void reader::follow(const std::string &s) {
-    tokenizer::syntax S("[].!","");
-    std::istringstream In(s);
-    tokenizer t(In,S);
+    static const tokenizer::syntax S("[].!","");
+    tokenizer t(s,S);
     t.next();
     while( t.current().kind() != token::End ) {
       // bounce search if symbol without a dot
@@ -0,0 +1,189 @@
+#include "exception.hpp"
+#include "records.hpp"
+
+#include <atomic>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <system_error>
+#include <thread>
+
+/* Ark streams.  Records are read from the stream in turn, which only
+   costs a look at each length, and parsed each on its own; next()
+   with a vector reads a batch of them and parses it on threads,
+   keeping what is left of it, errors included, for the calls after. */
+
+namespace Ark {
+
+  namespace {
+    // longest length taken, in digits
+    const unsigned max_digits = 19;
+    // most of a record's body read at once
+    const size_t chunk = 1<<16;
+
+    std::string where(const std::string &name,size_t which,size_t at) {
+      std::ostringstream o;
+      o << "record " << which << " of "
+        << (name.empty() ? "???" : name.c_str()) << " at byte " << at;
+      return o.str();
+    }
+  }
+
+  record_writer::record_writer(std::ostream &o,const printer &p)
+    : out(&o), P(p), count(0) {
+    P.no_delim(false).flatten(false);
+  }
+
+  record_writer &record_writer::write(const ark &a) {
+    std::ostringstream o;
+    o << P(a);
+    text = o.str();
+    *out << text.size() << ' ';
+    out->write(text.data(),text.size());
+    *out << '\n';
+    ++count;
+    return *this;
+  }
+
+  record_reader::record_reader(std::istream &i,const std::string &file,
+                               bool c)
+    : in(&i), name(file), check(c), count(0), offset(0) {}
+
+  //private:
+  bool record_reader::take(std::string &text) {
+    if (lost) std::rethrow_exception(lost);
+    size_t n = 0;
+    unsigned digits = 0;
+    int c;
+    while ((c = in->get()) != EOF && c>='0' && c<='9' && digits<max_digits) {
+      n = 10*n + (c-'0');
+      ++digits;
+    }
+    if (c==EOF && !digits) return false;
+    if (c!=' ' || !digits) {
+      lost = std::make_exception_ptr(InputError(
+        "bad record length\n" + where(name,count+1,offset+digits)));
+      std::rethrow_exception(lost);
+    }
+    // the length is only a claim: the body is taken as it comes, so a
+    // stream that claims more than it has runs out before memory does
+    text.clear();
+    for (size_t left = n; left; ) {
+      size_t had = text.size(), want = left<chunk ? left : chunk;
+      text.resize(had+want);
+      in->read(&text[had],want);
+      size_t got = in->gcount();
+      if (got!=want) {
+        text.resize(had+got);
+        break;
+      }
+      left -= got;
+    }
+    if (text.size() != n || in->get() != '\n') {
+      lost = std::make_exception_ptr(InputError(
+        "record cut short\n" + where(name,count+1,offset)));
+      std::rethrow_exception(lost);
+    }
+    ++count;
+    offset += digits+n+2;
+    return true;
+  }
+
+  //private:
+  void record_reader::decode(ark &a,const std::string &text,size_t which,
+                             size_t at) const {
+    try {
+      a = parse_trusted(text,check);
+    }
+    catch (exception &e) {
+      std::string m = e.what();
+      if (m.empty() || m[m.size()-1]!='\n') m += '\n';
+      throw InputError(m + where(name,which,at));
+    }
+  }
+
+  //private:
+  void record_reader::read_ahead(size_t most,unsigned threads) {
+    // read the batch
+    std::vector<std::string> texts;
+    std::vector<size_t> starts;
+    size_t first = count+1;
+    std::exception_ptr cut;
+    try {
+      std::string text;
+      for (size_t at = offset; texts.size()<most && take(text); at = offset) {
+        texts.push_back(std::string());
+        texts.back().swap(text);
+        starts.push_back(at);
+      }
+    }
+    catch (exception &) {
+      cut = std::current_exception();
+    }
+
+    // and parse it
+    std::vector<decoded> batch(texts.size());
+    std::atomic<size_t> taken(0);
+    auto work = [&]() {
+      for (size_t i; (i = taken++) < texts.size(); ) {
+        try {
+          decode(batch[i].a,texts[i],first+i,starts[i]);
+        }
+        catch (...) {
+          batch[i].error = std::current_exception();
+        }
+        std::string().swap(texts[i]);
+      }
+    };
+    unsigned nt = threads ? threads : std::thread::hardware_concurrency();
+    std::vector<std::thread> pool;
+    try {
+      for (unsigned i=1; i<nt && i<texts.size(); ++i) pool.emplace_back(work);
+    }
+    catch (std::system_error &) {
+      // make do with the threads we have
+    }
+    work();
+    for (size_t i=0; i<pool.size(); ++i) pool[i].join();
+
+    for (size_t i=0; i<batch.size(); ++i) ahead.push_back(std::move(batch[i]));
+    if (cut) {
+      ahead.push_back(decoded());
+      ahead.back().error = cut;
+    }
+  }
+
+  bool record_reader::next(ark &a) {
+    if (ahead.empty()) {
+      size_t at = offset;
+      std::string text;
+      if (!take(text)) return false;
+      decode(a,text,count,at);
+      return true;
+    }
+    decoded d(std::move(ahead.front()));
+    ahead.pop_front();
+    if (d.error) std::rethrow_exception(d.error);
+    a.swap(d.a);
+    return true;
+  }
+
+  size_t record_reader::next(std::vector<ark> &out,size_t most,
+                             unsigned threads) {
+    out.clear();
+    if (ahead.empty()) read_ahead(most,threads);
+    while (!ahead.empty() && out.size()<most) {
+      decoded &d = ahead.front();
+      if (d.error) {
+        // records before it come first
+        if (!out.empty()) break;
+        std::exception_ptr e = d.error;
+        ahead.pop_front();
+        std::rethrow_exception(e);
+      }
+      out.push_back(std::move(d.a));
+      ahead.pop_front();
+    }
+    return out.size();
+  }
+}
@@ -0,0 +1,142 @@
+#ifndef ark_records_hpp
+#define ark_records_hpp
+
+#include "printer.hpp"
+
+#include <deque>
+#include <exception>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/*! \file ark/records.hpp
+
+An ark stream is a sequence of arks, the records, in one file or
+pipe: a log of per-step state, say.  Each record takes one line or
+more, as the printer wrote it, after its length in bytes:
+
+<code>
+\verbatim
+    17 {step="1"x="0.5"}
+    34 {note="two
+    lines"step="2"x="0.75"}
+\endverbatim
+</code>
+
+The lengths make record boundaries unambiguous (a string may hold
+newlines, braces and anything else) and cheap to find: a reader hops
+from one to the next without looking at what is between.  Streams can
+be concatenated with cat, and appended to with arkcat --record.
+
+Example:
+<code>
+\verbatim
+    Ark::record_writer w(out);
+    w.write(state);
+    ...
+    Ark::record_reader r(in);
+    Ark::ark a;
+    while (r.next(a)) use(a);
+\endverbatim
+</code>
+
+A record is read back with parse_trusted(), so it may be any ark a
+printer prints with delimiters, and anything else in its text is an
+error, as it is for parse().
+*/
+
+namespace Ark {
+
+  //! Writes arks to an ark stream.
+  class record_writer {
+    std::ostream *out;     //!< where records go.
+    printer       P;       //!< how they are printed.
+    std::string   text;    //!< the record being written.
+    size_t        count;   //!< records written.
+
+  public:
+    /*! Constructor.
+      @param o stream to write to; must outlive the writer.
+      @param p printer to print records with.  Its whitespace, width,
+      indent and open_tables settings are kept; records are always
+      printed with their delimiters and never flattened, so that they
+      read back as they were.
+    */
+    explicit record_writer(std::ostream &o,const printer &p=printer());
+
+    /*! write one record.
+      @param a the ark to write.
+      @return reference to this writer.
+    */
+    record_writer &write(const ark &a);
+
+    //! records written so far.
+    //! @return count.
+    size_t written() const { return count; }
+  };
+
+  //! Reads arks from an ark stream, one by one or several at a time.
+  class record_reader {
+    std::istream *in;      //!< where records come from.
+    std::string   name;    //!< for messages.
+    bool          check;   //!< passed to parse_trusted().
+    size_t        count;   //!< records taken from the stream.
+    size_t        offset;  //!< bytes taken from the stream.
+    std::exception_ptr lost; //!< why no more records can be found.
+
+    //! a record read and parsed, or why it couldn't be.
+    struct decoded {
+      ark                a;
+      std::exception_ptr error;
+    };
+    std::deque<decoded> ahead; //!< parsed but not returned yet.
+
+    bool take(std::string &text);
+    void decode(ark &a,const std::string &text,size_t which,
+                size_t at) const;
+    void read_ahead(size_t most,unsigned threads);
+
+  public:
+    /*! Constructor.
+      @param i stream to read from; must outlive the reader.
+      @param file name used in error messages; may be empty.
+      @param check as for parse_trusted(); a stream written by
+      record_writer can skip it.
+    */
+    explicit record_reader(std::istream &i,
+                           const std::string &file=std::string(),
+                           bool check=true);
+
+    /*! read the next record.
+      @param a ark to hold it.
+      @return false, leaving a alone, at the end of the stream.  A
+      record that doesn't parse is an error, and the next call reads
+      the one after it; a bad length, or a stream that ends inside a
+      record, is an error for this call and every call after it.
+    */
+    bool next(ark &a);
+
+    /*! read up to most records, decoding them on threads.  The
+      records are read from the stream in turn and then parsed
+      concurrently; they, and any error, come out as next() would
+      give them one by one: records before a bad one are returned
+      first, the error is thrown by the following call, and the
+      records after it by the calls after that.
+      @param out records, in stream order; replaces what was there.
+      @param most how many records to read at most.
+      @param threads number of threads that parse, with 0 meaning one
+      per core.
+      @return number of records read, 0 at the end of the stream.
+    */
+    size_t next(std::vector<ark> &out,size_t most,unsigned threads=0);
+
+    //! records read so far.
+    //! @return count.
+    size_t records() const { return count; }
+    //! bytes read so far.
+    //! @return count.
+    size_t bytes() const { return offset; }
+  };
+}
+
+#endif
@@ -0,0 +1,199 @@
+#include "scan.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define ARK_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace Ark {
+
+  charset::charset() : n(0), vector_ok(true) {
+    memset(member,0,sizeof(member));
+    memset(lo,0,sizeof(lo));
+    memset(hi,0,sizeof(hi));
+    // every ASCII high nibble gets its own bit; lo[] then says which
+    // low nibbles are members for each of them.
+    for (unsigned h=0; h<8; ++h) hi[h] = 1u<<h;
+  }
+
+  charset::charset(const char *s,size_t len) : charset() {
+    for (size_t i=0; i<len; ++i) add(s[i]);
+  }
+
+  charset &charset::add(char c) {
+    unsigned char u = c;
+    if (member[u]) return *this;
+    member[u] = 1;
+    if (u>=0x80 || n==sizeof(chars)) vector_ok = false;
+    else {
+      lo[u&15] |= 1u<<(u>>4);
+      chars[n++] = c;
+    }
+    return *this;
+  }
+
+  charset &charset::add(const char *s) {
+    for ( ; *s; ++s) add(*s);
+    return *this;
+  }
+
+  //! The kernels, one set per instruction set.
+  struct scan_kernels {
+    typedef const char *(*kernel_t)(const charset &,const char *,const char *);
+    typedef uint64_t (*mask_t)(const charset &,const char *);
+
+    template <bool Member>
+    static const char *scalar(const charset &s,const char *b,const char *e) {
+      while (b!=e && bool(s.member[(unsigned char)*b])!=Member) ++b;
+      return b;
+    }
+
+    static uint64_t scalar_mask(const charset &s,const char *p) {
+      uint64_t m = 0;
+      for (unsigned i=0; i<64; ++i)
+        m |= uint64_t(s.member[(unsigned char)p[i]]) << i;
+      return m;
+    }
+
+#ifdef ARK_SCAN_X86
+    template <bool Member>
+    static const char *sse2(const charset &s,const char *b,const char *e) {
+      if (!s.vector_ok) return scalar<Member>(s,b,e);
+      __m128i c[sizeof(s.chars)];
+      for (unsigned i=0; i<s.n; ++i) c[i] = _mm_set1_epi8(s.chars[i]);
+      for ( ; e-b>=16; b+=16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)b);
+        __m128i m = _mm_setzero_si128();
+        for (unsigned i=0; i<s.n; ++i) m = _mm_or_si128(m,_mm_cmpeq_epi8(x,c[i]));
+        unsigned bits = _mm_movemask_epi8(m);
+        if (!Member) bits = ~bits & 0xffff;
+        if (bits) return b+__builtin_ctz(bits);
+      }
+      return scalar<Member>(s,b,e);
+    }
+
+    static uint64_t sse2_mask(const charset &s,const char *p) {
+      if (!s.vector_ok) return scalar_mask(s,p);
+      uint64_t bits = 0;
+      for (unsigned j=0; j<64; j+=16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p+j));
+        __m128i m = _mm_setzero_si128();
+        for (unsigned i=0; i<s.n; ++i)
+          m = _mm_or_si128(m,_mm_cmpeq_epi8(x,_mm_set1_epi8(s.chars[i])));
+        bits |= uint64_t(unsigned(_mm_movemask_epi8(m))) << j;
+      }
+      return bits;
+    }
+
+    template <bool Member>
+    __attribute__((target("avx2")))
+    static const char *avx2(const charset &s,const char *b,const char *e) {
+      if (!s.vector_ok) return scalar<Member>(s,b,e);
+      const __m256i lo = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s.lo));
+      const __m256i hi = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s.hi));
+      const __m256i nib = _mm256_set1_epi8(0x0f);
+      const __m256i zero = _mm256_setzero_si256();
+      for ( ; e-b>=32; b+=32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)b);
+        __m256i l = _mm256_shuffle_epi8(lo,_mm256_and_si256(x,nib));
+        __m256i h = _mm256_shuffle_epi8(
+          hi,_mm256_and_si256(_mm256_srli_epi16(x,4),nib));
+        // bits set where the byte is NOT a member
+        unsigned bits = _mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(_mm256_and_si256(l,h),zero));
+        if (Member) bits = ~bits;
+        if (bits) return b+__builtin_ctz(bits);
+      }
+      return sse2<Member>(s,b,e);
+    }
+
+    __attribute__((target("avx2")))
+    static uint64_t avx2_mask(const charset &s,const char *p) {
+      if (!s.vector_ok) return scalar_mask(s,p);
+      const __m256i lo = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s.lo));
+      const __m256i hi = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((const __m128i *)s.hi));
+      const __m256i nib = _mm256_set1_epi8(0x0f);
+      const __m256i zero = _mm256_setzero_si256();
+      uint64_t bits = 0;
+      for (unsigned j=0; j<64; j+=32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p+j));
+        __m256i l = _mm256_shuffle_epi8(lo,_mm256_and_si256(x,nib));
+        __m256i h = _mm256_shuffle_epi8(
+          hi,_mm256_and_si256(_mm256_srli_epi16(x,4),nib));
+        unsigned out = _mm256_movemask_epi8(
+          _mm256_cmpeq_epi8(_mm256_and_si256(l,h),zero));
+        bits |= uint64_t(~out) << j;
+      }
+      return bits;
+    }
+#endif
+
+    kernel_t first_of, first_not_of;
+    mask_t members;
+    scan::level_t level;
+
+    scan::level_t select(scan::level_t l) {
+      if (l > scan::best()) l = scan::best();
+      switch (l) {
+#ifdef ARK_SCAN_X86
+      case scan::AVX2:
+        first_of = avx2<true>;   first_not_of = avx2<false>;
+        members = avx2_mask;     break;
+      case scan::SSE2:
+        first_of = sse2<true>;   first_not_of = sse2<false>;
+        members = sse2_mask;     break;
+#endif
+      default:
+        l = scan::Scalar;
+        first_of = scalar<true>; first_not_of = scalar<false>;
+        members = scalar_mask;   break;
+      }
+      return level = l;
+    }
+
+    scan_kernels() { select(scan::best()); }
+  };
+
+  namespace {
+    scan_kernels &kernels() {
+      static scan_kernels k;
+      return k;
+    }
+  }
+
+  const char *charset::find_first_of(const char *b,const char *e) const {
+    return kernels().first_of(*this,b,e);
+  }
+
+  const char *charset::find_first_not_of(const char *b,const char *e) const {
+    return kernels().first_not_of(*this,b,e);
+  }
+
+  uint64_t charset::members(const char *p) const {
+    return kernels().members(*this,p);
+  }
+
+  namespace scan {
+    const charset space(" \t\n\v\f\r",6);
+
+    level_t best() {
+#ifdef ARK_SCAN_X86
+      __builtin_cpu_init();
+      if (__builtin_cpu_supports("avx2")) return AVX2;
+      return SSE2;
+#else
+      return Scalar;
+#endif
+    }
+
+    level_t level() { return kernels().level; }
+
+    level_t use(level_t l) { return kernels().select(l); }
+  }
+}
@@ -0,0 +1,99 @@
+#ifndef ark_scan_hpp
+#define ark_scan_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+/*! \file ark/scan.hpp
+
+Character scanning kernels used by the tokenizer and the printer.  A
+charset is a precomputed set of bytes; the scan functions find the
+first byte of a range that is (or is not) in a set.  On x86-64 they
+look at 16 (SSE2) or 32 (AVX2) bytes at a time, choosing the widest
+instruction set the CPU supports at run time, and otherwise fall back
+to a table-driven scalar loop.
+*/
+
+namespace Ark {
+
+  /*! A set of bytes, with the lookup tables the scan kernels need
+    precomputed. */
+  class charset {
+    friend struct scan_kernels;
+    unsigned char member[256]; //!< 1 for bytes in the set.
+    unsigned char lo[16];      //!< nibble table, indexed by low nibble.
+    unsigned char hi[16];      //!< nibble table, indexed by high nibble.
+    char          chars[32];   //!< the members, for compare-based kernels.
+    unsigned      n;           //!< number of members.
+    bool          vector_ok;   //!< all members are ASCII and n <= 32.
+
+  public:
+    //! empty set.
+    charset();
+    /*! set holding the first n bytes of s.
+      @param s members.
+      @param n number of members.
+    */
+    charset(const char *s,size_t n);
+
+    //! add a byte to the set.
+    //! @param c byte.
+    //! @return reference to this set.
+    charset &add(char c);
+    //! add every byte of a C-string to the set.
+    //! @param s bytes.
+    //! @return reference to this set.
+    charset &add(const char *s);
+
+    //! test for membership.
+    //! @param c byte.
+    //! @return whether c is in the set.
+    bool contains(char c) const { return member[(unsigned char)c]; }
+
+    /*! find the first member of the set in [b,e).
+      @param b start of range.
+      @param e end of range.
+      @return pointer to the first member, or e.
+    */
+    const char *find_first_of(const char *b,const char *e) const;
+    /*! find the first non-member of the set in [b,e).
+      @param b start of range.
+      @param e end of range.
+      @return pointer to the first non-member, or e.
+    */
+    const char *find_first_not_of(const char *b,const char *e) const;
+    /*! which of 64 bytes are members of the set.
+      @param p start of the bytes; all 64 must be readable.
+      @return bit i set when p[i] is a member.
+    */
+    uint64_t members(const char *p) const;
+  };
+
+  //! run-time selection of the scanning kernels.
+  namespace scan {
+    //! instruction set used by the charset kernels.
+    enum level_t {
+      Scalar=0, //!< portable table lookups.
+      SSE2,     //!< 16 bytes at a time.
+      AVX2      //!< 32 bytes at a time.
+    };
+    //! the best level this CPU supports.
+    //! @return level.
+    level_t best();
+    //! the level currently in use (initially best()).
+    //! @return level.
+    level_t level();
+    /*! select a level, e.g. for testing.  Levels the CPU does not
+      support are lowered to best().  Not safe to call while other
+      threads are scanning.
+      @param l requested level.
+      @return the level now in use.
+    */
+    level_t use(level_t l);
+
+    //! the C locale whitespace characters " \t\n\v\f\r".
+    extern const charset space;
+  }
+}
+
+#endif
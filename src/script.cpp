@@ -0,0 +1,247 @@
+#include "exception.hpp"
+#include "parser.hpp"
+
+#include <sstream>
+#include <cstdlib>
+
+/* Compiling keyvals into statements and applying them.  These mirror
+   parser::parse_keyvalue() and parser::descend() step for step: the
+   compile side does all the tokenizing and value parsing, and the
+   apply side does whatever depends on the ark being parsed into, in
+   the same order and with the same errors. */
+
+namespace Ark {
+
+  namespace {
+    // statements we own give up their keys and values; shared ones
+    // are copied from
+    key_t key_of(statement::step &k) { return key_t(std::move(k.key)); }
+    key_t key_of(const statement::step &k) { return key_t(k.key); }
+    ark &&value_of(statement &s) { return std::move(s.value); }
+    const ark &value_of(const statement &s) { return s.value; }
+
+    // the message parse_keyvals() would have thrown from line:col
+    std::string where(const std::string &what,const char *msg,
+                      const char *file,unsigned line,unsigned col) {
+      std::ostringstream o;
+      o << what << "\n"
+        << msg << " at " << (file?file:"???")
+        << ":" << line << ":" << col;
+      return o.str();
+    }
+  }
+
+  //private:
+  void parser::compile(script_t &s,tokenizer &t) const {
+    while( t.next(key_syn).kind()!=token::End ) {
+      s.emplace_back();
+      compile_keyvalue(s.back(),t);
+    }
+  }
+  //private:
+  void parser::compile_keyvalue(statement &s,tokenizer &t) const {
+    // check for !include and other key-like specials
+    if (t.current().kind()==token::Syntax
+        && t.current().syntax()=='!') {
+      if (t.next().kind() != token::Symbol)
+        throw InputError("expecting a special symbol");
+
+      if (t.current().view()=="include") {
+        t.next();
+        if (t.current().kind()==token::Symbol
+            || t.current().kind()==token::String) {
+          s.op   = statement::Include;
+          s.file = t.current().text();
+          s.line = t.lineno();
+          s.col  = t.colno();
+        }
+        else
+          throw InputError("!include expected a string or quoted string");
+      }
+      else
+        throw InputError("unknown special token");
+      return;
+    } // nothing special
+
+    // OK, I expect to see a key now
+    if (t.current().kind()!=token::Symbol)
+      throw InputError("expecting a key symbol");
+
+    statement::step k;
+    k.key = key_t(t.current().text()).str(); // check it now
+    k.offset = 0;
+    k.append = false;
+    k.line = k.col = 0;
+    s.path.push_back(k);
+    t.next(key_syn);
+
+    // possible special syntax for !erase
+    if (t.current().kind()==token::Syntax
+        && t.current().syntax()=='!') {
+      if (t.next().kind() != token::Symbol)
+        throw InputError("expecting a special symbol");
+
+      if (t.current().view()=="erase") {
+        s.op = statement::Erase;
+      }
+      else
+        throw InputError("unknown special token");
+      return;
+    } // nothing special
+
+    compile_descend(s,t);
+  }
+  //private:
+  void parser::compile_descend(statement &s,tokenizer &t) const {
+    if (t.current().syntax()=='[') {
+      statement::step i;
+      i.offset = 0;
+
+      // read a number or "+"
+      if (t.next(key_syn).kind()!=token::Symbol)
+        throw InputError("expecting a number");
+      i.append = (t.current().view()=="+");
+      if (!i.append) {
+        const std::string num = t.current().text();
+        const char * S=num.c_str();
+        char       * E=NULL;
+        i.offset = strtoul(S,&E,10);
+        if (S==E || *E) throw InputError("unable to parse strange number");
+      }
+      // read ']'
+      if (t.next(key_syn).syntax()!=']') throw InputError("expecting ']'");
+      i.line = t.lineno();
+      i.col  = t.colno();
+      s.path.push_back(i);
+      t.next(key_syn); // get next and keep descending
+
+      // possible special syntax for !erase
+      if (t.current().kind()==token::Syntax
+          && t.current().syntax()=='!') {
+        if (t.next().kind() != token::Symbol)
+          throw InputError("expecting a special symbol");
+
+        if (t.current().view()=="erase") {
+          s.op = statement::Erase;
+        }
+        else
+          throw InputError("unknown special token");
+        return;
+      } // nothing special
+
+      compile_descend(s,t);
+    }
+    else if (t.current().syntax()=='.') {
+      t.next(key_syn); // back into a keyvals context
+      compile_keyvalue(s,t);
+    }
+    else if (t.current().syntax()=='{') {
+      // namespace
+      s.op = statement::Open;
+      while( t.next(key_syn).syntax()!='}') {
+        s.body.emplace_back();
+        compile_keyvalue(s.body.back(),t);
+      }
+    }
+    else if (t.current().syntax()=='=') {
+      // assignment
+      t.next(val_syn);
+      s.op = statement::Assign;
+      compile_value(s,t);
+    }
+    else throw InputError("expecting '.' or '=' or '{'");
+  }
+  //private:
+  void parser::compile_value(statement &s,tokenizer &t) const {
+    // an include inside the value is only noted: the file has to be
+    // read when the statement is applied, as a direct parse reads it,
+    // so the value is compiled again, as an empty table or vector and
+    // the statements that fill it in
+    const char *b = t.current().view().data();
+    unsigned line = t.lineno(), col = t.colno()-1;
+    bool includes = false;
+    s.value = parse_value(t,NULL,&includes);
+    if (!includes) return;
+    if (!t.buffered())
+      throw InputError("include inside a value of a stream"); // parsed directly
+
+    tokenizer u(b,t.current().view().data()+1-b,no_syn,line,col);
+    s.value.clear();
+    if (u.next(val_syn).syntax()=='[') {
+      s.value.be(Vector);
+      for (unsigned i=0; u.next(val_syn).syntax()!=']'; ++i) {
+        s.body.emplace_back();
+        statement &e = s.body.back();
+        statement::step k;
+        k.offset = i;
+        k.append = false;
+        k.line = k.col = 0;
+        e.path.push_back(k);
+        compile_value(e,u);
+      }
+    }
+    else {
+      s.value.be(Table);
+      while( u.next(key_syn).syntax()!='}') {
+        s.body.emplace_back();
+        compile_keyvalue(s.body.back(),u);
+      }
+    }
+  }
+  //private:
+  template <typename Statement>
+  void parser::apply(ark &a,Statement &s) const {
+    ark *p = &a;
+    size_t n = s.path.size();
+    for (size_t j=0; j<n; ++j) {
+      auto &k = s.path[j];
+      bool last = (j+1==n && s.op==statement::Erase);
+      if (!k.key.empty()) {
+        table_t &d=p->be(Table).table();
+        if (last) { d.erase(k.key); return; }
+        p = &d[key_of(k)];
+      }
+      else {
+        vector_t &v=p->be(Vector).vector();
+        size_t offset = k.append ? v.size() : k.offset;
+        if (offset==v.size()) v.emplace_back();
+        else if (offset > v.size())
+          throw InputError(where("non-contiguous vector set not allowed",
+                                 "parse problem",current_file,
+                                 k.line,k.col));
+        if (last) { v.erase(v.begin()+offset); return; }
+        p = &v[offset];
+      }
+    }
+    switch (s.op) {
+    case statement::Assign:
+      *p = value_of(s);
+      for (size_t j=0; j<s.body.size(); ++j) apply(*p,s.body[j]);
+      break;
+    case statement::Open:
+      p->be(Table);
+      for (size_t j=0; j<s.body.size(); ++j) apply(*p,s.body[j]);
+      break;
+    case statement::Include:
+      try {
+        include_file(*p,s.file);
+      }
+      catch (exception &e) {
+        throw InputError(where(where(e.what(),"include problem",current_file,
+                                     s.line,s.col),
+                               "parse problem",current_file,s.line,s.col));
+      }
+      break;
+    case statement::Erase:
+      break;
+    }
+  }
+  template void parser::apply(ark &,statement &) const;
+  template void parser::apply(ark &,const statement &) const;
+
+  //private:
+  void parser::replay(ark &a,const script_t &s) const {
+    a.be(Table);
+    for (size_t j=0; j<s.size(); ++j) apply(a,s[j]);
+  }
+}
@@ -0,0 +1,110 @@
+#ifndef ark_script_hpp
+#define ark_script_hpp
+
+#include "base.hpp"
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*! \file ark/script.hpp
+
+  Keyvals input can be parsed in two steps: first into statements,
+  without touching the ark being parsed into, and then applied to it
+  in order.  Applying a statement does exactly what the parser does
+  on meeting it, so the two steps together give the same result as a
+  direct parse, including override, !erase and enclosure semantics
+  and error messages.  The parser uses this to parse large inputs on
+  several threads; it is not meant for use outside the library.
+*/
+
+namespace Ark {
+
+  //! One parsed top-level keyval, e.g. "a.b[+].c = value".
+  struct statement {
+    //! one component of a superkey.
+    struct step {
+      std::string key;   //!< table key, or empty for a vector index.
+      unsigned offset;   //!< vector index, unless append.
+      bool     append;   //!< the index was '+'.
+      unsigned line,col; //!< input position after the ']'.
+    };
+
+    //! what happens at the end of the path.
+    enum op_t {
+      Assign,  //!< path = value
+      Erase,   //!< path !erase
+      Open,    //!< path { body }
+      Include  //!< [path .] !include file
+    };
+
+    std::vector<step>      path;  //!< the superkey, outermost first.
+    op_t                   op;    //!< what to do there.
+    ark                    value; //!< the value, for Assign.
+    //! the enclosed statements, for Open; for Assign, those filling
+    //! in a value that has includes inside.
+    std::vector<statement> body;
+    std::string            file;  //!< the file, for Include.
+    unsigned               line,col; //!< input position after the file.
+
+    statement() : op(Assign), line(0), col(0) {}
+  };
+
+  //! statements in input order.
+  typedef std::vector<statement> script_t;
+
+  //! a parsed file, or a note that parsing it failed.
+  struct compiled_t {
+    script_t script; //!< the file's statements.
+    bool     ok;     //!< false if the file could not be read or parsed.
+    compiled_t() : ok(false) {}
+  };
+
+  //! parsed files, by the path include_file() would open.
+  typedef std::map<std::string,compiled_t> include_map;
+
+  //! file texts in a bundle, by the path include_file() would open.
+  typedef std::map<std::string,std::string_view> bundle_map;
+
+  //! files read by a parse, with their contents, in the order read.
+  typedef std::vector<std::pair<std::string,std::string> > file_texts;
+
+  //! what a file looked like when it was read.
+  struct file_stamp {
+    unsigned long long dev, ino, size; //!< identity and length.
+    long long sec, nsec;               //!< modification time.
+    //! same file, unchanged.
+    bool operator==(const file_stamp &o) const {
+      return dev==o.dev && ino==o.ino && size==o.size
+        && sec==o.sec && nsec==o.nsec;
+    }
+    bool operator!=(const file_stamp &o) const { return !(*this==o); }
+  };
+
+  //! a file read by a parse; an empty path means one that can't be
+  //! checked later (a pipe, say).
+  struct file_dep {
+    std::string        path;  //!< as opened.
+    file_stamp         st;    //!< when it was read.
+    unsigned long long hash;  //!< fingerprint of what was read.
+    file_dep() : st(), hash(0) {}
+  };
+
+  //! files read by a parse, in the order they were read.
+  typedef std::vector<file_dep> dep_list;
+
+  //! one file including another.
+  struct include_edge {
+    std::string from; //!< the including file, or empty for the top.
+    std::string to;   //!< the included file, as opened.
+    file_stamp  st;   //!< the file as it was just before it was read.
+    bool        there;//!< false if it couldn't be stamped.
+  };
+
+  //! includes met by a parse, in the order they were met.
+  typedef std::vector<include_edge> include_graph;
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include "exception.hpp"
+#include "parser.hpp"
+
+#include <cstring>
+
+/* Selective parsing.  A parser with a selection keeps only the tables
+   on the way to the selected keys and everything below them.  Other
+   statements are read just far enough to find where they end, with
+   their bracketed values skipped by bracket matching, and a scan of
+   the top level finds the last statement that could touch the
+   selection, after which the parse stops. */
+
+namespace Ark {
+
+  namespace {
+    // the bytes the top-level scan has to look at below top level
+    const charset inner_stops("{}[]#\"'`",9);
+    const charset comment_end("\n",2);
+    const charset dquote_end("\"\\",3);
+    const charset squote_end("'\\",3);
+    const charset bquote_end("`\\",3);
+    // where a word ends, in a key or a value context
+    const char word_chars[] = " \t\n\v\f\r{}<>[]!.=?#\"'`";
+    const charset word_end(word_chars,sizeof(word_chars));
+  }
+
+  //public:
+  parser &parser::select(const std::vector<std::string> &keys) {
+    std::shared_ptr<selection> root(new selection);
+    static const tokenizer::syntax S("[].","");
+    for (size_t i=0; i<keys.size() && !root->whole; ++i) {
+      selection *n = root.get();
+      try {
+        tokenizer t(keys[i],S);
+        // table keys up to the first index; all below that is kept
+        for (t.next(); t.current().kind()==token::Symbol && !n->whole; ) {
+          n = &n->keys[t.current().text()];
+          if (t.next().syntax()!='.') break;
+          t.next();
+        }
+      }
+      catch (exception &) {
+        n = root.get(); // not a superkey; keep everything
+      }
+      n->whole = true;
+    }
+    if (keys.empty() || root->whole) {
+      selected.reset();
+      select_at = NULL;
+    }
+    else {
+      selected = root;
+      select_at = root.get();
+    }
+    return *this;
+  }
+
+  //private:
+  void parser::skip_descend(tokenizer &t) const {
+    // what is left of a keyval after its key
+    for (;;) {
+      switch (t.current().syntax()) {
+      case '!':
+        if (t.next().kind() != token::Symbol)
+          throw InputError("expecting a special symbol");
+        if (t.current().view()!="erase")
+          throw InputError("unknown special token");
+        return;
+      case '[':
+        if (t.next(key_syn).kind()!=token::Symbol)
+          throw InputError("expecting a number");
+        if (t.next(key_syn).syntax()!=']') throw InputError("expecting ']'");
+        t.next(key_syn);
+        break;
+      case '.':
+        if (t.next(key_syn).kind()!=token::Symbol)
+          throw InputError("expecting a key symbol");
+        t.next(key_syn);
+        break;
+      case '{':
+        t.skip_brackets();
+        return;
+      case '=':
+        t.next(val_syn);
+        skip_value(t);
+        return;
+      default:
+        throw InputError("expecting '.' or '=' or '{'");
+      }
+    }
+  }
+
+  //private:
+  void parser::skip_value(tokenizer &t) const {
+    switch (t.current().kind()) {
+    case token::Symbol:
+    case token::String:
+      return;
+    case token::Syntax:
+      switch (t.current().syntax()) {
+      case '!':
+        if (t.next().kind() != token::Symbol)
+          throw InputError("expecting a special symbol");
+        if (t.current().view()!="file")
+          throw InputError("unknown special token");
+        t.next();
+        if (t.current().kind()!=token::Symbol
+            && t.current().kind()!=token::String)
+          throw InputError("!file expected a string or quoted string");
+        return;
+      case '[':
+      case '{':
+        t.skip_brackets();
+        return;
+      case '?':
+        return;
+      default:
+        throw InputError("expecting '{' or '[' or '?'");
+      }
+    default:
+      throw InputError("expecting '{' or '[' or '?' or string");
+    }
+  }
+
+  /* Find where the last top-level mention of a selected key, or the
+     last top-level !include, begins, and return the offset just past
+     that.  Every word at top level is looked at, keys and values
+     alike, so this can only be late.  Returns 0 if there is no such
+     mention, and n if the input looks malformed, so that the parse
+     goes on to report it. */
+  //private:
+  size_t parser::relevant_end(const char *b,size_t n) const {
+    const char *p=b, *e=b+n;
+    size_t end=0;
+    unsigned depth=0;
+    for (;;) {
+      p = depth ? inner_stops.find_first_of(p,e)
+                : scan::space.find_first_not_of(p,e);
+      if (p==e) return end;
+      char c = *p;
+      switch (c) {
+      case '\0':
+        return end;         // input ends here
+      case '#':
+        p = comment_end.find_first_of(p,e);
+        break;
+      case '"': case '\'': case '`': {
+        const charset &ends = c=='"' ? dquote_end
+                            : c=='\'' ? squote_end : bquote_end;
+        for (++p; ; p+=2) {
+          p = ends.find_first_of(p,e);
+          if (p==e || *p!='\\' || p+1==e) break;
+        }
+        if (p==e || *p!=c) return n;
+        ++p;
+        break;
+      }
+      case '{': case '[':
+        ++depth;
+        ++p;
+        break;
+      case '}': case ']':
+        if (!depth) return n;
+        --depth;
+        ++p;
+        break;
+      case '!': {
+        const char *w = scan::space.find_first_not_of(p+1,e);
+        if (e-w>=7 && !memcmp(w,"include",7)) end = p-b+1;
+        ++p;
+        break;
+      }
+      default:
+        if (word_end.contains(c)) {
+          ++p;
+          break;
+        }
+        const char *q = word_end.find_first_of(p,e);
+        if (select_at->keys.count(std::string_view(p,q-p))) end = p-b+1;
+        p = q;
+      }
+    }
+  }
+}
@@ -0,0 +1,446 @@
+#include "cache.hpp"
+#include "compress.hpp"
+#include "exception.hpp"
+#include "parser.hpp"
+#include "source.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Compiled snapshots for parser::cache_dir().  A snapshot is a small
+   binary file named after the file it was built from:
+
+     <hash>.arks   one file's statements, with its stamp and fingerprint
+     <hash>.arkm   the merged result of parsing a file, with the stamp
+                   and fingerprint of every file that went into it
+
+   Both start with a magic string, a type byte and the full cache key,
+   so hash collisions and foreign files are rejected.  Numbers are
+   LEB128, strings are a length and bytes, and arks and statements are
+   written depth first.  Anything that fails to decode is treated as
+   missing. */
+
+namespace Ark {
+
+  namespace {
+    const char magic[] = "ARKSNAP2";
+
+    // fingerprint of a file's contents.  Each step is a bijection of
+    // the state, so inputs differing in a single word always differ.
+    unsigned long long fingerprint(const char *b,size_t n) {
+      const unsigned long long K = 0x9e3779b97f4a7c15ULL;
+      unsigned long long h = n*K;
+      size_t i=0;
+      for (; i+8<=n; i+=8) {
+        unsigned long long w;
+        memcpy(&w,b+i,8);
+        h = ((h<<5 | h>>59) ^ w) * K;
+      }
+      for (; i<n; ++i) h = ((h<<5 | h>>59) ^ (unsigned char)b[i]) * K;
+      h ^= h>>33; h *= 0xff51afd7ed558ccdULL;
+      h ^= h>>33; h *= 0xc4ceb9fe1a85ec53ULL;
+      return h ^ h>>33;
+    }
+
+    std::string snapshot_name(const std::string &dir,const std::string &key,
+                              const char *ext) {
+      char hex[17];
+      snprintf(hex,sizeof(hex),"%016llx",fingerprint(key.data(),key.size()));
+      return dir + "/" + hex + ext;
+    }
+
+    // is the file at d.path still what d says was read?
+    bool current(const file_dep &d) {
+      if (d.path.empty()) return false;
+      file_stamp st;
+      if (!include_cache::stat(d.path,st)) return false;
+      if (st==d.st) return true;
+      if (st.size!=d.st.size) return false;
+      try {
+        file_source in(d.path);
+        return fingerprint(in.data(),in.size())==d.hash;
+      }
+      catch (exception &) {
+        return false;
+      }
+    }
+
+    // encoding
+    void put(std::string &o,unsigned long long n) {
+      while (n>=0x80) { o += char(n|0x80); n >>= 7; }
+      o += char(n);
+    }
+    void put(std::string &o,const char *s,size_t n) {
+      put(o,n);
+      o.append(s,n);
+    }
+    void put(std::string &o,const std::string &s) { put(o,s.data(),s.size()); }
+    void put(std::string &o,const file_stamp &st) {
+      put(o,st.dev); put(o,st.ino); put(o,st.size);
+      put(o,(unsigned long long)st.sec); put(o,(unsigned long long)st.nsec);
+    }
+    void put(std::string &o,const ark &a) {
+      switch (a.kind()) {
+      case None:
+        o += char(0);
+        break;
+      case Atom: {
+        const char *s = a.atom().c_str();
+        o += char(1);
+        put(o,s,strlen(s));
+        break;
+      }
+      case Vector: {
+        const vector_t &v = a.vector();
+        o += char(2);
+        put(o,v.size());
+        for (size_t i=0; i<v.size(); ++i) put(o,v[i]);
+        break;
+      }
+      case Table: {
+        const table_t &d = a.table();
+        o += char(3);
+        put(o,d.size());
+        for (table_t::const_iterator i=d.begin(); i!=d.end(); ++i) {
+          put(o,i->first.str());
+          put(o,i->second);
+        }
+        break;
+      }
+      }
+    }
+    void put(std::string &o,const script_t &s) {
+      put(o,s.size());
+      for (size_t i=0; i<s.size(); ++i) {
+        const statement &t = s[i];
+        put(o,t.path.size());
+        for (size_t j=0; j<t.path.size(); ++j) {
+          const statement::step &k = t.path[j];
+          put(o,k.key);
+          put(o,k.offset);
+          o += char(k.append);
+          put(o,k.line);
+          put(o,k.col);
+        }
+        o += char(t.op);
+        put(o,t.value);
+        put(o,t.body);
+        put(o,t.file);
+        put(o,t.line);
+        put(o,t.col);
+      }
+    }
+
+    // decoding; any error leaves ok false
+    struct decoder {
+      const char *p,*e;
+      bool ok;
+      decoder(const char *b,size_t n) : p(b), e(b+n), ok(true) {}
+
+      unsigned char byte() {
+        if (p==e) { ok=false; return 0; }
+        return *p++;
+      }
+      unsigned long long num() {
+        unsigned long long n=0;
+        for (unsigned shift=0; ok && shift<64; shift+=7) {
+          unsigned char c = byte();
+          n |= (unsigned long long)(c&0x7f) << shift;
+          if (!(c&0x80)) return n;
+        }
+        ok=false;
+        return 0;
+      }
+      size_t count() {
+        // every element takes at least a byte
+        unsigned long long n = num();
+        if (n > size_t(e-p)) { ok=false; return 0; }
+        return n;
+      }
+      std::string_view view() {
+        size_t n = count();
+        std::string_view s(ok ? p : e,n);
+        p += n;
+        return s;
+      }
+      std::string str() { return std::string(view()); }
+      file_stamp stamp() {
+        file_stamp st;
+        st.dev = num(); st.ino = num(); st.size = num();
+        st.sec = num(); st.nsec = num();
+        return st;
+      }
+      void get(ark &a) {
+        switch (byte()) {
+        case 0:
+          a.clear();
+          break;
+        case 1:
+          a.be_atom(view(),NULL);
+          break;
+        case 2: {
+          vector_t &v = a.be(Vector).vector();
+          for (size_t n=count(); ok && n--; ) {
+            v.emplace_back();
+            get(v.back());
+          }
+          break;
+        }
+        case 3: {
+          table_t &d = a.be(Table).table();
+          for (size_t n=count(); ok && n--; ) {
+            std::string k = str();
+            if (!ok) break;
+            table_t::iterator i;
+            try {
+              i = d.emplace_hint(d.end(),key_t(std::move(k)),ark());
+            }
+            catch (exception &) { // not a key
+              ok=false;
+              break;
+            }
+            get(i->second);
+          }
+          break;
+        }
+        default:
+          ok=false;
+        }
+      }
+      void get(script_t &s) {
+        for (size_t n=count(); ok && n--; ) {
+          s.emplace_back();
+          statement &t = s.back();
+          for (size_t m=count(); ok && m--; ) {
+            statement::step k;
+            k.key    = str();
+            k.offset = num();
+            k.append = byte();
+            k.line   = num();
+            k.col    = num();
+            try {
+              if (!k.key.empty()) key_t check(k.key);
+            }
+            catch (exception &) { // not a key
+              ok=false;
+              return;
+            }
+            t.path.push_back(k);
+          }
+          unsigned char op = byte();
+          if (op>statement::Include) { ok=false; return; }
+          t.op = statement::op_t(op);
+          get(t.value);
+          get(t.body);
+          t.file = str();
+          t.line = num();
+          t.col  = num();
+        }
+      }
+    };
+
+    // read the snapshot at name if it is one of the given type
+    bool open_snapshot(const std::string &name,char type,std::string &buf) {
+      int fd = open(name.c_str(),O_RDONLY);
+      if (fd==-1) return false;
+      char tmp[65536];
+      ssize_t n;
+      while ((n=read(fd,tmp,sizeof(tmp)))>0) buf.append(tmp,n);
+      close(fd);
+      return n==0 && buf.size()>=sizeof(magic)
+        && buf.compare(0,sizeof(magic)-1,magic)==0
+        && buf[sizeof(magic)-1]==type;
+    }
+    // what follows the header, if the snapshot is for key
+    decoder body(const std::string &buf,const std::string &key) {
+      decoder in(buf.data()+sizeof(magic),buf.size()-sizeof(magic));
+      if (in.view()!=key) in.ok=false;
+      return in;
+    }
+
+    // write atomically, so readers see all of it or none
+    // d, and any directories above it that aren't there yet
+    void make_dirs(const std::string &d) {
+      for (size_t at = d.find('/',1); ; at = d.find('/',at+1)) {
+        mkdir(d.substr(0,at).c_str(),0777);
+        if (at==std::string::npos) return;
+      }
+    }
+
+    void write_snapshot(const std::string &name,const std::string &data) {
+      static std::atomic<unsigned> serial(0);
+      char suffix[64];
+      snprintf(suffix,sizeof(suffix),".%ld.%u.tmp",long(getpid()),serial++);
+      std::string tmp = name + suffix;
+      int fd = open(tmp.c_str(),O_WRONLY|O_CREAT|O_EXCL,0666);
+      if (fd==-1 && errno==ENOENT) {
+        make_dirs(name.substr(0,name.rfind('/')));
+        fd = open(tmp.c_str(),O_WRONLY|O_CREAT|O_EXCL,0666);
+      }
+      if (fd==-1) return; // just don't cache
+      const char *p = data.data();
+      size_t n = data.size();
+      while (n) {
+        ssize_t w = write(fd,p,n);
+        if (w<=0) break;
+        p += w;
+        n -= w;
+      }
+      if (close(fd)!=0 || n || rename(tmp.c_str(),name.c_str())!=0)
+        unlink(tmp.c_str());
+    }
+
+    std::string header(char type,const std::string &key) {
+      std::string o(magic);
+      o += type;
+      put(o,key);
+      return o;
+    }
+
+    void save_script(const std::string &name,const std::string &key,
+                     const file_dep &d,const script_t &s) {
+      std::string o = header('S',key);
+      put(o,d.st);
+      put(o,d.hash);
+      put(o,s);
+      write_snapshot(name,o);
+    }
+  }
+
+  //private:
+  bool parser::replay_stored(ark &a) const {
+#ifdef ANARKY_NOW
+    return false; // statements don't carry annotations
+#endif
+    // a merged snapshot skips the includes a watcher has to see
+    if (!cachedir.empty() && include_depth==1 && !deps && !graph
+        && (a.kind()!=Table || a.table().empty()))
+      return replay_merged(a);
+    std::shared_ptr<const script_t> s = load_script();
+    if (!s) return false;
+    replay(a,*s);
+    return true;
+  }
+
+  //private:
+  bool parser::replay_merged(ark &a) const {
+    std::string key;
+    file_stamp st;
+    if (!include_cache::check(current_file,key,st)) return false;
+    const std::string name = snapshot_name(cachedir,key,".arkm");
+
+    std::string buf;
+    if (open_snapshot(name,'M',buf)) {
+      decoder in = body(buf,key);
+      bool ok = in.ok;
+      for (size_t n=in.count(); ok && in.ok && n--; ) {
+        file_dep d;
+        d.path = in.str();
+        d.st   = in.stamp();
+        d.hash = in.num();
+        ok = in.ok && current(d);
+      }
+      ark tree;
+      if (ok) in.get(tree);
+      if (ok && in.ok && in.p==in.e) {
+        a = std::move(tree);
+        return true;
+      }
+    }
+
+    // parse it, noting every file read, and save the result
+    dep_list read;
+    parser rec(*this);
+    rec.deps = &read;
+    std::shared_ptr<const script_t> s = rec.load_script();
+    if (!s) return false;
+    rec.replay(a,*s);
+
+    std::string o = header('M',key);
+    put(o,read.size());
+    for (size_t i=0; i<read.size(); ++i) {
+      const file_dep &d = read[i];
+      file_stamp now;
+      // changed since it was read, or can't be checked
+      if (d.path.empty() || !include_cache::stat(d.path,now) || now!=d.st)
+        return true;
+      put(o,d.path);
+      put(o,d.st);
+      put(o,d.hash);
+    }
+    put(o,a);
+    write_snapshot(name,o);
+    return true;
+  }
+
+  //private:
+  std::shared_ptr<const script_t> parser::load_script() const {
+    std::string key;
+    file_dep d;
+    if (!include_cache::check(current_file,key,d.st)) {
+      if (deps) deps->push_back(file_dep());
+      return NULL;
+    }
+    std::shared_ptr<const script_t> s;
+    if (caching && !deps && (s=include_cache::find(key,d.st))) return s;
+    d.path = current_file;
+
+    std::string name;
+    if (!cachedir.empty()) {
+      name = snapshot_name(cachedir,key,".arks");
+      std::string buf;
+      if (open_snapshot(name,'S',buf)) {
+        decoder in = body(buf,key);
+        file_dep was;
+        was.path = d.path;
+        was.st   = in.stamp();
+        was.hash = in.num();
+        std::shared_ptr<script_t> c(new script_t);
+        if (in.ok && current(was)) {
+          in.get(*c);
+          if (in.ok && in.p==in.e) {
+            d.hash = was.hash;
+            s = c;
+            // touched but not changed; save the new stamp
+            if (was.st!=d.st) save_script(name,key,d,*c);
+          }
+        }
+      }
+    }
+
+    if (!s) {
+      // parsed from whatever is there now; if the file changed since
+      // the stat, the stale stamp just means it is checked again
+      file_source in(current_file);
+      std::shared_ptr<script_t> c(new script_t);
+      try {
+        if (is_bundle(in.data(),in.size())) throw InputError("bundle");
+        if (compression_of(in.data(),in.size())) {
+          inflater z(in.data(),in.size());
+          tokenizer t(z,no_syn);
+          compile(*c,t);
+        }
+        else {
+          tokenizer t(in.data(),in.size(),no_syn);
+          compile(*c,t);
+        }
+      }
+      catch (exception &) {
+        if (deps) deps->push_back(file_dep());
+        return NULL; // a direct parse reports it, or reads the bundle
+      }
+      d.hash = fingerprint(in.data(),in.size());
+      if (!name.empty()) save_script(name,key,d,*c);
+      s = c;
+    }
+    if (caching) include_cache::store(key,d.st,s);
+    if (deps) deps->push_back(d);
+    return s;
+  }
+}
@@ -0,0 +1,81 @@
+#include "source.hpp"
+#include "exception.hpp"
+
+#include <sstream>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Ark {
+
+  namespace {
+    // closes a file descriptor on scope exit
+    struct fd_closer {
+      int fd;
+      ~fd_closer() { close(fd); }
+    };
+  }
+
+  file_source::file_source(const std::string &path)
+    : _data(NULL), _size(0), _mapped(false) {
+    // need this because a directory opens without complaint and
+    // reads as an empty file.
+    struct stat statbuf;
+    if(stat(path.c_str(), &statbuf) == -1) {
+      std::ostringstream o;
+      o << "unable to stat file: " << path;
+      o << " (" << strerror(errno) << ")";
+      throw InputError(o.str());
+    }
+    if (S_ISDIR(statbuf.st_mode)) {
+      std::ostringstream o;
+      o << "not a regular file: " << path;
+      throw InputError(o.str());
+    }
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+      std::ostringstream o;
+      o << "unable to read file: " << path;
+      throw InputError(o.str());
+    }
+    fd_closer closer = { fd };
+
+    // an empty file has nothing to map, and procfs, sysfs and some
+    // FUSE files say they are empty but aren't: read those
+    if (S_ISREG(statbuf.st_mode) && statbuf.st_size > 0) {
+      void *p = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        madvise(p, statbuf.st_size, MADV_SEQUENTIAL);
+        _data = static_cast<const char *>(p);
+        _size = statbuf.st_size;
+        _mapped = true;
+        return;
+      }
+      // fall through and read it if the mapping is refused
+    }
+
+    // pipes, /dev/stdin and friends: read until end of file.
+    char chunk[65536];
+    for (;;) {
+      ssize_t n = read(fd, chunk, sizeof(chunk));
+      if (n > 0) _buf.append(chunk, n);
+      else if (n == 0) break;
+      else if (errno != EINTR) {
+        std::ostringstream o;
+        o << "unable to read file: " << path;
+        o << " (" << strerror(errno) << ")";
+        throw InputError(o.str());
+      }
+    }
+    _data = _buf.data();
+    _size = _buf.size();
+  }
+
+  file_source::~file_source() {
+    if (_mapped) munmap(const_cast<char *>(_data), _size);
+  }
+}
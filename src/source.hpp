@@ -0,0 +1,49 @@
+#ifndef ark_source_hpp
+#define ark_source_hpp
+
+#include <cstddef>
+#include <string>
+
+/*! \file ark/source.hpp
+
+A file_source holds the bytes of an input file in memory so that the
+parser can tokenize them in place.  Regular files are mapped with
+mmap; anything else that can be read (pipes, /dev/stdin, character
+devices, and files that report no size, as procfs and sysfs files
+do) is read into a buffer.
+*/
+
+namespace Ark {
+
+  //! The contents of an input file, mapped or read.
+  class file_source {
+    const char  *_data;  //!< start of the contents.
+    size_t       _size;  //!< length of the contents.
+    bool         _mapped;//!< whether _data is an mmap region.
+    std::string  _buf;   //!< the contents, when not mapped.
+
+    file_source(const file_source &);            // not copyable
+    file_source &operator=(const file_source &); // not assignable
+
+  public:
+    /*! Map or read the file.  Throws InputError if the file cannot be
+      found, is a directory, or cannot be read.
+      @param path file name.
+    */
+    explicit file_source(const std::string &path);
+    //! unmaps the file if it was mapped.
+    ~file_source();
+
+    //! the contents.
+    //! @return pointer to the first byte.
+    const char *data() const { return _data; }
+    //! the length of the contents.
+    //! @return number of bytes.
+    size_t size() const { return _size; }
+    //! whether the contents are mapped rather than copied.
+    //! @return true if mapped.
+    bool mapped() const { return _mapped; }
+  };
+}
+
+#endif
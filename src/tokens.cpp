@@ -1,70 +1,318 @@
 #include "exception.hpp"
 #include "tokens.hpp"
 #include <sstream>
-#include <ctype.h>
+#include <cstring>
+#include <algorithm>
 
 namespace Ark {
   std::string token::text() const {
     switch(k) {
-    case None:    return "<undefined>"; 
-    case End:     return "<end of file>"; 
+    case None:    return "<undefined>";
+    case End:     return "<end of file>";
     case Syntax:
-    case Symbol:  return buf;
-    case String:  return buf;//.substr(1,buf.size()-2);
+    case Symbol:  return std::string(view());
+    case String:  return std::string(view());//.substr(1,buf.size()-2);
     }
     // can't reach here
     return "no way I reached this line here";
   }
 
+  tokenizer::syntax::syntax(const std::string &syn,const std::string &com):
+    comment(com), syntax_chars(syn), quote("\"'`"),
+    reserved(comment+syntax_chars+quote),
+    stops(" \t\n\v\f\r",6)
+  {
+    for (unsigned i=0; i<256; ++i) {
+      char c = i;
+      cls[i] = 0;
+      if (std::string::npos != comment.find(c))      cls[i] |= Comment;
+      if (std::string::npos != syntax_chars.find(c)) cls[i] |= Syntax;
+      if (std::string::npos != quote.find(c))        cls[i] |= Quote;
+    }
+    stops.add(reserved.c_str()).add('\0');
+  }
+
+  namespace {
+    // where comments and quoted strings stop
+    const charset comment_end("\n",2);
+    const charset dquote_end("\"\\",3);
+    const charset squote_end("'\\",3);
+    const charset bquote_end("`\\",3);
+    // where skip_brackets() has to look
+    const charset bracket_stops("{}[]#\"'`",9);
+
+    const charset &quote_end(char q) {
+      switch (q) {
+      case '\'': return squote_end;
+      case '`':  return bquote_end;
+      default:   return dquote_end;
+      }
+    }
+  }
+
+  void tokenizer::refill(void) {
+    C=BUF;
+    in->get(BUF,BUFsize,0);
+    E=C+in->gcount();
+  }
+
   void tokenizer::nextch(void) {
     if (*C=='\n') ++line, col=0; else ++col;
-    if (++C==E) {
-      C=BUF;
-      in.get(C,BUFsize,0);
-      E=C+in.gcount();
+    if (++C==E && in) refill();
+  }
+
+  // is there more input?  Refills an exhausted stream window.
+  bool tokenizer::more(void) {
+    if (C==E && in) refill();
+    return C!=E;
+  }
+
+  // move to p within the current window, counting lines and columns
+  void tokenizer::advance(const char *p) {
+    const char *n;
+    while (p>C && (n = static_cast<const char *>(memchr(C,'\n',p-C)))) {
+      ++line, col=0;
+      C = n+1;
     }
+    col += p-C;
+    C = p;
   }
 
   const token &tokenizer::next(const syntax &S) {
     // mop up whitespace and comments
     // ok so current char is non-whitespace within bounds
-    while( C!=E ) {
-      while( C!=E && isspace(*C) ) nextch();
-      if (S.is_comment(*C))
-        while( C!=E && *C!='\n' ) nextch();
-      else break;
+    for (;;) {
+      do advance(scan::space.find_first_not_of(C,E)); while (C==E && more());
+      if (C==E || !S.is_comment(*C)) break;
+      // comments run up to the newline
+      do advance(comment_end.find_first_of(C,E)); while (C==E && more());
     }
+    // a NUL ends buffered input, just as it ends a stream read
+    if (C!=E && !*C) E=C;
+
     if (C==E) {
       t.k   = token::End;
-      nextch();
+      t.owned = true;
+      ++col;
     }
     else if (S.is_syntax(*C)) {
       t.k   = token::Syntax;
-      t.buf = *C;
+      if (in) t.buf = *C, t.owned = true;
+      else    t.slice = std::string_view(C,1), t.owned = false;
       nextch();
     }
     else if (S.is_quote(*C)) {
       t.k   = token::String;
-      //t.buf = *C;
-      t.buf.clear();
+      const charset &ends = quote_end(*C);
       char q = *C;
-      bool esc=0;
-      for( nextch(); C!=E && (*C!=q || esc) ; nextch() )
-        if ( *C !='\\' || esc) {
-          t.buf += *C; esc=0;
+      nextch();
+      // copy only when reading a stream or once an escape shows up;
+      // until then the token is a slice of the buffer.
+      bool copy = (in!=NULL);
+      const char *s = C;
+      if (copy) t.buf.clear();
+      for (;;) {
+        const char *r = C;
+        advance(ends.find_first_of(C,E));
+        if (copy) t.buf.append(r,C);
+        if (C==E) {
+          if (more()) continue;
+          break;
         }
-        else esc=1;
-      if (*C != q) // check terminal quote
+        if (*C!='\\') break;
+        if (!copy) t.buf.assign(s,C), copy = true;
+        nextch();
+        if (C==E || !*C) break;
+        t.buf += *C;
+        nextch();
+      }
+      // an unterminated string keeps what was read, for the message
+      if (copy) t.owned = true;
+      else      t.slice = std::string_view(s,C-s), t.owned = false;
+      if (C==E || *C != q) // check terminal quote
         throw InputError("invalid string token");
-      //t.buf += *C;
       nextch();
     }
     else {
       t.k   = token::Symbol;
-      t.buf = *C;
-      for(nextch(); C!=E && !isspace(*C) && !S.is_reserved(*C);nextch())
-        t.buf += *C;
+      if (in) t.buf.clear(), t.owned = true;
+      else    t.owned = false;
+      const char *s = C;
+      for (;;) {
+        const char *r = C;
+        C = S.symbol_stops().find_first_of(C,E);
+        col += C-r;
+        if (!in) break;
+        t.buf.append(r,C);
+        if (C!=E || !more()) break;
+      }
+      if (!in) t.slice = std::string_view(s,C-s);
     }
     return t;
   }
+
+  void tokenizer::skip_brackets() {
+    unsigned depth=1;
+    if (in) {
+      // streams go token by token
+      for (;;) {
+        const token &k = next(S);
+        if (k.kind()==token::End) break;
+        switch (k.syntax()) {
+        case '{': case '[': ++depth; break;
+        case '}': case ']': if (!--depth) return; break;
+        }
+      }
+      throw InputError("unterminated bracket");
+    }
+    const char *p=C;
+    while ((p = bracket_stops.find_first_of(p,E)) != E) {
+      char c = *p;
+      if (!c) break; // a NUL ends the input
+      if (S.is_comment(c)) {
+        p = comment_end.find_first_of(p,E);
+        continue;
+      }
+      if (S.is_quote(c)) {
+        const charset &ends = quote_end(c);
+        for (++p; ; p+=2) {
+          p = ends.find_first_of(p,E);
+          if (p==E || *p!='\\' || p+1==E) break;
+        }
+        if (p==E || *p!=c) break;
+        ++p;
+        continue;
+      }
+      ++p;
+      if (c=='{' || c=='[') ++depth;
+      else if ((c=='}' || c==']') && !--depth) {
+        advance(p);
+        return;
+      }
+    }
+    throw InputError("unterminated bracket");
+  }
+
+  token_index::token_index(const tokenizer::syntax &S)
+    : stops(S.symbol_stops()) {
+    for (unsigned i=0; i<256; ++i) {
+      char c = i;
+      if (S.is_syntax(c))  syntax_chars.add(c);
+      if (S.is_quote(c))   quotes.add(c);
+      if (S.is_comment(c)) comment.add(c);
+    }
+  }
+
+  bool token_index::scan(const char *b,size_t &n,
+                         std::vector<entry> &out) const {
+    if (const void *z = memchr(b,0,n)) n = static_cast<const char *>(z)-b;
+    out.clear();
+    if (n > max_size) return false;
+    out.reserve(n/4+16);
+
+    const size_t none = size_t(-1);
+    std::vector<size_t> open; // the '[' and '{' not closed yet
+    size_t counting = none;   // the innermost, if it is a '['
+    auto value = [&](size_t at,uint32_t end) {
+      if (counting!=none) ++out[counting].end;
+      out.push_back(entry{uint32_t(at),end});
+    };
+    auto syntax = [&](size_t at) {
+      char c = b[at];
+      if (c==']' || c=='}') {
+        if (!open.empty()) open.pop_back();
+        counting = !open.empty() && b[out[open.back()].at]=='['
+          ? open.back() : none;
+        out.push_back(entry{uint32_t(at),0});
+        return;
+      }
+      value(at,0);
+      if (c=='[' || c=='{') {
+        open.push_back(out.size()-1);
+        counting = c=='[' ? out.size()-1 : none;
+      }
+    };
+
+    size_t sym = none;   // the symbol not ended yet
+    uint64_t carry = 0;  // whether the byte before pos is in a symbol
+    char tail[64];
+    for (size_t pos=0; pos<n; ) {
+      size_t base = pos & ~size_t(63);
+      const char *p = b+base;
+      if (n-base < 64) {
+        // the last block, padded out with spaces
+        memcpy(tail,p,n-base);
+        memset(tail+(n-base),' ',64-(n-base));
+        p = tail;
+      }
+      uint64_t syn = syntax_chars.members(p), quo = quotes.members(p);
+      uint64_t com = comment.members(p);
+      uint64_t in_sym = ~stops.members(p);
+      uint64_t starts = in_sym & ~(in_sym<<1 | carry);
+      uint64_t ends = ~in_sym & (in_sym<<1 | carry);
+      // what came before pos was taken care of already
+      uint64_t events = (syn|quo|com|starts|ends) & (~uint64_t(0) << (pos-base));
+      pos = base+64;
+      carry = in_sym >> 63;
+      while (events) {
+        unsigned i = __builtin_ctzll(events);
+        uint64_t bit = uint64_t(1) << i;
+        events &= events-1;
+        size_t at = base+i;
+        if ((ends & bit) && sym!=none) {
+          out[sym].end = at;
+          sym = none;
+        }
+        if (starts & bit) {
+          sym = out.size();
+          value(at,0);
+          continue;
+        }
+        if (syn & bit) {
+          syntax(at);
+          continue;
+        }
+        size_t to; // where a string or comment ends
+        if (quo & bit) {
+          // strings are read to their end at once
+          const charset &close = quote_end(b[at]);
+          uint32_t esc = 0;
+          const char *q = b+at+1, *e = b+n;
+          for (;;) {
+            q = close.find_first_of(q,e);
+            if (q==e) return false;
+            if (*q!='\\') break;
+            esc = escaped;
+            if ((q+=2) > e) return false;
+          }
+          if (*q!=b[at]) return false;
+          value(at,uint32_t(q-b)|esc);
+          to = q-b+1;
+        }
+        else if (com & bit) {
+          const char *nl = static_cast<const char *>(memchr(b+at,'\n',n-at));
+          to = nl ? nl-b+1 : n;
+        }
+        else continue;
+        // carry on from there; the byte before it ends any symbol
+        if (to < base+64) events &= ~uint64_t(0) << (to-base);
+        else {
+          pos = to;
+          carry = 0;
+          break;
+        }
+      }
+    }
+    if (sym!=none) out[sym].end = n;
+    return true;
+  }
+
+  void token_index::locate(const char *b,size_t off,unsigned &line,
+                           unsigned &col) {
+    const char *e = b+off;
+    line = 1 + std::count(b,e,'\n');
+    const char *s = e;
+    while (s!=b && s[-1]!='\n') --s;
+    col = e-s;
+  }
 }
@@ -1,8 +1,13 @@
 #ifndef ark_tokens_hpp
 #define ark_tokens_hpp
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <vector>
+
+#include "scan.hpp"
 
 /*! \file ark/tokens.hpp
 
@@ -27,10 +32,12 @@ namespace Ark {
   private:
     kind_t k; //!< The kind of this token.
     std::string buf; //!< A temporary buffer for input.
+    std::string_view slice; //!< Text, when it is a slice of the input.
+    bool owned; //!< Whether the text lives in buf rather than slice.
 
   public:
     //! default initialized the kind to None.
-    token() : k(None), buf("") {}
+    token() : k(None), buf(""), owned(true) {}
     /*!
       returns the kind.
       @return the kind of this token.
@@ -41,7 +48,16 @@ namespace Ark {
       a non-syntax token.
       @return syntax character.
     */
-    char syntax() const {return (k==Syntax) ? (buf[0]) : ('\0');}
+    char syntax() const {return (k==Syntax) ? (view()[0]) : ('\0');}
+    /*! Return the text of this token without copying it.  For tokens
+      read from a contiguous buffer this is usually a slice of that
+      buffer, so it is only valid until the buffer goes away; in any
+      case it is only valid until the next call to tokenizer::next().
+      @return the text of this token.
+    */
+    std::string_view view() const {
+      return owned ? std::string_view(buf) : slice;
+    }
     /*! Return the text of this token as a C++-string.
       @return the text of this token.
     */
@@ -49,7 +65,9 @@ namespace Ark {
   };
 
 
-  /*! A tokenizer produces a stream of tokens from a C++ input stream.
+  /*! A tokenizer produces a stream of tokens from a C++ input stream
+    or from a contiguous buffer.  Tokenizing a buffer avoids copying:
+    symbols and strings without escapes come back as slices of it.
     The interface is a basic iteration scheme supporting a call like
     <code>
 \verbatim
@@ -71,6 +89,11 @@ namespace Ark {
       std::string syntax_chars; //!< syntax characters (non-quote).
       std::string quote; //!< allowed quote characters for string.
       std::string reserved; //!< syntax+quote+comment concatenation.
+
+      //! bits of the class table.
+      enum { Comment=1, Syntax=2, Quote=4, Reserved=Comment|Syntax|Quote };
+      unsigned char cls[256]; //!< class bits of every byte.
+      charset stops; //!< bytes that end a symbol: reserved, space and NUL.
     public:
       /*! Constructor.
         @param syn syntax characters.
@@ -78,46 +101,50 @@ namespace Ark {
 
         Currently quote characters are all of "'`, hard-coded.
       */
-      syntax(const std::string &syn,const std::string &com):
-        comment(com), syntax_chars(syn), quote("\"'`"),
-        reserved(comment+syntax_chars+quote)
-      {}
+      syntax(const std::string &syn,const std::string &com);
       //! test for comment character.
       //! @param c
       //! @return whether a comment.
       bool is_comment(char c) const {
-        return std::string::npos != comment.find(c);
+        return cls[(unsigned char)c] & Comment;
       }
       //! test for syntax character.
       //! @param c
       //! @return whether a syntax.
       bool is_syntax(char c) const {
-        return std::string::npos != syntax_chars.find(c);
+        return cls[(unsigned char)c] & Syntax;
       }
       //! test for quote character.
       //! @param c
       //! @return whether a quote.
       bool is_quote(char c) const {
-        return std::string::npos != quote.find(c);
+        return cls[(unsigned char)c] & Quote;
       }
       //! test for reserved character.
       //! @param c
       //! @return whether a reserved.
       bool is_reserved(char c) const {
-        return std::string::npos != reserved.find(c);
+        return cls[(unsigned char)c] & Reserved;
       }
+      //! the bytes that end a symbol.
+      //! @return reserved characters, whitespace and NUL.
+      const charset &symbol_stops() const { return stops; }
     };
 
   private:
     syntax S;
     // tokenizing state
-    std::istream &in;
+    std::istream *in; // NULL when tokenizing a contiguous buffer
     unsigned      line,col;
     token         t;
 
     void nextch(void); // yes this BS does help.  C++ iostreams blow.
+    void refill(void);
+    bool more(void);
+    void advance(const char *p);
     static const size_t BUFsize=256;
-    char *C,*E,BUF[BUFsize];
+    const char *C,*E;
+    char BUF[BUFsize];
 
   public:
     /*! Construct a tokenizer from an input stream and a syntax.
@@ -130,11 +157,34 @@ namespace Ark {
       The initial value of current() is None.
     */
     tokenizer(std::istream &i,syntax syn)
-      : S(syn),in(i),line(1),col(0),t() {
-      C=BUF;
-      in.get(C,BUFsize,0);
-      E=C+in.gcount();
+      : S(syn),in(&i),line(1),col(0),t() {
+      C=E=BUF;
+      refill();
     }
+    /*! Construct a tokenizer over a contiguous buffer.  The buffer is
+      not copied and must outlive the tokenizer and any token views
+      taken from it.  As with streams, input ends at the first NUL.
+      @param b start of the buffer.
+      @param n length of the buffer.
+      @param syn syntax.
+      @param l line number of the first byte, when b is in the middle
+      of some larger input.
+      @param c column number of the first byte.
+    */
+    tokenizer(const char *b,size_t n,syntax syn,unsigned l=1,unsigned c=0)
+      : S(syn),in(NULL),line(l),col(c),t(),C(b),E(b+n) {}
+    /*! Construct a tokenizer over a string's contents (not copied).
+      @param s input text.
+      @param syn syntax.
+    */
+    tokenizer(std::string_view s,syntax syn)
+      : tokenizer(s.data(),s.size(),syn) {}
+    //! Construct a tokenizer over a C string (not copied).
+    tokenizer(const char *s,syntax syn)
+      : tokenizer(std::string_view(s),syn) {}
+    //! Not over a temporary string: its contents would be gone before
+    //! the first token is read.
+    tokenizer(std::string &&,syntax) = delete;
     //! The current line number in the stream.
     //! @return the line number.
     unsigned lineno() const {return line;}
@@ -142,6 +192,30 @@ namespace Ark {
     //! @return the column number.
     unsigned colno()  const {return col; }
 
+    /*! Skip ahead to p, counting lines and columns as if the bytes
+      in between had been tokenized.  Only for tokenizers over a
+      buffer, with p no further than its end.
+      @param p where to carry on from.
+    */
+    void skip_to(const char *p) { advance(p); }
+
+    /*! Where tokenizing carries on from: the byte after the current
+      token, or some whitespace before the next.  Only for tokenizers
+      over a buffer.
+      @return pointer into the buffer.
+    */
+    const char *position() const { return C; }
+    //! Whether the tokenizer is over a buffer rather than a stream.
+    //! @return true for a buffer.
+    bool buffered() const { return !in; }
+
+    /*! With the current token an opening '{' or '[', move past the
+      bracket that closes it without making tokens of what is in
+      between.  Quotes and comments are skipped as next() would skip
+      them.  Throws InputError if the input ends first.
+    */
+    void skip_brackets();
+
     //! The current token in the stream.
     //! @return a token reference.
     const token &current() const {return t;}
@@ -155,6 +229,64 @@ namespace Ark {
     //! @return token reference.
     inline const token &next() { return next(S); }
   };
+
+  /*! A token_index finds every token of a buffer in one pass, 64
+    bytes at a time with the charset kernels, and lists where each
+    starts and ends.  A parser can then walk the list instead of
+    calling tokenizer::next(), with no line and column bookkeeping
+    until it has an error to report.  Only a syntax whose tokens don't
+    depend on context can be indexed, as the strict grammar's can.
+  */
+  class token_index {
+  public:
+    //! where a token is.
+    struct entry {
+      uint32_t at;  //!< offset of its first byte (the quote, for a string).
+      /*! for a symbol, the offset just past it; for a string, the
+        offset of its closing quote, or'ed with escaped if it holds a
+        '\'; for a '[', the number of tokens directly inside it other
+        than closing brackets, which is its length if it is well
+        formed; otherwise 0. */
+      uint32_t end;
+    };
+    //! the bit of entry::end set for strings with escapes.
+    static const uint32_t escaped = UINT32_C(0x80000000);
+    //! the longest input that can be indexed.
+    static const size_t max_size = escaped-1;
+
+    /*! Constructor.
+      @param syn the syntax to tokenize by.
+    */
+    explicit token_index(const tokenizer::syntax &syn);
+
+    /*! List the tokens of a buffer, as tokenizer::next() with the
+      syntax would find them.
+      @param b start of the buffer.
+      @param n its length, cut back to the first NUL, where input
+      ends as it does for a tokenizer.
+      @param out the tokens, in order.
+      @return false if the input is longer than max_size or the
+      tokenizer would throw (a string that doesn't end); out is then
+      incomplete.
+    */
+    bool scan(const char *b,size_t &n,std::vector<entry> &out) const;
+
+    /*! The line and column a tokenizer reports with its position at
+      some offset into a buffer.
+      @param b start of the buffer.
+      @param off the offset.
+      @param line set to the line number.
+      @param col set to the column number.
+    */
+    static void locate(const char *b,size_t off,unsigned &line,
+                       unsigned &col);
+
+  private:
+    charset stops;        //!< bytes that end a symbol.
+    charset syntax_chars; //!< syntax characters.
+    charset quotes;       //!< quote characters.
+    charset comment;      //!< comment characters.
+  };
 }
 
 #endif
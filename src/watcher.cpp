@@ -0,0 +1,202 @@
+#include "cache.hpp"
+#include "exception.hpp"
+#include "watcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <set>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+/* The watcher.  Every parse goes through the include cache, and notes
+   the includes it meets; a reload parses the top file again, and the
+   cache replays each include whose file's stamp is as it was, so only
+   changed files are read.  Each include is stamped as the parse meets
+   it, before it is read, so a file rewritten while being parsed is
+   seen as changed.  inotify only says that something in a
+   watched directory happened; the stamps say whether it was one of
+   ours. */
+
+namespace Ark {
+
+  namespace {
+    const int none = -1;
+
+    std::string directory(const std::string &path) {
+      size_t slash = path.rfind('/');
+      if (slash==std::string::npos) return ".";
+      if (!slash) return "/";
+      return path.substr(0,slash);
+    }
+
+    // keys in a and b whose values differ, under prefix
+    void differ(const ark &a,const ark &b,const std::string &prefix,
+                std::vector<std::string> &keys) {
+      if (a.kind()!=b.kind()) {
+        keys.push_back(prefix);
+        return;
+      }
+      switch (a.kind()) {
+      case Atom:
+        if (strcmp(a.atom().c_str(),b.atom().c_str())) keys.push_back(prefix);
+        break;
+      case Vector: {
+        const vector_t &u = a.vector(), &v = b.vector();
+        if (u.size()!=v.size()) {
+          keys.push_back(prefix);
+          break;
+        }
+        for (size_t i=0; i<u.size(); ++i)
+          differ(u[i],v[i],prefix + "[" + std::to_string(i) + "]",keys);
+        break;
+      }
+      case Table: {
+        const table_t &s = a.table(), &t = b.table();
+        table_t::const_iterator i = s.begin(), j = t.begin();
+        while (i!=s.end() || j!=t.end()) {
+          // both tables are ordered by key: walk them together
+          const key_t &k = j==t.end() || (i!=s.end() && i->first<j->first)
+            ? i->first : j->first;
+          std::string key = prefix.empty() ? k.str() : prefix + "." + k.str();
+          if (i==s.end() || k<i->first) keys.push_back(key), ++j;
+          else if (j==t.end() || k<j->first) keys.push_back(key), ++i;
+          else differ((i++)->second,(j++)->second,key,keys);
+        }
+        break;
+      }
+      default:
+        break;
+      }
+    }
+  }
+
+  watcher::watcher(const std::string &path,const parser &p)
+    : P(p), file(path), notes(none) {
+    P.cache_includes(true).lazy(false);
+#ifdef __linux__
+    notes = inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+#endif
+    try {
+      load(current);
+    }
+    catch (...) {
+#ifdef __linux__
+      if (notes!=none) close(notes);
+#endif
+      throw;
+    }
+  }
+
+  watcher::~watcher() {
+#ifdef __linux__
+    if (notes!=none) close(notes);
+#endif
+  }
+
+  //private:
+  void watcher::load(ark &a) {
+    graph.clear();
+    P.graph = &graph;
+    try {
+      P.parse_file(a,file);
+    }
+    catch (...) {
+      P.graph = NULL;
+      watch();
+      throw;
+    }
+    P.graph = NULL;
+    watch();
+  }
+
+  //private:
+  void watcher::watch() {
+    stamps.clear();
+    std::set<std::string> wanted;
+    for (size_t i=0; i<graph.size(); ++i) {
+      // a file met twice keeps its first stamp: anything since is a change
+      const include_edge &e = graph[i];
+      if (e.there) stamps.insert(std::make_pair(e.to,e.st));
+      wanted.insert(directory(e.to));
+    }
+#ifdef __linux__
+    if (notes==none) return;
+    for (std::map<int,std::string>::iterator i=dirs.begin(); i!=dirs.end(); )
+      if (wanted.erase(i->second)) ++i;
+      else {
+        inotify_rm_watch(notes,i->first);
+        i = dirs.erase(i);
+      }
+    for (std::set<std::string>::const_iterator i=wanted.begin();
+         i!=wanted.end(); ++i) {
+      // a directory that isn't there can't be watched; its files are
+      // still checked whenever another one wakes us
+      int wd = inotify_add_watch(notes,i->c_str(),
+                                 IN_CLOSE_WRITE|IN_MOVED_TO|IN_MOVED_FROM
+                                 |IN_CREATE|IN_DELETE|IN_ATTRIB|IN_ONLYDIR);
+      if (wd!=none) dirs[wd] = *i;
+    }
+#endif
+  }
+
+  //private:
+  bool watcher::stale() const {
+    for (size_t i=0; i<graph.size(); ++i) {
+      const std::string &f = graph[i].to;
+      std::map<std::string,file_stamp>::const_iterator j = stamps.find(f);
+      file_stamp st;
+      bool there = include_cache::stat(f,st);
+      if (there!=(j!=stamps.end()) || (there && st!=j->second)) return true;
+    }
+    return false;
+  }
+
+  bool watcher::reload() {
+    ark a;
+    try {
+      load(a);
+    }
+    catch (exception &e) {
+      failure = e.what();
+      return false;
+    }
+    failure.clear();
+    std::vector<std::string> changed;
+    differ(current,a,"",changed);
+    if (changed.empty()) return false;
+    current.swap(a);
+    for (size_t i=0; i<subscribers.size(); ++i) subscribers[i](current,changed);
+    return true;
+  }
+
+  bool watcher::poll(int timeout) {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point until = clock::now() + std::chrono::milliseconds(timeout);
+    for (;;) {
+      if (stale()) return reload();
+      int left = timeout<0 ? -1
+        : std::max<long long>(0,std::chrono::duration_cast<std::chrono::milliseconds>
+                              (until-clock::now()).count());
+      if (!left) return false;
+#ifdef __linux__
+      if (notes!=none) {
+        struct pollfd f = { notes, POLLIN, 0 };
+        if (::poll(&f,1,left)<=0) continue;
+        // what happened doesn't matter, only whether a stamp changed
+        char buf[4096];
+        while (read(notes,buf,sizeof(buf))>0) {}
+        continue;
+      }
+#endif
+      // no notifications: look again now and then
+      std::this_thread::sleep_for(std::chrono::milliseconds
+                                  (left<0 || left>100 ? 100 : left));
+    }
+  }
+}
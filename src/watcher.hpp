@@ -0,0 +1,127 @@
+#ifndef ark_watcher_hpp
+#define ark_watcher_hpp
+
+#include "parser.hpp"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/*! \file ark/watcher.hpp
+
+A watcher keeps an ark parsed from a file up to date as the file, and
+the files it includes, change on disk, so that a long-running program
+can pick up new settings without restarting.  Each parse notes which
+files were included, and from where; the watcher watches those files
+(with inotify on Linux, by checking their stamps elsewhere) and, when
+one changes, parses the top file again through the include cache (see
+cache.hpp): every include, of keyvals or inside a value, is replayed
+in order, and only the files that changed are read and parsed again.
+Subscribers are then told which superkeys changed.
+
+Example:
+<code>
+\verbatim
+    Ark::watcher w("service.ark");
+    w.subscribe([](const Ark::ark &a,const std::vector<std::string> &keys) {
+      for (const std::string &k : keys) retune(k,a.xget(k));
+    });
+    for (;;) w.poll(1000);
+\endverbatim
+</code>
+
+Editors that save by writing a new file and renaming it over the old
+one are followed, as are include files that appear after having been
+missing.  A change that doesn't parse leaves the ark as it was, and
+is reported by error(); the files it named are watched all the same,
+so fixing them brings the next reload.  Files are watched by the path
+they were included by: a change to the target of a symbolic link is
+only seen when the link's own directory is written.
+*/
+
+namespace Ark {
+
+  //! Reparses a file and its includes when they change on disk.
+  class watcher {
+  public:
+    /*! called after a reload that changed the ark.
+      @param a the ark as it is now.
+      @param changed superkeys whose values changed, spelled as
+      ark::xget() takes them, outermost first: a key added, removed
+      or given a value of another kind is named itself, as is a
+      vector that changed length; otherwise the keys below it are.
+    */
+    typedef std::function<void(const ark &a,
+                               const std::vector<std::string> &changed)>
+      callback;
+
+  private:
+    parser        P;      //!< parses, through the include cache.
+    std::string   file;   //!< the top file.
+    ark           current;//!< its latest good parse.
+    include_graph graph;  //!< includes met by the latest parse.
+    std::string   failure;//!< why the latest reload failed, if it did.
+    std::vector<callback> subscribers;
+
+    //! stamps of the files included, as they were before being read;
+    //! files that couldn't be stamped have none.
+    std::map<std::string,file_stamp> stamps;
+    int notes;            //!< inotify descriptor, or -1.
+    std::map<int,std::string> dirs; //!< watched directories, by watch.
+
+    void load(ark &a);
+    void watch();
+    bool stale() const;
+
+  public:
+    /*! Constructor.  Parses the file, throwing any error.
+      @param path file to parse, as parser::parse_file() takes it.
+      @param p parser settings; the include cache is always used, and
+      lazy() is turned off so that changes can be found.
+    */
+    explicit watcher(const std::string &path,const parser &p=parser());
+    ~watcher();
+    watcher(const watcher &) = delete;
+    watcher &operator=(const watcher &) = delete;
+
+    //! the ark as of the latest good parse.
+    //! @return reference valid until the next reload.
+    const ark &get() const { return current; }
+
+    /*! call f after every reload that changes the ark.
+      @param f the callback.
+    */
+    void subscribe(const callback &f) { subscribers.push_back(f); }
+
+    /*! wait for a change to one of the files, and reload if there is
+      one.
+      @param timeout milliseconds to wait at most; 0 only looks, and
+      a negative value waits for as long as it takes.
+      @return true if the ark changed.
+    */
+    bool poll(int timeout=0);
+
+    /*! parse the file again now, whether anything changed or not.
+      Subscribers are told if the ark changed.
+      @return true if it changed.
+    */
+    bool reload();
+
+    //! the includes met by the latest parse, good or not, in order;
+    //! the top file is included from "".
+    //! @return the edges.
+    const include_graph &includes() const { return graph; }
+
+    //! why the latest reload failed.
+    //! @return the error message, or empty if it succeeded.
+    const std::string &error() const { return failure; }
+
+    //! a descriptor that becomes readable when a watched directory
+    //! changes, for a program's own poll() or select() loop.
+    //! @return the descriptor, or -1 where there is no inotify.
+    int fd() const { return notes; }
+  };
+}
+
+#endif
@@ -0,0 +1,93 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+using namespace Ark;
+
+/* Compares parsing a large configuration onto the heap with parsing
+   it into an arena: heap allocations made, parse time, and the time
+   to tear the tree down again. */
+
+#ifdef __GLIBC__
+// count every heap allocation by interposing on glibc's malloc.
+extern "C" {
+  void *__libc_malloc(size_t);
+  void *__libc_calloc(size_t,size_t);
+  void *__libc_realloc(void *,size_t);
+}
+namespace { size_t nmalloc = 0; }
+extern "C" {
+  void *malloc(size_t n)             { ++nmalloc; return __libc_malloc(n); }
+  void *calloc(size_t n,size_t s)    { ++nmalloc; return __libc_calloc(n,s); }
+  void *realloc(void *p,size_t n)    { ++nmalloc; return __libc_realloc(p,n); }
+}
+#define ALLOCATIONS() nmalloc
+#else
+#define ALLOCATIONS() size_t(0)
+#endif
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  std::string generate(unsigned ntables, unsigned nrows) {
+    std::ostringstream o;
+    for (unsigned i=0; i<ntables; ++i) {
+      o << "table_" << i << " {\n"
+        << "  name = \"force field table " << i << "\"\n"
+        << "  rows = [\n";
+      for (unsigned j=0; j<nrows; ++j) {
+        o << "    { type = t" << j%17 << " sigma = " << 0.1*j
+          << " epsilon = " << 1.0/(j+1) << " memo = \"row " << j
+          << " of table " << i << "\" tags = [a b c] }\n";
+      }
+      o << "  ]\n}\n";
+    }
+    return o.str();
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned ntables = argc>1 ? atoi(argv[1]) : 200;
+  unsigned nrows   = argc>2 ? atoi(argv[2]) : 250;
+
+  std::string text = generate(ntables,nrows);
+  printf("input: %u tables x %u rows, %zu bytes\n",
+         ntables, nrows, text.size());
+
+  {
+    size_t n0 = ALLOCATIONS();
+    clock_type::time_point t0 = clock_type::now();
+    ark *a = new ark;
+    parser().parse_keyvals(*a,text);
+    double dt = since(t0);
+    size_t n = ALLOCATIONS()-n0;
+    t0 = clock_type::now();
+    delete a;
+    printf("heap:  parse %8.3f s  destroy %8.3f s  %9zu allocations\n",
+           dt, since(t0), n);
+  }
+
+  {
+    size_t n0 = ALLOCATIONS();
+    clock_type::time_point t0 = clock_type::now();
+    arena *A = new arena;
+    parser().parse_keyvals_into(*A,text);
+    double dt = since(t0);
+    size_t n = ALLOCATIONS()-n0;
+    printf("arena: %zu blocks, %zu of %zu bytes used\n",
+           A->blocks(), A->bytes(), A->reserved());
+    t0 = clock_type::now();
+    delete A;
+    printf("arena: parse %8.3f s  destroy %8.3f s  %9zu allocations\n",
+           dt, since(t0), n);
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Ark;
+
+/* Times reading 300 fields of a config into a struct, once through a
+   full parse and a reader per field, and once through a binding, for
+   a config of just those fields and for one with a large table no
+   field is in. */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  struct job {
+    double      x;
+    int         n;
+    std::string s;
+  };
+
+  std::string key(unsigned i) {
+    return "section_" + std::to_string(i/10) + ".field_" + std::to_string(i%10);
+  }
+
+  std::string generate(unsigned nfields, unsigned nrows) {
+    std::ostringstream o;
+    for (unsigned i=0; i<nfields; ++i) {
+      o << key(i) << " = ";
+      switch (i%3) {
+      case 0: o << 0.5*i; break;
+      case 1: o << i; break;
+      default: o << "\"value " << i << "\""; break;
+      }
+      o << "\n";
+    }
+    o << "table = [\n";
+    for (unsigned j=0; j<nrows; ++j)
+      o << "  { type = t" << j%17 << " sigma = " << 0.1*j
+        << " epsilon = " << 1.0/(j+1) << " tags = [a b c] }\n";
+    o << "]\n";
+    return o.str();
+  }
+
+  void run(const std::string &text, unsigned nfields, unsigned jobs) {
+    binding<job> B;
+    for (unsigned i=0; i<nfields; ++i)
+      switch (i%3) {
+      case 0: B.bind(key(i),&job::x); break;
+      case 1: B.bind(key(i),&job::n); break;
+      default: B.bind(key(i),&job::s); break;
+      }
+
+    job a, b;
+    clock_type::time_point t0 = clock_type::now();
+    for (unsigned k=0; k<jobs; ++k) {
+      ark tree;
+      parser().parse_keyvals(tree,text);
+      reader r(tree);
+      for (unsigned i=0; i<nfields; ++i)
+        switch (i%3) {
+        case 0: r.get(key(i)).set(a.x); break;
+        case 1: r.get(key(i)).set(a.n); break;
+        default: r.get(key(i)).set(a.s); break;
+        }
+    }
+    double full = since(t0)/jobs;
+
+    t0 = clock_type::now();
+    for (unsigned k=0; k<jobs; ++k) parser().parse_keyvals(b,B,text);
+    double bound = since(t0)/jobs;
+
+    bool same = a.x==b.x && a.n==b.n && a.s==b.s;
+    printf("  parse and reader %8.1f us  binding %8.1f us  (%.1fx)%s\n",
+           1e6*full, 1e6*bound, full/bound, same ? "" : "  (differs)");
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned nfields = argc>1 ? atoi(argv[1]) : 300;
+  unsigned nrows   = argc>2 ? atoi(argv[2]) : 2000;
+  unsigned jobs    = argc>3 ? atoi(argv[3]) : 1000;
+
+  std::string text = generate(nfields,0);
+  printf("input: %u fields, %zu bytes\n", nfields, text.size());
+  run(text,nfields,jobs);
+  text = generate(nfields,nrows);
+  printf("input: %u fields and %u table rows, %zu bytes\n", nfields, nrows,
+         text.size());
+  run(text,nfields,jobs/10 ? jobs/10 : 1);
+  return 0;
+}
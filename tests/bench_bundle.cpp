@@ -0,0 +1,90 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+using namespace Ark;
+
+/* Times parsing a stack of included files loose, one open per
+   include, against parsing the same stack from a bundle.  The gap
+   grows with the filesystem's metadata latency; on a local disk it
+   is mostly the cost of the extra opens and stats. */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned nfiles = argc>1 ? atoi(argv[1]) : 50;
+  unsigned nrows  = argc>2 ? atoi(argv[2]) : 20;
+  unsigned reps   = argc>3 ? atoi(argv[3]) : 200;
+
+  char tmpl[] = "/tmp/bench_bundleXXXXXX";
+  if (!mkdtemp(tmpl)) { perror("mkdtemp"); return 1; }
+  const std::string dir = tmpl;
+
+  // top.ark includes part_0 .. part_N-1, each of which also pulls in
+  // a shared file relative to itself
+  std::ofstream(dir + "/common.ark") << "units { length = A energy = kcal }\n";
+  std::ostringstream top;
+  for (unsigned i=0; i<nfiles; ++i) {
+    std::ostringstream name, o;
+    name << "part_" << i << ".ark";
+    for (unsigned j=0; j<nrows; ++j)
+      o << "stage_" << i << ".p" << j << " = { value = " << i*j
+        << " file = !file data_" << j << ".dat }\n";
+    o << "stage_" << i << " { !include common.ark }\n";
+    std::ofstream(dir + "/" + name.str()) << o.str();
+    top << "!include " << name.str() << "\n";
+  }
+  std::ofstream(dir + "/top.ark") << top.str();
+
+  const std::string loose = dir + "/top.ark";
+  const std::string bundle = dir + "/top.arkb";
+  {
+    std::ofstream out(bundle.c_str());
+    parser().write_bundle(out,loose);
+  }
+  printf("input: %u includes x %u rows\n", 2*nfiles, nrows);
+
+  std::string a_text, b_text;
+  clock_type::time_point t0 = clock_type::now();
+  for (unsigned r=0; r<reps; ++r) {
+    ark a;
+    parser().parse_file(a,loose);
+    if (!r) { std::ostringstream o; o << a; a_text = o.str(); }
+  }
+  double t_loose = since(t0)/reps;
+
+  t0 = clock_type::now();
+  for (unsigned r=0; r<reps; ++r) {
+    ark b;
+    parser().parse_file(b,bundle);
+    if (!r) { std::ostringstream o; o << b; b_text = o.str(); }
+  }
+  double t_bundle = since(t0)/reps;
+
+  printf("loose:                  %8.3f ms\n", 1e3*t_loose);
+  printf("bundled:                %8.3f ms\n", 1e3*t_bundle);
+  printf("results %s\n", a_text==b_text ? "match" : "DIFFER");
+
+  for (unsigned i=0; i<nfiles; ++i) {
+    std::ostringstream name;
+    name << dir << "/part_" << i << ".ark";
+    unlink(name.str().c_str());
+  }
+  unlink((dir + "/common.ark").c_str());
+  unlink(loose.c_str());
+  unlink(bundle.c_str());
+  rmdir(dir.c_str());
+  return a_text==b_text ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Ark;
+
+/* Times the strict parse against parse_indexed(), and the indexing
+   stage on its own with each scanning kernel, on hand-written style
+   input: commented force-field tables with long vectors (100 MB by
+   default). */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  std::string generate(size_t bytes) {
+    std::ostringstream o;
+    o << "{\n";
+    for (unsigned i=0; (size_t)o.tellp() < bytes; ++i) {
+      o << "  # table " << i << "\n"
+        << "  table_" << i << " = {\n"
+        << "    name = \"force field table " << i << "\"\n"
+        << "    rows = [\n";
+      for (unsigned j=0; j<1000; ++j) {
+        o << "      { type = t" << j%17 << " sigma = " << 0.1*j
+          << " epsilon = " << 1.0/(j+1) << " memo = 'row " << j
+          << " of table " << i << " \\'q\\'' tags = [a b c] }\n";
+      }
+      o << "    ]\n  }\n";
+    }
+    o << "}\n";
+    return o.str();
+  }
+
+  void report(const char *what, double t, size_t n, bool differs) {
+    printf("%-22s %8.3f s  %7.1f MB/s%s\n", what, t, n/t/1e6,
+           differs ? "  (differs)" : "");
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t mb = argc>1 ? atoi(argv[1]) : 100;
+  std::string text = generate(mb<<20);
+  printf("input: %zu bytes\n", text.size());
+
+  clock_type::time_point t0 = clock_type::now();
+  ark a = parse(text);
+  report("parse", since(t0), text.size(), false);
+  std::ostringstream expect;
+  expect << a;
+  a.clear();
+
+  t0 = clock_type::now();
+  ark b = parse_indexed(text);
+  double t = since(t0);
+  std::ostringstream got;
+  got << b;
+  report("parse_indexed", t, text.size(), got.str()!=expect.str());
+  b.clear();
+
+  {
+    t0 = clock_type::now();
+    arena A;
+    const ark &c = parse_indexed_into(A,text.data(),text.size());
+    t = since(t0);
+    std::ostringstream o;
+    o << c;
+    report("parse_indexed_into", t, text.size(), o.str()!=expect.str());
+  }
+
+  // the first stage alone
+  const tokenizer::syntax strict("{}<>[]=?","#");
+  token_index index(strict);
+  std::vector<token_index::entry> tokens;
+  const char *names[] = { "index (scalar)", "index (SSE2)", "index (AVX2)" };
+  for (int l=scan::Scalar; l<=scan::AVX2; ++l) {
+    if (scan::use(scan::level_t(l)) != l) continue;
+    size_t n = text.size();
+    t0 = clock_type::now();
+    index.scan(text.data(),n,tokens);
+    report(names[l], since(t0), text.size(), false);
+  }
+  scan::use(scan::best());
+  printf("tokens: %zu\n", tokens.size());
+  return 0;
+}
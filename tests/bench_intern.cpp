@@ -0,0 +1,67 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#define HEAP() mallinfo2().uordblks
+#else
+#define HEAP() size_t(0)
+#endif
+
+using namespace Ark;
+
+/* Parses a generated topology, whose per-atom parameter tables and
+   small values repeat, with and without an interner, and reports the
+   parse time and the heap bytes the tree holds. */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  std::string generate(unsigned natoms, unsigned ntypes) {
+    std::ostringstream o;
+    o << "atoms = [\n";
+    for (unsigned i=0; i<natoms; ++i) {
+      unsigned t = i%ntypes;
+      o << "  { id = " << i << " type = t" << t
+        << " params = { sigma = " << 0.1*(t+1) << " epsilon = " << 1.0/(t+1)
+        << " mass = 12.011 } charge = 0 fixed = true scale = [1.0 1.0 0.5] }\n";
+    }
+    o << "]\n";
+    return o.str();
+  }
+
+  void run(const std::string &text, interner *I) {
+    size_t h0 = HEAP();
+    clock_type::time_point t0 = clock_type::now();
+    ark a;
+    parser().intern(I).parse_keyvals(a,text);
+    double t = since(t0);
+    size_t held = HEAP()-h0;
+    printf("  %-9s %8.1f ms %12zu bytes", I ? "interned" : "plain", 1e3*t,
+           held);
+    if (I) printf("  (%zu saved, %zu values kept)", I->saved(), I->size());
+    printf("\n");
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned natoms = argc>1 ? atoi(argv[1]) : 100000;
+  unsigned ntypes = argc>2 ? atoi(argv[2]) : 17;
+
+  std::string text = generate(natoms,ntypes);
+  printf("input: %u atoms of %u types, %zu bytes\n", natoms, ntypes,
+         text.size());
+  run(text,NULL);
+  interner I;
+  run(text,&I);
+  return 0;
+}
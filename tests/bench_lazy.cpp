@@ -0,0 +1,98 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace Ark;
+
+/* Times getting the first few keys out of a large file parsed eagerly
+   and lazily, with the peak resident set at that point, and then the
+   time to touch everything.  Each parse runs in a child process so
+   the peaks don't mix. */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  double peak_mb() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF,&ru);
+    return ru.ru_maxrss/1024.0;
+  }
+
+  void generate(const std::string &path, unsigned ntables, unsigned nrows) {
+    std::ofstream o(path.c_str());
+    for (unsigned i=0; i<ntables; ++i) {
+      o << "table_" << i << " = {\n"
+        << "  name = \"force field table " << i << "\"\n"
+        << "  rows = [\n";
+      for (unsigned j=0; j<nrows; ++j) {
+        o << "    { type = t" << j%17 << " sigma = " << 0.1*j
+          << " epsilon = " << 1.0/(j+1) << " memo = \"row " << j
+          << " of table " << i << "\" tags = [a b c] }\n";
+      }
+      o << "  ]\n}\n";
+    }
+  }
+
+  void run(const char *what, const std::string &path, bool lazy,
+           unsigned ntables) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); exit(1); }
+    if (pid == 0) {
+      clock_type::time_point t0 = clock_type::now();
+      ark a;
+      parser().lazy(lazy).parse_file(a,path);
+      const ark *k = a.xget("table_0.rows[3].sigma");
+      double first = since(t0);
+      for (unsigned i=0; i<10; ++i) {
+        std::ostringstream q;
+        q << "table_" << i*(ntables/10) << ".rows[1].memo";
+        a.xget(q.str());
+      }
+      double ten = since(t0);
+      double rss = peak_mb();
+      std::ostringstream o;
+      o << a;
+      double all = since(t0);
+      printf("%-6s first key %8.3f ms  ten keys %8.3f ms  peak RSS %7.1f MB"
+             "  everything %7.3f s (%7.1f MB)%s\n",
+             what, 1e3*first, 1e3*ten, rss, all, peak_mb(),
+             k ? "" : " (key missing)");
+      fflush(stdout);
+      _exit(k ? 0 : 1);
+    }
+    int status;
+    if (waitpid(pid,&status,0) < 0) { perror("waitpid"); exit(1); }
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned ntables = argc>1 ? atoi(argv[1]) : 200;
+  unsigned nrows   = argc>2 ? atoi(argv[2]) : 250;
+
+  char tmpl[] = "/tmp/bench_lazyXXXXXX";
+  int fd = mkstemp(tmpl);
+  if (fd < 0) { perror("mkstemp"); return 1; }
+  close(fd);
+  const std::string path = tmpl;
+  generate(path,ntables,nrows);
+  printf("input: %u tables x %u rows\n", ntables, nrows);
+
+  run("eager", path, false, ntables);
+  run("lazy",  path, true,  ntables);
+
+  unlink(path.c_str());
+  return 0;
+}
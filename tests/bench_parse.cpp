@@ -0,0 +1,121 @@
+#include <ark/ark.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+using namespace Ark;
+
+/* Times parsing and merging of a large, deeply nested keyvals file
+   shaped like our force-field arks: many tables holding vectors of
+   small parameter tables. */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  std::string generate(unsigned ntables, unsigned nrows) {
+    std::ostringstream o;
+    for (unsigned i=0; i<ntables; ++i) {
+      o << "table_" << i << " {\n"
+        << "  name = \"force field table " << i << "\"\n"
+        << "  rows = [\n";
+      for (unsigned j=0; j<nrows; ++j) {
+        o << "    { type = t" << j%17 << " sigma = " << 0.1*j
+          << " epsilon = " << 1.0/(j+1) << " memo = \"row " << j
+          << " of table " << i << "\" tags = [a b c] }\n";
+      }
+      o << "  ]\n}\n";
+    }
+    return o.str();
+  }
+
+  // all a walk that needs no tree does
+  struct counter : handler {
+    size_t atoms=0, keys=0;
+    void on_atom(std::string_view) { ++atoms; }
+    void on_key(std::string_view) { ++keys; }
+  };
+}
+
+int main(int argc, char **argv) {
+  unsigned ntables = argc>1 ? atoi(argv[1]) : 200;
+  unsigned nrows   = argc>2 ? atoi(argv[2]) : 250;
+
+  std::string text = generate(ntables,nrows);
+  printf("input: %u tables x %u rows, %zu bytes\n",
+         ntables, nrows, text.size());
+
+  clock_type::time_point t0 = clock_type::now();
+  ark a;
+  parser().parse_keyvals(a,text);
+  printf("parse_keyvals:          %8.3f s\n", since(t0));
+
+  t0 = clock_type::now();
+  ark fa;
+  feeder fd(fa);
+  for (size_t i=0; i<text.size(); i+=4096)
+    fd.feed(text.data()+i,std::min(text.size()-i,size_t(4096)));
+  fd.finish();
+  printf("feeder (4 KB pieces):   %8.3f s\n", since(t0));
+  fa.clear();
+
+  counter kh;
+  t0 = clock_type::now();
+  parser().parse_keyvals(kh,text);
+  printf("parse_keyvals (handler):%8.3f s\n", since(t0));
+
+  std::ostringstream printed;
+  printed << a;
+  t0 = clock_type::now();
+  ark s = parse(printed.str());
+  printf("strict parse:           %8.3f s\n", since(t0));
+
+  counter sh;
+  t0 = clock_type::now();
+  parse(printed.str(),sh);
+  printf("strict parse (handler): %8.3f s\n", since(t0));
+  if (sh.atoms!=kh.atoms || sh.keys!=kh.keys) printf("handler counts differ\n");
+
+  // one keyval per leaf, each sharing most of its superkey
+  std::ostringstream flat;
+  printer P;
+  P.flatten(true).no_delim(true);
+  flat << P(a);
+  t0 = clock_type::now();
+  ark f;
+  parser().parse_keyvals(f,flat.str());
+  printf("parse_keyvals (flat):   %8.3f s\n", since(t0));
+  f.clear();
+
+  t0 = clock_type::now();
+  parser().threads(0).parse_keyvals(f,flat.str());
+  printf("threads(0) (flat):      %8.3f s\n", since(t0));
+  f.clear();
+
+  t0 = clock_type::now();
+  ark c(a);
+  printf("copy:                   %8.3f s\n", since(t0));
+
+  ark m1, m2;
+  t0 = clock_type::now();
+  m1.merge(a).merge(s);
+  printf("merge (const ark&):     %8.3f s\n", since(t0));
+
+  t0 = clock_type::now();
+  m2.merge(std::move(c)).merge(std::move(s));
+  printf("merge (ark&&):          %8.3f s\n", since(t0));
+
+  t0 = clock_type::now();
+  m1.clear();
+  m2.clear();
+  a.clear();
+  printf("destroy:                %8.3f s\n", since(t0));
+  return 0;
+}
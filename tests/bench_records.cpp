@@ -0,0 +1,72 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Ark;
+
+/* Times reading an ark stream of per-step state records (100 MB by
+   default) one by one, and in batches parsed on more and more threads. */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  std::string generate(size_t bytes) {
+    std::ostringstream o;
+    record_writer w(o);
+    for (unsigned i=0; (size_t)o.tellp() < bytes; ++i) {
+      std::ostringstream r;
+      r << "step = " << i << " time = " << 0.0025*i << " energy = {";
+      for (unsigned j=0; j<20; ++j) r << " term_" << j << " = " << 1.0/(i+j+1);
+      r << " } positions = [";
+      for (unsigned j=0; j<200; ++j) r << " " << 0.001*(i^j);
+      r << " ]";
+      ark a;
+      parser().parse_keyvals(a,r.str());
+      w.write(a);
+    }
+    return o.str();
+  }
+
+  void report(const char *what, double t, size_t n, size_t records) {
+    printf("%-22s %8.3f s  %7.1f MB/s  %zu records\n", what, t, n/t/1e6,
+           records);
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t mb = argc>1 ? atoi(argv[1]) : 100;
+  std::string text = generate(mb<<20);
+  printf("input: %zu bytes\n", text.size());
+
+  {
+    std::istringstream in(text);
+    record_reader r(in);
+    ark a;
+    clock_type::time_point t0 = clock_type::now();
+    while (r.next(a)) ;
+    report("one by one", since(t0), text.size(), r.records());
+  }
+
+  unsigned most = std::thread::hardware_concurrency();
+  for (unsigned nt=1; nt<=most; nt*=2) {
+    std::istringstream in(text);
+    record_reader r(in);
+    std::vector<ark> batch;
+    clock_type::time_point t0 = clock_type::now();
+    while (r.next(batch,256,nt)) ;
+    char what[64];
+    snprintf(what,sizeof(what),"batches, %u threads",nt);
+    report(what, since(t0), text.size(), r.records());
+  }
+  return 0;
+}
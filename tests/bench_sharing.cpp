@@ -0,0 +1,77 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#define HEAP() mallinfo2().uordblks
+#else
+#define HEAP() size_t(0)
+#endif
+
+using namespace Ark;
+
+/* Keeps snapshots of a large configuration, one per job variant, each
+   a copy with one value changed, and reports the time and heap bytes
+   a snapshot takes next to those of parsing the configuration. */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  std::string generate(unsigned ntables, unsigned nrows) {
+    std::ostringstream o;
+    for (unsigned i=0; i<ntables; ++i) {
+      o << "table_" << i << " = [\n";
+      for (unsigned j=0; j<nrows; ++j)
+        o << "  { type = t" << j%17 << " sigma = " << 0.1*j
+          << " epsilon = " << 1.0/(j+1) << " tags = [a b c] }\n";
+      o << "]\n";
+    }
+    o << "run = { steps = 1000 temp = 300 }\n";
+    return o.str();
+  }
+}
+
+int main(int argc, char **argv) {
+  unsigned ntables = argc>1 ? atoi(argv[1]) : 20;
+  unsigned nrows   = argc>2 ? atoi(argv[2]) : 500;
+  unsigned nsnaps  = argc>3 ? atoi(argv[3]) : 1000;
+
+  std::string text = generate(ntables,nrows);
+  printf("input: %u tables of %u rows, %zu bytes\n", ntables, nrows,
+         text.size());
+
+  size_t h0 = HEAP();
+  clock_type::time_point t0 = clock_type::now();
+  ark base;
+  parser().parse_keyvals(base,text);
+  double parse = since(t0);
+  size_t tree = HEAP()-h0;
+
+  std::vector<ark> snaps;
+  snaps.reserve(nsnaps);
+  h0 = HEAP();
+  t0 = clock_type::now();
+  for (unsigned k=0; k<nsnaps; ++k) {
+    snaps.push_back(base);
+    ark &s = snaps.back();
+    s.table()["run"].table()["temp"] = std::to_string(300+k);
+    s.table()["table_" + std::to_string(k%ntables)].vector()[k%nrows]
+      .table()["sigma"] = "0";
+  }
+  double snap = since(t0)/nsnaps;
+  size_t each = (HEAP()-h0)/nsnaps;
+
+  printf("  parse    %10.1f us %10zu bytes\n", 1e6*parse, tree);
+  printf("  snapshot %10.1f us %10zu bytes\n", 1e6*snap, each);
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <ark/ark.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+
+using namespace Ark;
+
+/* Times the strict parse of printer output against parse_trusted(),
+   with and without its checks, on a generated file of force-field
+   tables (200 MB by default). */
+
+namespace {
+  typedef std::chrono::steady_clock clock_type;
+
+  double since(clock_type::time_point t0) {
+    return std::chrono::duration<double>(clock_type::now()-t0).count();
+  }
+
+  std::string generate(size_t bytes, bool whitespace) {
+    std::ostringstream o;
+    for (unsigned i=0; (size_t)o.tellp() < bytes; ++i) {
+      o << "table_" << i << " {\n"
+        << "  name = \"force field table " << i << "\"\n"
+        << "  rows = [\n";
+      for (unsigned j=0; j<1000; ++j) {
+        o << "    { type = t" << j%17 << " sigma = " << 0.1*j
+          << " epsilon = " << 1.0/(j+1) << " memo = \"row " << j
+          << " of table " << i << " \\\"q\\\"\" tags = [a b c] }\n";
+      }
+      o << "  ]\n}\n";
+    }
+    ark a;
+    parser().parse_keyvals(a,o.str());
+    std::ostringstream printed;
+    printer P;
+    P.whitespace(whitespace);
+    printed << P(a);
+    return printed.str();
+  }
+
+  void run(const char *what, const std::string &text, bool check,
+           bool trusted, const std::string &expect) {
+    clock_type::time_point t0 = clock_type::now();
+    ark a = trusted ? parse_trusted(text,check) : parse(text);
+    double t = since(t0);
+    std::ostringstream o;
+    if (expect.size()) o << a;
+    printf("%-26s %8.3f s  %7.1f MB/s%s\n", what, t, text.size()/t/1e6,
+           o.str()!=expect ? "  (differs)" : "");
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t mb = argc>1 ? atoi(argv[1]) : 200;
+  for (int ws=0; ws<2; ++ws) {
+    std::string text = generate(mb<<20,ws);
+    printf("input: %zu bytes of printer output%s\n", text.size(),
+           ws ? " with whitespace" : "");
+    std::ostringstream o;
+    o << parse(text);
+    run("parse", text, true, false, "");
+    run("parse_trusted", text, true, true, o.str());
+    run("parse_trusted (no checks)", text, false, true, o.str());
+    {
+      clock_type::time_point t0 = clock_type::now();
+      arena A;
+      const ark &a = parse_trusted_into(A,text.data(),text.size(),false);
+      double t = since(t0);
+      std::ostringstream p;
+      p << a;
+      printf("%-26s %8.3f s  %7.1f MB/s%s\n", "parse_trusted_into", t,
+             text.size()/t/1e6, p.str()!=o.str() ? "  (differs)" : "");
+    }
+  }
+  return 0;
+}
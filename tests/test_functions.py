@@ -91,3 +91,16 @@ def testCircular():
     with pytest.raises(RuntimeError):
         ark.toString(d)
 
+
+def testRecords():
+    records = [dict(step='1', note='two\nlines'), ['1', '2'], 'x', dict()]
+    with tempfile.TemporaryFile() as fp:
+        for r in records:
+            ark.writeRecord(fp, r)
+        fp.write(b'9 {a=1}\n')
+        fp.seek(0)
+        got = ark.readRecords(fp)
+        for r in records:
+            assert next(got) == r
+        with pytest.raises(ValueError):
+            next(got)
@@ -53,5 +53,19 @@ int main() {
     }
   }
 
+  // the tokenizer quotes an unterminated string as far as it went
+  std::string msg;
+  try {
+    parse("{ k = \"open = 1 }");
+  }
+  catch (Ark::exception &e) {
+    msg = e.what();
+  }
+  if (msg != "invalid string token\n"
+             "input error at line=1,col=17:open = 1 }\n") {
+    fail=true;
+    fprintf(stderr,"failed: unterminated string says \"%s\"\n",msg.c_str());
+  }
+
   if (fail) exit(1);
 }
@@ -0,0 +1,200 @@
+#include "ut_common.hpp"
+#include <random>
+
+using namespace Ark;
+
+/* A parse into bound members must set each of them to what xget() of
+   its key finds after a full parse, converted as a reader would, and
+   be told when a required key is missing or a value won't convert.
+   Random keyvals, with overrides, enclosures and erasures, check the
+   first against full parses. */
+
+namespace {
+  struct config {
+    double temp;
+    int steps;
+    std::string name;
+    bool verbose;
+    std::vector<int> seeds;
+    ark extra;
+    config() : temp(0), steps(0), verbose(false) {}
+  };
+
+  std::string error_of(const binding<config> &B, const std::string &text) {
+    config c;
+    try {
+      parser().parse_keyvals(c,B,text);
+    }
+    catch (exception &e) {
+      return e.what();
+    }
+    return "";
+  }
+
+  // every member an ark, to compare with a full parse
+  struct six { ark a, b, c, d, e, f; };
+  ark six::* const members[] = {
+    &six::a, &six::b, &six::c, &six::d, &six::e, &six::f
+  };
+
+  void same(const std::vector<std::string> &keys, const std::string &text) {
+    ark full;
+    try {
+      parser().parse_keyvals(full,text);
+    }
+    catch (exception &) {
+      return;
+    }
+    binding<six> B;
+    for (size_t i=0; i<keys.size(); ++i) B.bind_opt(keys[i],members[i]);
+    six s;
+    try {
+      parser().parse_keyvals(s,B,text);
+    }
+    catch (exception &e) {
+      fprintf(stderr,"failed:\n%s\nthrew %s\n", text.c_str(), e.what());
+      fail=true;
+      return;
+    }
+    for (size_t i=0; i<keys.size(); ++i) {
+      const ark *v = full.xget(keys[i]);
+      std::ostringstream f, b;
+      f << (v ? *v : ark());
+      b << s.*members[i];
+      if (f.str() == b.str()) continue;
+      fprintf(stderr,"failed:\n%s\n%s: full %s, bound %s\n", text.c_str(),
+              keys[i].c_str(), f.str().c_str(), b.str().c_str());
+      fail=true;
+    }
+  }
+
+  // a superkey over a few keys, with "[+]" steps if plus
+  std::string random_path(std::mt19937 &g, bool plus) {
+    static const char *keys[] = { "a", "b", "c" };
+    std::string s = keys[g()%3];
+    for (unsigned n=g()%3; n; --n)
+      switch (g()%4) {
+      case 0: s += "[" + std::to_string(g()%3) + "]"; break;
+      case 1: if (plus) { s += "[+]"; break; } // fallthrough
+      default: s += std::string(".") + keys[g()%3]; break;
+      }
+    return s;
+  }
+
+  std::string random_value(std::mt19937 &g, int depth);
+
+  // keyvals with overrides, enclosures and erasures
+  std::string random_keyvals(std::mt19937 &g, int depth, unsigned n) {
+    std::string s;
+    for (; n; --n) {
+      std::string p = random_path(g,true);
+      switch (depth ? g()%5 : g()%3) {
+      case 0: case 1: s += p + " = " + random_value(g,depth) + "\n"; break;
+      case 2: s += p + " !erase\n"; break;
+      default:
+        s += p + " { " + random_keyvals(g,depth-1,g()%3) + "}\n"; break;
+      }
+    }
+    return s;
+  }
+
+  std::string random_value(std::mt19937 &g, int depth) {
+    switch (depth ? g()%5 : g()%2) {
+    case 0: return std::to_string(g()%100);
+    case 1: return "'q " + std::to_string(g()%10) + "'";
+    case 2: return "?";
+    case 3: {
+      std::string s = "[";
+      for (unsigned n=g()%4; n; --n) s += " " + random_value(g,depth-1);
+      return s + " ]";
+    }
+    default:
+      return "{ " + random_keyvals(g,depth-1,g()%3) + "}";
+    }
+  }
+}
+
+int main() {
+  scratch("ut_binding");
+
+  const binding<config> B = binding<config>()
+    .bind("md.temp",&config::temp)
+    .bind("md.steps",&config::steps,1000)
+    .bind_opt("md.name",&config::name)
+    .bind_opt("md.verbose",&config::verbose)
+    .bind_opt("md.seeds",&config::seeds)
+    .bind_opt("extra",&config::extra);
+
+  // files, includes and overrides
+  write("base.ark",
+        "md { temp = 300 steps = 10 name = base seeds = [1 2] }\n"
+        "noise = { md = { temp = 1 } }\n");
+  write("run.ark",
+        "!include base.ark\n"
+        "md.temp = 310\n"
+        "md.steps !erase\n"
+        "md.seeds[+] = 3\n"
+        "extra = { a = [x y] }\n"
+        "md { verbose = true }\n");
+  {
+    config c;
+    c.name = "unset";
+    parser().parse_file(c,B,path("run.ark"));
+    std::ostringstream o;
+    o << c.extra;
+    if (c.temp!=310 || c.steps!=1000 || c.name!="base" || !c.verbose
+        || c.seeds.size()!=3 || c.seeds[2]!=3 || o.str()!="{a=[\"x\"\"y\"]}") {
+      fprintf(stderr,"failed: run.ark %g %d %s %d %zu %s\n", c.temp, c.steps,
+              c.name.c_str(), c.verbose, c.seeds.size(), o.str().c_str());
+      fail=true;
+    }
+  }
+  {
+    config c;
+    c.name = "unset";
+    parser().parse_keyvals(c,B,"md = { temp = 2 name = ? } md = 5 md.temp=3");
+    if (c.temp!=3 || c.steps!=1000 || c.name!="unset") {
+      fprintf(stderr,"failed: overridden %g %d %s\n", c.temp, c.steps,
+              c.name.c_str());
+      fail=true;
+    }
+  }
+
+  // errors
+  std::string e = error_of(B,"md.steps = 5");
+  if (e.find("md.temp")==std::string::npos) {
+    fprintf(stderr,"failed: missing required key says: %s\n", e.c_str());
+    fail=true;
+  }
+  e = error_of(B,"md.temp = warm");
+  if (e.find("md.temp")==std::string::npos) {
+    fprintf(stderr,"failed: bad number says: %s\n", e.c_str());
+    fail=true;
+  }
+  e = error_of(B,"md.temp = 1 md = {");
+  if (e.find("parse problem")==std::string::npos) {
+    fprintf(stderr,"failed: bad text says: %s\n", e.c_str());
+    fail=true;
+  }
+  try {
+    binding<config>().bind("md[+]",&config::temp);
+    fprintf(stderr,"failed: [+] is no key to bind\n");
+    fail=true;
+  }
+  catch (exception &) {}
+
+  // random keyvals, for keys held below each other or apart
+  const std::vector<std::vector<std::string> > keysets = {
+    { "a.b", "a.c.a", "b.c", "c[1]", "c[0].a", "b.c.b" },
+    { "a", "a.b", "b.c.b", "c", "a.b[1]", "b.a[0].c" },
+    { "b.c.b", "a.b", "b.c", "c[0]", "a", "c" },
+  };
+  std::mt19937 g(23);
+  for (int i=0; i<20000; ++i) {
+    std::string text = random_keyvals(g,3,1+g()%5);
+    for (size_t k=0; k<keysets.size(); ++k) same(keysets[k],text);
+  }
+
+  clean();
+  if (fail) exit(1);
+}
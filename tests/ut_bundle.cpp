@@ -0,0 +1,58 @@
+#include "ut_common.hpp"
+
+using namespace Ark;
+
+/* A bundle must parse to the same ark as the loose files it was made
+   from, and keep doing so once the loose files are gone. */
+
+namespace {
+  std::string run(const std::string &file, const std::string &start) {
+    return outcome([&](ark &a) {
+      parser P;
+      P.parse_keyvals(a,start);
+      P.parse_file(a,path(file));
+    });
+  }
+}
+
+int main() {
+  scratch("ut_bundle");
+  make_dir("sub");
+
+  write("top.ark",   "a = 1 v = [1 2] !include sub/a.ark\n"
+                     "t { !include " + dir + "/sub/b.ark }\n");
+  write("sub/a.ark", "a = 2 v[+] = 3 f = !file b.ark !include b.ark\n");
+  write("sub/b.ark", "x = 1 v[0] !erase\n");
+
+  {
+    std::ofstream out(path("top.arkb").c_str());
+    parser().write_bundle(out,path("top.ark"));
+  }
+  std::string plain = run("top.ark","");
+  std::string table = run("top.ark","v = [9] t.y = 2");
+  check("bundle", plain, run("top.arkb",""));
+  check("into a table", table, run("top.arkb","v = [9] t.y = 2"));
+
+  // the loose files are not needed any more
+  unlink(path("sub/a.ark").c_str());
+  unlink(path("sub/b.ark").c_str());
+  check("without includes", plain, run("top.arkb",""));
+
+  // a bundle can be included like any file
+  write("outer.ark", "o { !include top.arkb }\n");
+  std::string nested = run("outer.ark","");
+  if (nested.find("error")!=std::string::npos) check("included", "", nested);
+
+  // truncation is reported, not parsed around
+  std::ostringstream o;
+  o << std::ifstream(path("top.arkb").c_str()).rdbuf();
+  write("short.arkb", o.str().substr(0, o.str().size()-4));
+  if (run("short.arkb","").find("malformed bundle")==std::string::npos) {
+    fprintf(stderr,"failed: truncated bundle parsed\n");
+    fail=true;
+  }
+
+  clean();
+
+  if (fail) exit(1);
+}
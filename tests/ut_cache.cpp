@@ -0,0 +1,99 @@
+#include "ut_common.hpp"
+#include <thread>
+
+using namespace Ark;
+
+/* Includes replayed from the cache must give the same ark, or the
+   same error, as parsing the file again, and a file that changes on
+   disk must be parsed again. */
+
+namespace {
+  std::string run(const std::string &text, bool cache) {
+    return outcome([&](ark &a) {
+      parser().cache_includes(cache).parse_keyvals(a,text);
+    });
+  }
+
+  void same(const std::string &text) {
+    std::string plain = run(text,false);
+    for (int i=0; i<2; ++i) {
+      std::string cached = run(text,true);
+      if (cached == plain) continue;
+      fprintf(stderr,"failed: cached parse differs\nplain:\n%s\ncached:\n%s\n",
+              plain.c_str(), cached.c_str());
+      fail=true;
+    }
+  }
+}
+
+int main() {
+  scratch("ut_cache");
+
+  write("ff.ark",   "atoms = [C H O] mass { C = 12 H = 1 }\n"
+                    "mass.O = 16 atoms[+] = N !include more.ark\n");
+  write("more.ark", "mass.N = 14 cutoff = 9 top = !file ff.ark\n");
+  write("bad.ark",  "x = { unterminated\n");
+  write("badidx.ark", "atoms[9] = X\n");
+
+  const std::string ff = "!include " + dir + "/ff.ark\n";
+  std::string replicas;
+  for (int i=0; i<20; ++i) {
+    std::ostringstream o;
+    o << "r" << i << " { " << ff << " mass.C = " << i << " }\n"
+      << "r" << i << ".atoms !erase\n";
+    replicas += o.str();
+  }
+
+  include_cache::reset();
+  same(replicas);
+  check("hits counted", include_cache::hits() == 2*2*20-2);
+  check("misses counted", include_cache::misses() == 2);
+  check("entries", include_cache::size() == 2);
+
+  same("atoms = [A] " + ff + " !include " + dir + "/bad.ark\n");
+  same("!include " + dir + "/badidx.ark\n");
+  same("x { " + ff + " } !include " + dir + "/missing.ark\n");
+
+  // the same file under another name gives other !file values
+  if (symlink(dir.c_str(), path("again").c_str())) { perror("symlink"); exit(1); }
+  same(ff + "y { !include " + dir + "/again/ff.ark }\n");
+  unlink(path("again").c_str());
+
+  // a changed file is read again
+  include_cache::reset();
+  std::string before = run(ff,true);
+  write("more.ark", "mass.N = 14 cutoff = 12\n");
+  std::string after = run(ff,true);
+  check("changed file reparsed", before != after && after == run(ff,false));
+  check("changed file missed", include_cache::misses() == 3);
+
+  // so is one included from inside a value
+  write("outer.ark", "x = { !include inner.ark }\ny { !include inner.ark }\n"
+                     "z = [ 1 { q = 2 !include inner.ark } ]\n");
+  write("inner.ark", "v = 1\n");
+  const std::string outer = "!include " + dir + "/outer.ark\n";
+  before = run(outer,true);
+  write("inner.ark", "v = 2222\n");
+  after = run(outer,true);
+  check("changed value include reparsed",
+        before != after && after == run(outer,false));
+
+  // a value including itself fails where a direct parse does
+  write("loop.ark", "a = 1\n\n  x = { b = 2\n   y = { !include loop.ark } }\n");
+  same("!include " + dir + "/loop.ark\n");
+
+  // several threads share it
+  include_cache::reset();
+  const std::string expected = run(replicas,false);
+  std::vector<std::thread> threads;
+  std::vector<std::string> results(4);
+  for (size_t i=0; i<results.size(); ++i)
+    threads.emplace_back([&,i]() { results[i] = run(replicas,true); });
+  for (size_t i=0; i<threads.size(); ++i) threads[i].join();
+  for (size_t i=0; i<results.size(); ++i)
+    check("threaded parse", results[i] == expected);
+
+  clean();
+
+  if (fail) exit(1);
+}
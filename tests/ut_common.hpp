@@ -0,0 +1,90 @@
+#ifndef ut_common_hpp
+#define ut_common_hpp
+
+#include <ark/ark.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* What the unit tests share: a scratch directory for the files they
+   parse, a flag that any failed check sets, and arks and parses
+   written out as text to compare.  Each ut_*.cpp includes this once,
+   keeps its own cases, and exits 1 from main() if fail is set. */
+
+namespace {
+  inline std::string dir;   // the scratch directory, once made
+  inline bool fail=false;
+
+  // a new scratch directory, named after the test
+  inline void scratch(const std::string &test) {
+    std::string t = "/tmp/" + test + "XXXXXX";
+    if (!mkdtemp(&t[0])) { perror("mkdtemp"); exit(1); }
+    dir = t;
+  }
+
+  inline std::string path(const std::string &name) { return dir + "/" + name; }
+
+  inline void make_dir(const std::string &name) {
+    if (mkdir(path(name).c_str(), 0777)) { perror("mkdir"); exit(1); }
+  }
+
+  inline void write(const std::string &name, const std::string &text) {
+    std::ofstream(path(name).c_str(), std::ios::binary) << text;
+  }
+
+  // the scratch directory and everything in it
+  inline void clean() {
+    nftw(dir.c_str(), [](const char *p, const struct stat *, int,
+                         struct FTW *) { return remove(p); },
+         16, FTW_DEPTH|FTW_PHYS);
+  }
+
+  inline std::string show(const Ark::ark &a) {
+    std::ostringstream o;
+    o << a;
+    return o.str();
+  }
+
+  inline std::string joined(const std::vector<std::string> &v) {
+    std::string s;
+    for (size_t i=0; i<v.size(); ++i) s += (i ? " " : "") + v[i];
+    return s;
+  }
+
+  // what parse(a) leaves in a new ark, after its error if it threw
+  template <typename F>
+  std::string outcome(F parse) {
+    Ark::ark a;
+    std::ostringstream o;
+    try {
+      parse(a);
+    }
+    catch (Ark::exception &e) {
+      o << "error: " << e.what() << "\n";
+    }
+    o << a;
+    return o.str();
+  }
+
+  inline void check(const std::string &what, const std::string &expect,
+                    const std::string &got) {
+    if (got == expect) return;
+    fprintf(stderr,"failed: %s\nexpected:\n%s\ngot:\n%s\n",
+            what.c_str(), expect.c_str(), got.c_str());
+    fail=true;
+  }
+
+  inline void check(const std::string &what, bool ok) {
+    if (ok) return;
+    fprintf(stderr,"failed: %s\n",what.c_str());
+    fail=true;
+  }
+}
+
+#endif
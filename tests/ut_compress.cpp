@@ -0,0 +1,202 @@
+#include "ut_common.hpp"
+
+using namespace Ark;
+
+/* Compressed files must parse, wherever a file is read, to what the
+   same text does uncompressed, errors included; and what the printer
+   writes compressed must read back. */
+
+namespace {
+  void write(const std::string &name, const std::string &text,
+             compression_t z) {
+    std::ofstream f(path(name).c_str(), std::ios::binary);
+    deflater d(f,z);
+    d << text;
+    d.finish();
+  }
+
+  std::string slurp(const std::string &name) {
+    std::ifstream f(path(name).c_str(), std::ios::binary);
+    std::ostringstream o;
+    o << f.rdbuf();
+    return o.str();
+  }
+
+  // how: 0 plain, 1 lazy, 2 loader on threads, 3 cached snapshot,
+  // 4 arena
+  std::string result(const std::string &name, int how) {
+    std::ostringstream o;
+    try {
+      ark a;
+      parser P;
+      if (how==1) P.lazy(true);
+      if (how==3) P.cache_dir(dir);
+      if (how==2) loader(parser().threads(4)).include(path(name)).load(a);
+      else if (how==4) {
+        arena A;
+        o << P.parse_file_into(A,path(name));
+        return o.str();
+      }
+      else P.parse_file(a,path(name));
+      o << a;
+    }
+    catch (exception &e) {
+      o << "error: " << e.what();
+    }
+    return o.str();
+  }
+
+  // the compressed file's name is in error messages, so compare with
+  // the plain file's results under that name
+  void same(const char *what, const std::string &plain,
+            const std::string &packed) {
+    for (int how=0; how<5; ++how)
+      for (int twice=0; twice<(how==3 ? 2 : 1); ++twice) {
+        std::string expect = result(plain,how);
+        std::string got = result(packed,how);
+        for (size_t at=0; (at = expect.find(plain,at)) != std::string::npos;
+             at += packed.size())
+          expect.replace(at,plain.size(),packed);
+        char label[256];
+        snprintf(label,sizeof(label),"%s (%d)",what,how);
+        check(label,expect,got);
+      }
+  }
+
+  std::string big_text() {
+    std::ostringstream o;
+    for (unsigned i=0; i<20000; ++i)
+      o << "t" << i%7 << ".v[+] = { x = " << i << " s = \"row " << i
+        << "\" } # comment " << i << "\n";
+    return o.str();
+  }
+}
+
+int main() {
+  scratch("ut_compress");
+
+  const compression_t kinds[] = { Gzip, Zstd };
+  const char *exts[] = { ".gz", ".zst" };
+  for (int k=0; k<2; ++k) {
+    compression_t z = kinds[k];
+    std::string ext = exts[k];
+    if (!compression_supported(z)) {
+      // recognized, and refused
+      write("no" + ext, z==Gzip ? std::string("\x1f\x8b\x08\0",4)
+                                : std::string("\x28\xb5\x2f\xfd",4));
+      std::string got = result("no" + ext,0);
+      if (got.find("built without")==std::string::npos) {
+        fprintf(stderr,"failed: unsupported %s\n%s\n",ext.c_str(),got.c_str());
+        fail=true;
+      }
+      continue;
+    }
+
+    // big enough to be inflated in many pieces
+    std::string text = big_text();
+    write("big.ark", text);
+    write("big.ark" + ext, text, z);
+    same("big", "big.ark", "big.ark" + ext);
+
+    // !include from and of compressed files
+    write("inc.ark" + ext, "i = 1 j = !file here\n", z);
+    write("top.ark", "a = 1 b { !include inc.ark" + ext + " } c.d = 2\n");
+    write("top2.ark" + ext, "a = 1 b { !include inc.ark" + ext + " } c.d = 2\n", z);
+    same("include", "top.ark", "top2.ark" + ext);
+
+    // errors say where, in the inflated text
+    const char *bad[] = {
+      "a = 1\nb = [ 1 2\n", "a = 1\n\n  9 = 2", "a = \"open", "a.b = 1 a { c",
+      "!include nowhere.ark"
+    };
+    for (size_t i=0; i<sizeof(bad)/sizeof(bad[0]); ++i) {
+      write("bad.ark", bad[i]);
+      write("bad.ark" + ext, bad[i], z);
+      same(bad[i], "bad.ark", "bad.ark" + ext);
+    }
+
+    // concatenated files read as one
+    {
+      std::ostringstream o;
+      deflater d1(o,z);
+      d1 << "a = 1 b";
+      d1.finish();
+      deflater d2(o,z);
+      d2 << ".c = 2\n";
+      d2.finish();
+      write("cat.ark" + ext, o.str());
+      write("cat.ark", "a = 1 b.c = 2\n");
+      same("concatenated", "cat.ark", "cat.ark" + ext);
+    }
+
+    // damaged files are errors
+    std::string whole = slurp("big.ark" + ext);
+    write("short.ark" + ext, whole.substr(0,whole.size()/2));
+    std::string got = result("short.ark" + ext,0);
+    if (got.find("cut short")==std::string::npos) {
+      fprintf(stderr,"failed: truncated %s\n%s\n",ext.c_str(),got.c_str());
+      fail=true;
+    }
+    std::string broken = whole;
+    for (size_t i=100; i<200; ++i) broken[i] ^= 0x5a;
+    write("broken.ark" + ext, broken);
+    got = result("broken.ark" + ext,0);
+    if (got.find("corrupt")==std::string::npos) {
+      fprintf(stderr,"failed: corrupt %s\n%s\n",ext.c_str(),got.c_str());
+      fail=true;
+    }
+
+    // the printer writes it, and it reads back
+    {
+      ark a;
+      parser().parse_file(a,path("big.ark"));
+      printer().no_delim(true)(a).save(path("saved.ark" + ext));
+      std::string saved = slurp("saved.ark" + ext);
+      if (compression_of(saved.data(),saved.size())!=z) {
+        fprintf(stderr,"failed: saved %s isn't compressed\n",ext.c_str());
+        fail=true;
+      }
+      check("saved", result("big.ark",0), result("saved.ark" + ext,0));
+    }
+
+    // an ark stream, through streams both ways
+    {
+      std::ostringstream o;
+      deflater d(o,z);
+      record_writer w(d);
+      std::vector<ark> v;
+      for (int i=0; i<100; ++i) {
+        v.push_back(ark());
+        parser().parse_keyvals(v.back(),"step = " + std::to_string(i)
+                               + " s = \"x\ny\"");
+        w.write(v.back());
+      }
+      d.finish();
+      std::istringstream i(o.str());
+      inflater in(i);
+      record_reader r(in);
+      ark a;
+      std::ostringstream expect, got;
+      for (size_t j=0; j<v.size(); ++j) expect << v[j] << "\n";
+      while (r.next(a)) got << a << "\n";
+      check("records", expect.str(), got.str());
+    }
+  }
+
+  // plain text passes through an inflater as it is
+  {
+    std::string text = big_text();
+    std::istringstream i(text);
+    inflater in(i);
+    std::ostringstream o;
+    o << in.rdbuf();
+    if (in.compression()!=Uncompressed || o.str()!=text) {
+      fprintf(stderr,"failed: plain text through an inflater\n");
+      fail=true;
+    }
+  }
+
+  clean();
+
+  if (fail) exit(1);
+}
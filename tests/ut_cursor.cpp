@@ -0,0 +1,138 @@
+#include "ut_common.hpp"
+#include <random>
+
+using namespace Ark;
+
+/* The parser resumes each keyval from the steps the one before took.
+   Parsing a file in one go must give what parsing its keyvals one at a
+   time does, however they override, erase, append to, enclose or
+   include over each other. */
+
+namespace {
+  // each line is parsed with nothing to resume from
+  bool one_line(ark &a, const std::string &line) {
+    try {
+      parser().parse_buffer(a,line.data(),line.size(),
+                            path("top.ark").c_str());
+      return true;
+    }
+    catch (exception &) {
+      return false;
+    }
+  }
+
+  void same(const char *what, const std::vector<std::string> &lines) {
+    ark one, whole;
+    std::string text;
+    for (size_t i=0; i<lines.size(); ++i) {
+      if (!one_line(one,lines[i])) {
+        fprintf(stderr,"failed: %s: bad line %s\n",what,lines[i].c_str());
+        fail=true;
+        return;
+      }
+      text += lines[i] + "\n";
+    }
+    try {
+      parser().parse_buffer(whole,text.data(),text.size(),
+                            path("top.ark").c_str());
+    }
+    catch (exception &e) {
+      fprintf(stderr,"failed: %s threw\n%s\n",what,e.what());
+      fail=true;
+      return;
+    }
+    if (show(one) != show(whole)) {
+      fprintf(stderr,"failed: %s\n%s\none at a time:\n%s\nin one go:\n%s\n",
+              what, text.c_str(), show(one).c_str(), show(whole).c_str());
+      fail=true;
+    }
+  }
+
+  std::string random_line(std::mt19937 &g) {
+    static const char *keys[] = { "a", "b", "c" };
+    static const char *values[] = { "1", "{}", "[]", "[1 2]", "{ a = 1 }",
+                                    "{ a.b = 2 }", "[ { a = 3 } ]", "?" };
+    std::string s;
+    unsigned depth = 1 + g()%4;
+    for (unsigned i=0; i<depth; ++i) {
+      if (i && g()%3==0) {
+        unsigned n = g()%4;
+        s += n==3 ? "[+]" : "[" + std::to_string(n) + "]";
+      }
+      else {
+        if (i) s += ".";
+        s += keys[g()%3];
+      }
+    }
+    switch (g()%6) {
+    case 0:  return s + " !erase";
+    case 1:  return s + " { " + keys[g()%3] + " = 4 }";
+    case 2:  return s + " { !include inc.ark }";
+    default: return s + " = " + values[g()%8];
+    }
+  }
+}
+
+int main() {
+  scratch("ut_cursor");
+  write("inc.ark", "a = 5 b.c = 6 c !erase\n");
+
+  same("overrides", {
+      "f.n.near.r_tap = 9", "f.n.near.r_cut = 10", "f.n.far.r_tap = 11",
+      "f.n.near.r_tap = 12", "f.m = 1", "f.n.near.x = 2" });
+  same("kinds", {
+      "a.b.c = 1", "a.b = 2", "a.b.c = 3", "a.b = [1]", "a.b[0] = 4",
+      "a.b[+] = 5", "a.b.c = 6", "a = { b = 7 }", "a.b = 8" });
+  same("erase", {
+      "a.b.c = 1", "a.b !erase", "a.b.d = 2", "a.b.c = 3", "a !erase",
+      "a.b.c = 4" });
+  same("vectors", {
+      "v[0].a = 1", "v[0].b = 2", "v[1].a = 3", "v[1].b = 4", "v[+] = 5",
+      "v[2] = 6", "v[0].c = 7", "v[0] !erase", "v[0].a = 8", "v[1].z = 9",
+      "v = []", "v[0].a = 10", "v[0].a = 11" });
+  same("enclosures", {
+      "a.b.c = 1", "a { b = 2 }", "a.b.c = 3", "a.b { !include inc.ark }",
+      "a.b.c = 4", "a.b.b.c = 5" });
+  same("includes", {
+      "c.d = 1", "!include inc.ark", "c.d = 2", "b.c = 7", "b.d = 8" });
+
+  // flattened printer output reads back as the tree it came from
+  {
+    ark a;
+    parser().parse_keyvals(a,
+      "t = { rows = [ { a = 1 b = [x y] } { a = 2 c = {} } ] n = ? }\n"
+      "u = { v = { w = 1 } x = [[1 2] [3]] }\n");
+    std::ostringstream o;
+    printer P;
+    P.flatten(true).no_delim(true).whitespace(true);
+    o << P(a);
+    ark b;
+    parser().parse_keyvals(b,o.str());
+    if (show(a) != show(b)) {
+      fprintf(stderr,"failed: flattened\n%s\n%s\n",
+              show(a).c_str(),show(b).c_str());
+      fail=true;
+    }
+  }
+
+  // and a lot of random keyvals, skipping any that don't apply
+  std::mt19937 g(17);
+  for (int round=0; round<300; ++round) {
+    ark probe;
+    std::vector<std::string> lines;
+    while (lines.size() < 40) {
+      std::string l = random_line(g);
+      if (one_line(probe,l)) lines.push_back(l);
+      else {
+        // a keyval that fails may have got part way
+        probe = ark();
+        for (size_t i=0; i<lines.size(); ++i) one_line(probe,lines[i]);
+      }
+    }
+    same("random", lines);
+  }
+
+  clean();
+
+  if (fail) exit(1);
+}
@@ -0,0 +1,159 @@
+#include "ut_common.hpp"
+#include <cstring>
+#include <random>
+
+using namespace Ark;
+
+/* Text fed to a feeder in pieces, broken anywhere, must parse to what
+   parse_keyvals() makes of all of it, with the same errors, and each
+   keyval must be told as soon as the text completes it. */
+
+namespace {
+  std::string whole(const std::string &text) {
+    std::ostringstream o;
+    ark a;
+    try {
+      parser().parse_buffer(a,text.data(),text.size(),path("top.ark").c_str());
+      o << a;
+    }
+    catch (exception &e) {
+      o << "error: " << e.what();
+    }
+    return o.str();
+  }
+
+  // fed in pieces of up to `most' bytes; keys gets what was told
+  std::string pieces(const std::string &text, std::mt19937 &g, size_t most,
+                     std::vector<std::string> *keys=NULL) {
+    std::ostringstream o;
+    ark a;
+    try {
+      feeder f(a,parser(),path("top.ark"));
+      for (size_t i=0; i<text.size(); ) {
+        size_t n = std::min(text.size()-i, size_t(1+g()%most));
+        const std::vector<std::string> &k = f.feed(text.data()+i,n);
+        if (keys) keys->insert(keys->end(),k.begin(),k.end());
+        i += n;
+      }
+      const std::vector<std::string> &k = f.finish();
+      if (keys) keys->insert(keys->end(),k.begin(),k.end());
+      o << a;
+    }
+    catch (exception &e) {
+      o << "error: " << e.what();
+    }
+    return o.str();
+  }
+
+  void same(const char *what, const std::string &text) {
+    std::string expect = whole(text);
+    std::mt19937 g(text.size());
+    std::vector<std::string> all;
+    pieces(text,g,text.size()+1,&all);
+    const size_t sizes[] = { 1, 2, 3, 7, 64 };
+    for (size_t i=0; i<sizeof(sizes)/sizeof(sizes[0]); ++i) {
+      std::vector<std::string> keys;
+      std::string got = pieces(text,g,sizes[i],&keys);
+      // what is told before an error depends on where the text breaks
+      if (got == expect && (keys == all || !got.find("error"))) continue;
+      fprintf(stderr,"failed: %s (pieces of up to %zu)\n%s\n"
+              "expected:\n%s\n%s\ngot:\n%s\n%s\n",
+              what, sizes[i], text.c_str(), expect.c_str(),
+              joined(all).c_str(), got.c_str(), joined(keys).c_str());
+      fail=true;
+    }
+  }
+
+  // keyvals text, right or wrong
+  std::string random_text(std::mt19937 &g) {
+    static const char *pieces[] = {
+      "a", "b.c", "d[0]", "d[+]", " = ", "=", " ", "\n", "1", "x.y", "?",
+      "{", "}", "[", "]", " !erase", "!include inc.ark", "\"s p\"",
+      "'q\\'t'", "`b`", "# note\n", "#", "\"", "\\", "e { f = 1 }",
+      "g = [ 1 { h = 2 } ]"
+    };
+    std::string s;
+    unsigned len = g()%30;
+    for (unsigned i=0; i<len; ++i) s += pieces[g()%(sizeof(pieces)/sizeof(pieces[0]))];
+    return s;
+  }
+}
+
+int main() {
+  scratch("ut_feeder");
+  write("inc.ark", "i = 1 j.k = [ 2 3 ]\n");
+
+  const char *texts[] = {
+    "a = 1 b = \"two words\" c = 'q\"uote' d = \"back\\\\slash\" e = ?\n"
+    "f = [ 1 [ 2 [] ] { g = {} h = [ ? ? ] } \"\" ]  # a comment\n"
+    "g.h[0] = 1 g.h[+] = 2 g.h[1] !erase g { x = 1 y = { z = 2 } }\n"
+    "long_key.with.dots = \"a \\\"q\\\" b\" n = 1.5 m = a.b\n",
+    "x = 1#c\ny = 2 # { [ \" '\nz = `b\\`q` !include inc.ark w = 3",
+    "a = {\n b = [\n  1\n  2\n ]\n}\n\n\n",
+    "", "   ", "# only a comment", "a = 1", "a.b", "a = ", "a = [1 2",
+    "a = \"open", "a = 'esc\\", "a { b = 1", "a[2] = 1", "9 = 1",
+    "a = 1 } b = 2", "a !frob", "!include nowhere.ark", "a = [ 1 ] ]",
+    "a = 1\nb = {\n c = [ x y\n", "a = 1 b. = 2"
+  };
+  for (size_t i=0; i<sizeof(texts)/sizeof(texts[0]); ++i)
+    same(texts[i],texts[i]);
+  same("NUL", std::string("a = 1 b = [ 2 ]\0c = 3",21));
+  same("NUL in string", std::string("a = 1 b = \"x\0\" c = 3",20));
+  {
+    std::mt19937 g(17);
+    for (int i=0; i<2000; ++i) same("random", random_text(g));
+  }
+
+  // keyvals are told as soon as they are complete
+  {
+    ark a;
+    feeder f(a);
+    const char *bits[] = { "a.b = 1", "2 c[+", "] = x c[+] = y", " d { e",
+                           " = 1 } f = 'it\\", "'s ", "'", "\n" };
+    std::string log;
+    for (size_t i=0; i<sizeof(bits)/sizeof(bits[0]); ++i)
+      log += "|" + joined(f.feed(bits[i],strlen(bits[i])));
+    log += "|" + joined(f.finish());
+    check("told", "||a.b|c[0]|c[1]|d||f||", log);
+    std::ostringstream o;
+    o << a;
+    check("told result", whole("a.b = 12 c[+] = x c[+] = y d { e = 1 } "
+                               "f = 'it\\'s '"), o.str());
+  }
+
+  // a feeder that has thrown stays broken
+  {
+    ark a;
+    feeder f(a);
+    std::string e1, e2;
+    try { f.feed(std::string("a = 1 9 = 2 ")); } catch (exception &e) { e1 = e.what(); }
+    try { f.feed(std::string("b = 3 ")); } catch (exception &e) { e2 = e.what(); }
+    if (e1.empty() || e2.empty()) {
+      fprintf(stderr,"failed: broken feeder\n%s\n%s\n",e1.c_str(),e2.c_str());
+      fail=true;
+    }
+  }
+
+  // an error leaves the ark as the last complete keyval did
+  {
+    const std::string text = "a = 1 b { c = 2 d = [ 1 2\n";
+    ark a;
+    feeder f(a,parser(),path("top.ark"));
+    std::string e;
+    try {
+      f.feed(text);
+      f.finish();
+    }
+    catch (exception &x) {
+      e = x.what();
+    }
+    check("error after a keyval", whole(text), "error: " + e);
+    std::ostringstream o;
+    o << a;
+    check("ark after an error", "{a=\"1\"}", o.str());
+  }
+
+  clean();
+
+  if (fail) exit(1);
+}
@@ -0,0 +1,180 @@
+#include "ut_common.hpp"
+#include <cstring>
+
+using namespace Ark;
+
+/* A handler must be told each grammar's input in order, with includes
+   followed, and errors must come out as they do when building an ark.
+   Rebuilding a tree from the strict grammar's events must give what
+   Ark::parse() does. */
+
+namespace {
+  // writes each event as a short word
+  struct recorder : handler {
+    std::ostringstream o;
+    void word(const std::string &w) { if (o.tellp()) o << ' '; o << w; }
+    void on_atom(std::string_view s) { word("'" + std::string(s) + "'"); }
+    void on_none() { word("?"); }
+    void begin_table() { word("{"); }
+    void end_table() { word("}"); }
+    void begin_vector() { word("["); }
+    void end_vector() { word("]"); }
+    void on_key(std::string_view k) { word(std::string(k) + ":"); }
+    void on_index(size_t i) {
+      word(i==append ? std::string("[+]") : "[" + std::to_string(i) + "]");
+    }
+    void on_erase() { word("!erase"); }
+    void begin_enclosure() { word("<"); }
+    void end_enclosure() { word(">"); }
+  };
+
+  // the strict grammar's events, made into a tree again
+  struct rebuilder : handler {
+    ark root;
+    std::vector<ark *> open;
+    std::string key;
+    ark &slot() {
+      if (open.empty()) return root;
+      ark &a = *open.back();
+      if (a.kind()==Vector) return a.emplace_back();
+      return a.emplace(key);
+    }
+    void on_atom(std::string_view s) { slot().be(Atom).atom() = atom_t(s); }
+    void on_none() { slot(); }
+    void begin_table() { open.push_back(&slot().be(Table)); }
+    void begin_vector() { open.push_back(&slot().be(Vector)); }
+    void end_table() { open.pop_back(); }
+    void end_vector() { open.pop_back(); }
+    void on_key(std::string_view k) { key = std::string(k); }
+  };
+
+  // refuses atoms that say "bad"
+  struct picky : handler {
+    void on_atom(std::string_view s) {
+      if (s=="bad") throw InputError("bad atom");
+    }
+  };
+
+  std::string strict(const std::string &text) {
+    recorder r;
+    parse(text,r);
+    return r.o.str();
+  }
+
+  std::string keyvals(const std::string &text) {
+    recorder r;
+    parser().parse_keyvals(r,text);
+    return r.o.str();
+  }
+
+  std::string error_of(void (*f)(const std::string &), const std::string &s) {
+    try {
+      f(s);
+    }
+    catch (exception &e) {
+      return e.what();
+    }
+    return "<no error>";
+  }
+}
+
+int main() {
+  scratch("ut_handler");
+  make_dir("sub");
+
+  check("strict",
+        "{ a: '1' b: [ 'x' ? { c: 'y' } ] d: { } }",
+        strict("{ a = \"1\" b = [ x ? { c = y } ] d = {} }"));
+  check("strict atom", "'z'", strict("z"));
+
+  check("keyvals",
+        "a: b: '1' a: b: '2' c: [1] [ '3' ] c: [+] '4' c: [0] !erase "
+        "d: < e: '5' f: { g: h: '6' } > i: ? j: !erase",
+        keyvals("a.b = 1 a.b = 2 c[1] = [3] c[+] = 4 c[0] !erase "
+                "d { e = 5 f = { g.h = 6 } } i = ? j !erase"));
+
+  // includes are told in place, !file values as paths
+  write("top.ark", "x = 1 !include sub/inc.ark z = !file top.dat\n");
+  write("sub/inc.ark", "y { w = !file w.dat }\n");
+  {
+    recorder r;
+    parser().parse_file(r,path("top.ark"));
+    check("include", "x: '1' y: < w: '" + dir + "/sub/w.dat' > z: '"
+          + dir + "/top.dat'", r.o.str());
+  }
+
+  // a selection skips what it would leave out of the tree
+  {
+    recorder r;
+    parser P;
+    P.select(std::vector<std::string>(1,"a.b"));
+    P.parse_keyvals(r,std::string("a = { b = 1 c = 2 } d = [ 3 ] a.b = 4"));
+    check("select", "a: { b: '1' } a: b: '4'", r.o.str());
+  }
+
+  // rebuilding a tree gives what Ark::parse() does
+  {
+    std::ostringstream o;
+    for (unsigned i=0; i<50; ++i)
+      o << "t" << i << " = { v = [ { a = " << i << " } ? [x \"y z\"] ] }\n";
+    ark a;
+    parser().parse_keyvals(a,o.str());
+    std::ostringstream printed;
+    printed << a;
+    rebuilder r;
+    parse(printed.str(),r);
+    std::ostringstream again;
+    again << r.root;
+    check("rebuild", printed.str(), again.str());
+  }
+
+  // errors read as they do when building an ark
+  {
+    struct strict_tree {
+      static void run(const std::string &s) { parse(s); }
+    };
+    struct strict_events {
+      static void run(const std::string &s) { recorder r; parse(s,r); }
+    };
+    struct keyvals_tree {
+      static void run(const std::string &s) { ark a; parser().parse_keyvals(a,s); }
+    };
+    struct keyvals_events {
+      static void run(const std::string &s) { recorder r; parser().parse_keyvals(r,s); }
+    };
+    const char *strict_bad[] = { "{ a = 1 b }", "[ 1 2", "{ a = 1 } x",
+                                 "{ 1 = 2 }" };
+    for (size_t i=0; i<sizeof(strict_bad)/sizeof(strict_bad[0]); ++i)
+      check(strict_bad[i], error_of(strict_tree::run,strict_bad[i]),
+            error_of(strict_events::run,strict_bad[i]));
+    const char *keyvals_bad[] = { "a = { b = }", "a[2] = 1 a[5] = 2",
+                                  "a = [1 2", "!include nowhere.ark",
+                                  "a !frob", "a.b[x] = 1" };
+    for (size_t i=0; i<sizeof(keyvals_bad)/sizeof(keyvals_bad[0]); ++i) {
+      std::string e = error_of(keyvals_events::run,keyvals_bad[i]);
+      // only the tree knows a vector's length
+      if (i==1) check(keyvals_bad[i], "<no error>", e);
+      else check(keyvals_bad[i], error_of(keyvals_tree::run,keyvals_bad[i]),e);
+    }
+  }
+
+  // a handler's exception comes out with the position
+  {
+    picky p;
+    std::string e = "<no error>";
+    try {
+      parser().parse_keyvals(p,std::string("a = 1\nb = [ ok bad ]"));
+    }
+    catch (exception &x) {
+      e = x.what();
+    }
+    if (!strstr(e.c_str(),"bad atom") || !strstr(e.c_str(),":2:")) {
+      fprintf(stderr,"failed: handler error says\n%s\n",e.c_str());
+      fail=true;
+    }
+  }
+
+  clean();
+
+  if (fail) exit(1);
+}
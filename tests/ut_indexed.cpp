@@ -0,0 +1,104 @@
+#include "ut_common.hpp"
+#include <random>
+
+using namespace Ark;
+
+/* parse_indexed() must give what parse() gives, errors included, with
+   each scanning kernel, wherever tokens fall on the 64-byte blocks the
+   index is built from. */
+
+namespace {
+  std::string result(const std::string &text, int how) {
+    std::ostringstream o;
+    try {
+      if (how==0) o << parse(text);
+      else if (how==1) o << parse_indexed(text);
+      else {
+        arena A;
+        o << parse_indexed_into(A,text.data(),text.size());
+      }
+    }
+    catch (exception &e) {
+      o << "error: " << e.what();
+    }
+    return o.str();
+  }
+
+  void same(const char *what, const std::string &text) {
+    std::string expect = result(text,0);
+    for (int how=1; how<3; ++how) {
+      std::string got = result(text,how);
+      if (got == expect) continue;
+      fprintf(stderr,"failed: %s (%d, level %d)\n%s\nexpected:\n%s\ngot:\n%s\n",
+              what, how, int(scan::level()), text.c_str(), expect.c_str(),
+              got.c_str());
+      fail=true;
+    }
+  }
+
+  // strict-grammar text, right or wrong
+  std::string random_text(std::mt19937 &g) {
+    static const char *pieces[] = {
+      "{", "}", "[", "]", "=", "?", "<", ">", "a", "key_2", "x-y", "9",
+      "\"s p\"", "'q\"'", "`b`", "\"e\\\"sc\\\\\"", "# note\n", "#", "\n",
+      "\"", "'open", "\\", "a\\b", "\"", "{ k = v }", "[1 2 3]",
+      "{ a = [ { b = ? } ] }", "k = ", "\"long string that will run over "
+      "the edge of a block for sure\""
+    };
+    const size_t npieces = sizeof(pieces)/sizeof(pieces[0]);
+    std::string s;
+    unsigned len = g()%40;
+    for (unsigned i=0; i<len; ++i) {
+      s.append(g()%7, ' ');
+      if (g()%50==0) s += '\t';
+      s += pieces[g()%npieces];
+    }
+    if (g()%40==0) s.insert(g()%(s.size()+1), 1, '\0');
+    return s;
+  }
+}
+
+int main() {
+  ark a;
+  parser().parse_keyvals(a,
+    "a = 1 b = \"two words\" c = 'q\"uote' d = \"back\\\\slash\" e = ?\n"
+    "f = [ 1 [ 2 [] ] { g = {} h = [ ? ? ] } \"\" ]\n"
+    "long_key_that_is_not_short = { x = \"}]=\" y = \"a#b\" }\n"
+    "v = [ { k = 1 } { k = 2 } ] :colon-key = 3 _u = ``\n");
+  std::ostringstream printed;
+  printed << a;
+
+  const scan::level_t levels[] = { scan::Scalar, scan::SSE2, scan::AVX2 };
+  for (size_t l=0; l<sizeof(levels)/sizeof(levels[0]); ++l) {
+    if (scan::use(levels[l]) != levels[l]) continue;
+
+    // printer output, moved along by a byte at a time
+    for (unsigned shift=0; shift<130; ++shift)
+      same("printed", std::string(shift,' ') + printed.str());
+
+    const char *texts[] = {
+      "", "   ", "?", "x", "\"x\"", "[]", "{}", "  { a = 1 }  # trailing\n",
+      "{ a = 1 # comment\n b = 2 }", "{ a = 'x\\'y' }", "{a=1}{b=2}",
+      "{ a = 1 a = 2 }", "{ 9a = 1 }", "{ \"a\" = 1 }", "{ a = 1",
+      "[ 1 2", "{ a 1 }", "{ a = }", "[ } ]", "{ a = < 1 > }", "x y",
+      "\"unterminated", "\"esc\\", "[a\\b]", "{ b = 1 a = 2 }", "# only",
+      "[\n1\n2\n", "{\n a = 1\n b\n}", "[ ?x ]", "{ = 1 }", "]", "{ a = [ }"
+    };
+    for (size_t i=0; i<sizeof(texts)/sizeof(texts[0]); ++i)
+      same(texts[i],texts[i]);
+    same("NUL after", std::string("[1 2]\0junk",10));
+    same("NUL inside", std::string("[1\0 2]",6));
+    same("NUL in string", std::string("[\"a\0b\"]",7));
+
+    std::mt19937 g(16);
+    for (int i=0; i<3000; ++i) {
+      std::string s = random_text(g);
+      same("random", s);
+      same("random vector", "[" + s + "]");
+      same("random table", "{ k = [" + s + "] }");
+    }
+  }
+  scan::use(scan::best());
+
+  if (fail) exit(1);
+}
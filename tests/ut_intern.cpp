@@ -0,0 +1,164 @@
+#include "ut_common.hpp"
+#include <random>
+
+using namespace Ark;
+
+/* Interning must leave every value as it was, make equal values share
+   their nodes, and keep them apart once one is changed.  Random
+   keyvals, parsed with and without an interner, in one piece, on
+   threads, lazily and through the include cache, must give the same
+   tree, and go on giving the same one under the same changes. */
+
+namespace {
+  std::string random_value(std::mt19937 &g, int depth) {
+    switch (depth ? g()%4 : g()%2) {
+    case 0: return std::to_string(g()%4);
+    case 1: return "'q " + std::to_string(g()%3) + "'";
+    case 2: {
+      std::string s = "[";
+      for (unsigned n=g()%3; n; --n) s += " " + random_value(g,depth-1);
+      return s + " ]";
+    }
+    default: {
+      std::string s = "{";
+      for (unsigned n=g()%3; n; --n)
+        s += std::string(" ") + "abc"[g()%3] + " = " + random_value(g,depth-1);
+      return s + " }";
+    }
+    }
+  }
+
+  std::string random_keyvals(std::mt19937 &g, unsigned n) {
+    std::string s;
+    for (; n; --n) {
+      std::string k(1,"xyz"[g()%3]);
+      if (g()%2) k += std::string(".") + "abc"[g()%3];
+      if (g()%4==0) s += k + " !erase\n";
+      else s += k + " = " + random_value(g,3) + "\n";
+    }
+    return s;
+  }
+
+  // a random change, reached through non-const accessors
+  void change(std::mt19937 &g, ark &a) {
+    switch (a.kind()) {
+    case Table: {
+      table_t &t = a.table();
+      if (t.empty() || g()%3==0) { t[std::string(1,"abc"[g()%3])] = "new"; return; }
+      table_t::iterator i = t.begin();
+      std::advance(i,g()%t.size());
+      if (g()%4==0) t.erase(i);
+      else change(g,i->second);
+      return;
+    }
+    case Vector: {
+      vector_t &v = a.vector();
+      if (v.empty() || g()%3==0) v.emplace_back("new");
+      else change(g,v[g()%v.size()]);
+      return;
+    }
+    default:
+      a = "changed";
+    }
+  }
+}
+
+int main() {
+  scratch("ut_intern");
+
+  // interning a tree
+  {
+    ark a;
+    parser().parse_keyvals(a,"p = { t = [ {x=1 y=2} {x=1 y=2} {x=1 y=3} ] }"
+                           " q = { x=1 y=2 } r = 2");
+    const std::string before = show(a);
+    interner I;
+    size_t saved = I.intern(a);
+    check("interned tree",before,show(a));
+    const vector_t &t = a.get("p")->get("t")->vector();
+    if (!saved || &t[0].table()!=&t[1].table()
+        || &t[0].table()!=&a.get("q")->table()
+        || &t[0].table()==&t[2].table()
+        || t[0].get("y")->atom().c_str()!=a.get("r")->atom().c_str()) {
+      fprintf(stderr,"failed: equal values aren't shared (%zu saved)\n",
+              saved);
+      fail=true;
+    }
+    if (I.intern(a)) {
+      fprintf(stderr,"failed: interning twice saves more\n");
+      fail=true;
+    }
+    a.table()["q"].table()["x"] = "changed";
+    check("values sharing with a changed one",
+          "{t=[{x=\"1\"y=\"2\"}{x=\"1\"y=\"2\"}{x=\"1\"y=\"3\"}]}",
+          show(*a.get("p")));
+    ark b;
+    parser().parse_keyvals(b,"u = { x=1 y=3 }");
+    I.intern(b);
+    if (&b.get("u")->table()!=&a.get("p")->get("t")->vector()[2].table()) {
+      fprintf(stderr,"failed: a second tree doesn't share\n");
+      fail=true;
+    }
+    if (I.saved() < saved) {
+      fprintf(stderr,"failed: saved() is less than intern() said\n");
+      fail=true;
+    }
+  }
+
+  // random keyvals, parsed every way, then changed the same way
+  write("inc.ark", "inc = { a = 1 b = [1 2] }\n"
+                   "x = { a = 1 b = [1 2] }\n");
+  std::mt19937 g(25);
+  for (int i=0; i<3000; ++i) {
+    std::string text = random_keyvals(g,1+g()%8);
+    if (g()%4==0) text += "!include " + dir + "/inc.ark\n" + random_keyvals(g,2);
+    ark plain;
+    try {
+      parser().parse_keyvals(plain,text);
+    }
+    catch (exception &) {
+      continue;
+    }
+    write("top.ark", text);
+
+    interner I;
+    ark a, b, c;
+    parser().intern(&I).parse_keyvals(a,text);
+    parser().intern(&I).cache_includes(true).parse_file(b,path("top.ark"));
+    parser().intern(&I).lazy(true).parse_file(c,path("top.ark"));
+    check("interned parse of\n" + text,show(plain),show(a));
+    check("interned file parse of\n" + text,show(plain),show(b));
+    check("interned lazy parse of\n" + text,show(plain),show(c));
+
+    std::mt19937 h(g());
+    for (int k=0; k<5; ++k) {
+      std::mt19937 h1(h), h2(h);
+      change(h1,a);
+      change(h2,plain);
+      h.discard(1);
+      check("changed after interning\n" + text,show(plain),show(a));
+    }
+  }
+
+  // threaded parses are interned once they are applied
+  {
+    std::string text;
+    for (int i=0; text.size() < (3u<<20); ++i)
+      text += "t" + std::to_string(i%40) + "[+] = { kind = k" + std::to_string(i%7)
+        + " tags = [a b] }\n";
+    ark serial, threaded;
+    parser().parse_keyvals(serial,text);
+    interner I;
+    parser().intern(&I).threads(4).parse_keyvals(threaded,text);
+    check("threaded interned parse",show(serial),show(threaded));
+    const vector_t &v = threaded.get("t0")->vector();
+    if (v.size()<2 || &v[0].table()!=&v[7].table() || I.size()>200) {
+      fprintf(stderr,"failed: threaded parse isn't interned (%zu kept)\n",
+              I.size());
+      fail=true;
+    }
+  }
+
+  clean();
+  if (fail) exit(1);
+}
@@ -0,0 +1,118 @@
+#include "ut_common.hpp"
+#include <cstring>
+#include <thread>
+
+using namespace Ark;
+
+/* A lazy parse must give the same ark as an eager one once it is
+   looked at, however the file overrides, extends or erases values it
+   deferred, and however many threads touch it first.  Small values
+   are never deferred, so the inputs pad theirs out. */
+
+namespace {
+  // pads "{ " and "[ " so the values they open get deferred
+  void write_padded(const std::string &name, std::string text) {
+    const std::string pad(300,' ');
+    for (size_t i=0; (i=text.find_first_of("{[",i))!=std::string::npos; ++i)
+      if (i+1<text.size() && text[i+1]==' ') text.insert(i+1,pad);
+    write(name,text);
+  }
+
+  std::string run(const std::string &file, bool lazy) {
+    return outcome([&](ark &a) { parser().lazy(lazy).parse_file(a,path(file)); });
+  }
+
+  void same(const char *what, const std::string &file) {
+    check(what, run(file,false), run(file,true));
+  }
+}
+
+int main() {
+  scratch("ut_lazy");
+  make_dir("sub");
+
+  write_padded("top.ark",
+               "a = { x = 1 y = [1 [2 3] { z = '}' }] # ]\n"
+               "      f = !file data.dat inc = { !include sub/a.ark } }\n"
+               "a.x = 2  a.y[1][+] = 4  a.y[2] { w = \"]\" }\n"
+               "b = [ { p = 1 } { p = 2 } ]  b[0].p !erase  b[+] = 3\n"
+               "c = { gone = [1 2] }  c.gone !erase\n"
+               "d = { k = 1 }  d = plain\n"
+               "e = { k = 1 }  e { j = 2 }\n"
+               "g = [] h = {} i = ?\n");
+  write_padded("sub/a.ark", "q = { r = !file b.dat s = [ { t = 1 } ] }\n");
+  write_padded("bad.ark",   "ok = 1 v = { a = 1 b = }\n");
+  write_padded("unclosed.ark", "v = { a = [1 2 }\n");
+
+  same("overrides", "top.ark");
+  same("unclosed", "unclosed.ark");
+
+  // errors wait until the subtree is looked into
+  {
+    ark a;
+    parser().lazy(true).parse_file(a,path("bad.ark"));
+    if (a.get("v")->kind()!=Table) {
+      fprintf(stderr,"failed: deferred kind\n");
+      fail=true;
+    }
+    try {
+      a.xget("v.a");
+      fprintf(stderr,"failed: deferred error not thrown\n");
+      fail=true;
+    }
+    catch (exception &e) {
+      if (!strstr(e.what(),"bad.ark:1:")) {
+        fprintf(stderr,"failed: deferred error says\n%s\n",e.what());
+        fail=true;
+      }
+    }
+    ark b;
+    parser().lazy(true).parse_file(b,path("bad.ark"));
+    b.table().erase("v");
+    check("untouched error", "{ok=\"1\"}", show(b));
+  }
+
+  // lookups, copies and a reader see the same values
+  {
+    ark a;
+    parser().lazy(true).parse_file(a,path("top.ark"));
+    const atom_t *r = a.xget("a.inc.q.r") ? a.xget("a.inc.q.r")->get_atom()
+                                          : NULL;
+    check("xget", path("sub/b.dat"), r ? r->str() : "<none>");
+    ark c(a);
+    check("copy", run("top.ark",false), show(c));
+    reader R(a);
+    int x=0;
+    R.get("a.x").set(x);
+    if (x!=2) { fprintf(stderr,"failed: reader got %d\n",x); fail=true; }
+  }
+
+  // many threads touching the same deferred subtrees
+  {
+    std::ostringstream o;
+    for (unsigned i=0; i<200; ++i)
+      o << "t" << i << " = { v = [ { a = " << i << " } { b = [1 2 3] } ] }\n";
+    write_padded("wide.ark", o.str());
+    std::string expect = run("wide.ark",false);
+    for (int round=0; round<20; ++round) {
+      ark a;
+      parser().lazy(true).parse_file(a,path("wide.ark"));
+      std::vector<std::thread> threads;
+      for (int i=0; i<4; ++i)
+        threads.emplace_back([&a,i]() {
+            for (unsigned j=0; j<200; ++j) {
+              std::ostringstream k;
+              k << "t" << (j*(i+1))%200 << ".v[1].b[2]";
+              a.xget(k.str());
+            }
+          });
+      std::string printed = show(a);
+      for (size_t i=0; i<threads.size(); ++i) threads[i].join();
+      check("threads", expect, printed);
+    }
+  }
+
+  clean();
+
+  if (fail) exit(1);
+}
@@ -0,0 +1,130 @@
+#include "ut_common.hpp"
+#include <ark/source.hpp>
+#include <cerrno>
+
+using namespace Ark;
+
+/* Loading with several threads must give the same ark, or the same
+   error, as parsing each source in turn.  The files include each other
+   by relative and absolute paths, more than once, and override what
+   earlier files set. */
+
+namespace {
+  std::string run(const std::vector<std::string> &args, unsigned threads) {
+    return outcome([&](ark &a) {
+      std::vector<const char *> argv;
+      for (size_t i=0; i<args.size(); ++i) argv.push_back(args[i].c_str());
+      argvparse(a, argv.begin(), argv.end(), parser().threads(threads));
+    });
+  }
+}
+
+int main() {
+  scratch("ut_loader");
+  make_dir("sub");
+
+  write("base.ark",  "a = 1 b = [1 2] !include sub/one.ark\n"
+                     "t { !include sub/two.ark }\n");
+  write("sub/one.ark", "one = 1 b[+] = 3 !include two.ark\n");
+  write("sub/two.ark", "two = 2 a = override\n");
+  write("over.ark",  "b !erase t.two = again !include " + dir + "/sub/two.ark\n");
+  write("bad.ark",   "x = { unterminated\n");
+  write("badinc.ark", "y = 1 !include sub/missing.ark\n");
+  write("badidx.ark", "b[9] = 1\n");
+  write("empty.ark", "");
+  write("dirinc.ark", "d = 1 !include sub\n");
+  // more includes than a batch holds, several deep
+  {
+    std::ostringstream fan;
+    for (int i=0; i<300; ++i) {
+      std::string name = "sub/f" + std::to_string(i) + ".ark";
+      write(name, "f" + std::to_string(i) + " = " + std::to_string(i)
+            + (i%3 ? "" : " !include two.ark") + " !include ../empty.ark\n");
+      fan << "!include " << name << "\n";
+    }
+    write("fan.ark", fan.str());
+  }
+
+  std::vector<std::vector<std::string> > cases = {
+    { "--include", path("base.ark") },
+    { "--include", path("base.ark"), "--cfg", "c = cfg b[+] = 4 c = cfg2",
+      "--include", path("over.ark"), "--include=" + path("base.ark") },
+    { "--cfg", "!include " + path("sub/one.ark"), "--cfg", "q = 1" },
+    { "--include", path("base.ark"), "--include", path("bad.ark") },
+    { "--include", path("base.ark"), "--include", path("badinc.ark") },
+    { "--include", path("badidx.ark") },
+    { "--include", path("missing.ark"), "--include", path("base.ark") },
+    { "--cfg", "x = { unterminated" },
+    { "--include", path("dirinc.ark") },
+    { "--include", path("empty.ark"), "--include", path("fan.ark") },
+  };
+
+  for (size_t k=0; k<cases.size(); ++k) {
+    std::string serial = run(cases[k],1);
+    for (unsigned nt=2; nt<=4; nt+=2) {
+      std::string threaded = run(cases[k],nt);
+      if (serial == threaded) continue;
+      fail=true;
+      fprintf(stderr,"case %zu failed:\nserial:\n%s\n%u threads:\n%s\n",
+              k, serial.c_str(), nt, threaded.c_str());
+    }
+  }
+
+#ifdef __linux__
+  // files that say they are empty but aren't are read all the same
+  {
+    file_source in("/proc/sys/kernel/ostype");
+    if (std::string(in.data(),in.size()).compare(0,5,"Linux")!=0) {
+      fprintf(stderr,"file_source: /proc/sys/kernel/ostype read as \"%.*s\"\n",
+              int(in.size()), in.data());
+      fail=true;
+    }
+  }
+#endif
+
+  // a batch reads what file_source reads, whatever order it comes in
+  {
+    file_batch b(8);
+    std::vector<std::string> paths;
+    for (int i=0; i<300; i+=7)
+      paths.push_back(path("sub/f" + std::to_string(i) + ".ark"));
+    paths.push_back(path("empty.ark"));
+#ifdef __linux__
+    paths.push_back("/proc/sys/kernel/ostype");
+#endif
+    paths.push_back(path("missing.ark"));
+    paths.push_back(path("sub"));
+    std::vector<int> seen(paths.size());
+    for (size_t i=0; i<paths.size(); ++i) b.add(paths[i],&seen[i]);
+    if (b.ok() && b.pending()!=paths.size()) {
+      fprintf(stderr,"batch: %zu pending\n", b.pending());
+      fail=true;
+    }
+    file_batch::result r;
+    while (b.next(r)) {
+      size_t i = (int *)r.tag - &seen[0];
+      ++seen[i];
+      int expect = i==paths.size()-2 ? ENOENT : i==paths.size()-1 ? EINVAL : 0;
+      std::string got = r.contents;
+      if (!expect) {
+        file_source in(paths[i]);
+        got = std::string(in.data(),in.size()) == r.contents ? "" : r.contents;
+      }
+      if (r.error!=expect || !got.empty()) {
+        fprintf(stderr,"batch: %s read as %d \"%s\"\n",
+                paths[i].c_str(), r.error, got.c_str());
+        fail=true;
+      }
+    }
+    for (size_t i=0; i<paths.size(); ++i)
+      if (seen[i]!=(b.ok() ? 1 : 0)) {
+        fprintf(stderr,"batch: %s handed back %d times\n",
+                paths[i].c_str(), seen[i]);
+        fail=true;
+      }
+  }
+
+  clean();
+
+  if (fail) exit(1);
+}
@@ -0,0 +1,220 @@
+#include "ut_common.hpp"
+#include <random>
+
+using namespace Ark;
+
+/* Patched text must parse to what the text does with the keys set at
+   its end, and keep everything but the values replaced as it was.
+   Random keyvals, with overrides, enclosures, erasures and vectors,
+   check the first; the cases below check the second. */
+
+namespace {
+  std::string parsed(const std::string &text) {
+    std::ostringstream o;
+    try {
+      ark a;
+      parser().parse_keyvals(a,text);
+      o << a;
+    }
+    catch (exception &e) {
+      o << "error: " << e.what();
+    }
+    return o.str();
+  }
+
+  ark value(const std::string &text) {
+    ark a;
+    parser().parse_keyvals(a,"v = " + text);
+    return a.table()[Ark::key_t("v")];
+  }
+
+  typedef std::vector<std::pair<std::string,std::string> > sets;
+
+  std::string patched(const std::string &text, const sets &s,
+                      size_t *in_place=NULL) {
+    patch P;
+    for (size_t i=0; i<s.size(); ++i) P.set(s[i].first,value(s[i].second));
+    std::ostringstream o;
+    size_t n = P.apply(o,text.data(),text.size(),"test.ark");
+    if (in_place) *in_place = n;
+    return o.str();
+  }
+
+  // patched text parses as the text with the keys set at its end
+  void same(const std::string &text, const sets &s) {
+    std::string tail = text;
+    for (size_t i=0; i<s.size(); ++i)
+      tail += "\n" + s[i].first + " = " + s[i].second + "\n";
+    std::string expect = parsed(tail);
+    if (expect.compare(0,6,"error:")==0) return;
+    std::string got;
+    try {
+      got = parsed(patched(text,s));
+    }
+    catch (exception &e) {
+      got = std::string("error: ") + e.what();
+    }
+    if (got == expect) return;
+    fprintf(stderr,"failed:\n%s\nsetting:\n", text.c_str());
+    for (size_t i=0; i<s.size(); ++i)
+      fprintf(stderr,"  %s = %s\n", s[i].first.c_str(), s[i].second.c_str());
+    fprintf(stderr,"expected:\n%s\ngot:\n%s\n", expect.c_str(), got.c_str());
+    fail=true;
+  }
+
+  void check(const char *what, const std::string &text, const sets &s,
+             const std::string &expect, size_t in_place) {
+    same(text,s);
+    size_t n;
+    std::string got = patched(text,s,&n);
+    if (got == expect && n == in_place) return;
+    fprintf(stderr,"failed: %s\nexpected (%zu in place):\n%s\n"
+            "got (%zu in place):\n%s\n",
+            what, in_place, expect.c_str(), n, got.c_str());
+    fail=true;
+  }
+
+  // a superkey over a few keys, with "[+]" steps if plus
+  std::string random_path(std::mt19937 &g, bool plus) {
+    static const char *keys[] = { "a", "b", "c" };
+    std::string s = keys[g()%3];
+    for (unsigned n=g()%3; n; --n)
+      switch (g()%4) {
+      case 0: s += "[" + std::to_string(g()%3) + "]"; break;
+      case 1: if (plus) { s += "[+]"; break; } // fallthrough
+      default: s += std::string(".") + keys[g()%3]; break;
+      }
+    return s;
+  }
+
+  std::string random_value(std::mt19937 &g, int depth);
+
+  // keyvals with overrides, enclosures and erasures
+  std::string random_keyvals(std::mt19937 &g, int depth, unsigned n) {
+    std::string s;
+    for (; n; --n) {
+      std::string p = random_path(g,true);
+      switch (depth ? g()%6 : g()%4) {
+      case 0: case 1: s += p + " = " + random_value(g,depth) + "\n"; break;
+      case 2: s += p + " !erase\n"; break;
+      case 3: s += "# " + p + "\n" + p + "=" + random_value(g,0) + " "; break;
+      default:
+        s += p + " { " + random_keyvals(g,depth-1,g()%3) + "}\n"; break;
+      }
+    }
+    return s;
+  }
+
+  std::string random_value(std::mt19937 &g, int depth) {
+    switch (depth ? g()%5 : g()%2) {
+    case 0: return std::to_string(g()%100);
+    case 1: return "'q " + std::to_string(g()%10) + "'";
+    case 2: return "?";
+    case 3: {
+      std::string s = "[";
+      for (unsigned n=g()%4; n; --n) s += " " + random_value(g,depth-1);
+      return s + " ]";
+    }
+    default:
+      return "{ " + random_keyvals(g,depth-1,g()%3) + "}";
+    }
+  }
+}
+
+int main() {
+  // in place, layout kept
+  check("plain",
+        "# settings\nmdsim {\n  temp = 300   # K\n  steps = 1000\n}\n",
+        {{"mdsim.temp","310"}},
+        "# settings\nmdsim {\n  temp = \"310\"   # K\n  steps = 1000\n}\n", 1);
+  check("last of several",
+        "a.b = 1\na { b = 2 }\nc = 3\n", {{"a.b","4"}},
+        "a.b = 1\na { b = \"4\" }\nc = 3\n", 1);
+  check("inside a value",
+        "a = { b = [1 {c = 2} 3] }\n", {{"a.b[1].c","'x y'"}, {"a.b[2]","?"}},
+        "a = { b = [1 {c = \"x y\"} ?] }\n", 2);
+  check("whole table",
+        "a = { b = 1 }\nd = 2\n", {{"a","{c=5}"}},
+        "a = {c=\"5\"}\nd = 2\n", 1);
+  check("quoted and !file",
+        "s = 'a \\' b'\nf = !file x.ark\n", {{"s","t"}, {"f","u"}},
+        "s = \"t\"\nf = \"u\"\n", 2);
+
+  // appended
+  check("missing", "a = 1", {{"b.c","2"}}, "a = 1\nb.c = \"2\"\n", 0);
+  check("changed later",
+        "a = { b = 1 }\na.c = 2\n", {{"a","3"}},
+        "a = { b = 1 }\na.c = 2\na = \"3\"\n", 0);
+  check("erased", "a.b = 1\na !erase\n", {{"a.b","2"}},
+        "a.b = 1\na !erase\na.b = \"2\"\n", 0);
+  check("element moved",
+        "a = [1 2 3]\na[0] !erase\n", {{"a[1]","9"}},
+        "a = [1 2 3]\na[0] !erase\na[1] = \"9\"\n", 0);
+  check("included after",
+        "a.b = 1\na { !include more.ark }\n", {{"a.b","2"}},
+        "a.b = 1\na { !include more.ark }\na.b = \"2\"\n", 0);
+  check("included elsewhere",
+        "a.b = 1\nz { !include more.ark }\n", {{"a.b","2"}},
+        "a.b = \"2\"\nz { !include more.ark }\n", 1);
+  check("overlapping",
+        "a = { b = 1 }\n", {{"a.b","2"}, {"a","{c=1}"}},
+        "a = { b = 1 }\na.b = \"2\"\na = {c=\"1\"}\n", 0);
+  check("after an appended one",
+        "a = { b = 1 }\nx = 0\n", {{"a","?"}, {"a.b","5"}, {"x","1"}},
+        "a = { b = 1 }\nx = \"1\"\na = ?\na.b = \"5\"\n", 1);
+
+  // errors
+  try {
+    patched("a = { b", {{"a","1"}});
+    fprintf(stderr,"failed: no error for bad text\n");
+    fail=true;
+  }
+  catch (exception &e) {
+    if (std::string(e.what()).find("test.ark:1")==std::string::npos) {
+      fprintf(stderr,"failed: error says %s\n",e.what());
+      fail=true;
+    }
+  }
+  try {
+    patch().set("a[+]",ark());
+    fprintf(stderr,"failed: [+] is no key to set\n");
+    fail=true;
+  }
+  catch (exception &e) {
+    check("[+] says so", std::string(e.what()).find("'[+]'")!=std::string::npos);
+  }
+
+  // random keyvals
+  std::mt19937 g(22);
+  for (int i=0; i<20000; ++i) {
+    sets s;
+    for (unsigned n=1+g()%3; n; --n)
+      s.push_back(std::make_pair(random_path(g,false),random_value(g,2)));
+    // mostly with the first key set somewhere in the text
+    std::string text = random_keyvals(g,3,g()%4);
+    if (g()%4) text += s[0].first + " = " + random_value(g,2) + "\n";
+    text += random_keyvals(g,3,g()%3);
+    same(text,s);
+  }
+
+  // files, replaced whole
+  {
+    scratch("ut_patch");
+    std::string base = path("base.ark"), out = path("out.ark");
+    write("base.ark", "a = 1\nb { c = 2 }\n");
+    chmod(base.c_str(),0644);
+    ark v = value("3");
+    size_t n = patch().set("b.c",v).apply_file(base,out);
+    n += patch().set("a",v).apply_file(out);
+    ark a;
+    parser().parse_file(a,out);
+    struct stat st;
+    stat(out.c_str(),&st);
+    check("files", "{a=\"3\"b={c=\"3\"}}", show(a));
+    check("file mode kept", (st.st_mode & 0777)==0644);
+    check("two values set", n==2);
+    clean();
+  }
+
+  if (fail) exit(1);
+}
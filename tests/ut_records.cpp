@@ -0,0 +1,154 @@
+#include "ut_common.hpp"
+#include <random>
+
+using namespace Ark;
+
+/* Arks written to a stream must read back as they were, one by one
+   or in batches on any number of threads, and a stream with bad
+   records in it must give the same records and errors either way. */
+
+namespace {
+  // an ark of any kind, with awkward strings
+  ark random_ark(std::mt19937 &g, int depth) {
+    static const char *atoms[] = {
+      "1", "x", "two words", "line\nbreak", "12 {a=1}\n34 ", "}", "\"",
+      "\\", "", "0.5", "a#b", "\n"
+    };
+    ark a;
+    switch (depth ? g()%4 : g()%2) {
+    case 0:
+      break;
+    case 1:
+      a = atoms[g()%(sizeof(atoms)/sizeof(atoms[0]))];
+      break;
+    case 2:
+      a.be(Vector);
+      for (unsigned n=g()%4; n; --n) a.vector().push_back(random_ark(g,depth-1));
+      break;
+    default:
+      a.be(Table);
+      for (unsigned n=g()%4; n; --n)
+        a.table()[Ark::key_t("k" + std::to_string(g()%5))] = random_ark(g,depth-1);
+      break;
+    }
+    return a;
+  }
+
+  // what a reader gives, records and errors, one per line
+  std::string all(const std::string &stream, size_t batch, unsigned threads) {
+    std::istringstream in(stream);
+    record_reader r(in,"log.arks");
+    std::ostringstream o;
+    std::string last;
+    for (;;) {
+      try {
+        if (!batch) {
+          ark a;
+          if (!r.next(a)) break;
+          o << a << "\n";
+        }
+        else {
+          std::vector<ark> v;
+          if (!r.next(v,batch,threads)) break;
+          for (size_t i=0; i<v.size(); ++i) o << v[i] << "\n";
+        }
+      }
+      catch (exception &e) {
+        // a stream that can't be read any further keeps saying why
+        if (e.what()==last) break;
+        last = e.what();
+        o << "error: " << last << "\n";
+      }
+    }
+    return o.str();
+  }
+
+  void same(const char *what, const std::string &stream,
+            const std::string &expect) {
+    const size_t batches[] = { 0, 1, 2, 3, 100 };
+    const unsigned threads[] = { 1, 2, 8 };
+    for (size_t i=0; i<sizeof(batches)/sizeof(batches[0]); ++i)
+      for (size_t j=0; j<sizeof(threads)/sizeof(threads[0]); ++j) {
+        std::string got = all(stream,batches[i],threads[j]);
+        if (got == expect) continue;
+        fprintf(stderr,"failed: %s (batch %zu, %u threads)\n"
+                "expected:\n%s\ngot:\n%s\n",
+                what, batches[i], threads[j], expect.c_str(), got.c_str());
+        fail=true;
+      }
+  }
+}
+
+int main() {
+  std::mt19937 g(18);
+
+  // round trips, in each printer style
+  for (int ws=0; ws<2; ++ws) {
+    std::ostringstream o, expect;
+    printer P;
+    P.whitespace(ws).no_delim(true).flatten(true);
+    record_writer w(o,P);
+    for (int i=0; i<200; ++i) {
+      ark a = random_ark(g,4);
+      w.write(a);
+      expect << a << "\n";
+    }
+    same(ws ? "whitespace" : "compact", o.str(), expect.str());
+    if (w.written()!=200) {
+      fprintf(stderr,"failed: written() is %zu\n",w.written());
+      fail=true;
+    }
+  }
+
+  // streams concatenate
+  {
+    std::ostringstream o1, o2;
+    ark a, b;
+    a.be(Table);
+    a.table()[Ark::key_t("step")] = "1";
+    b.be(Table);
+    b.table()[Ark::key_t("step")] = "2";
+    record_writer(o1).write(a);
+    record_writer(o2).write(b).write(a);
+    same("concatenated", o1.str()+o2.str(),
+         show(a) + "\n" + show(b) + "\n" + show(a) + "\n");
+  }
+
+  // records longer than a read are read whole
+  {
+    std::ostringstream o;
+    ark a(std::string(200000,'x'));
+    record_writer(o).write(a).write(a);
+    same("big", o.str(), show(a) + "\n" + show(a) + "\n");
+  }
+
+  // a bad record is an error in its place; the rest still read
+  same("bad record", "5 {a=1}\n5 {a=1 \n5 {b=2}\n2 []\n",
+       "{a=\"1\"}\n"
+       "error: expecting a key symbol\n"
+       "input error at line=1,col=6:<end of file>\n"
+       "record 2 of log.arks at byte 8\n"
+       "{b=\"2\"}\n[]\n");
+  same("two bad", "1 x\n3 a b\n3 c d\n2 []\n",
+       "\"x\"\n"
+       "error: extra stuff after the value\n"
+       "input error at line=1,col=3:b\n"
+       "record 2 of log.arks at byte 4\n"
+       "error: extra stuff after the value\n"
+       "input error at line=1,col=3:d\n"
+       "record 3 of log.arks at byte 10\n"
+       "[]\n");
+
+  // and a stream that isn't one stops it
+  same("cut short", "2 []\n9 {a=1}\n",
+       "[]\nerror: record cut short\nrecord 2 of log.arks at byte 5\n");
+  same("too long", "9999999999999999999 {a=1}\n",
+       "error: record cut short\nrecord 1 of log.arks at byte 0\n");
+  same("long", "2 []\n99999999999 {a=1}\n",
+       "[]\nerror: record cut short\nrecord 2 of log.arks at byte 5\n");
+  same("no length", "2 []\n{a=1}\n",
+       "[]\nerror: bad record length\nrecord 2 of log.arks at byte 5\n");
+  same("empty", "", "");
+
+  if (fail) exit(1);
+}
@@ -0,0 +1,86 @@
+#include "ut_common.hpp"
+
+using namespace Ark;
+
+/* A parse that selects some superkeys must give the same xget() for
+   each of them as a full parse, however later statements override,
+   erase, extend or include over them. */
+
+namespace {
+  std::string lookup(const ark &a, const std::string &key) {
+    const ark *v = a.xget(key);
+    if (!v) return "<missing>";
+    std::ostringstream o;
+    o << *v;
+    return o.str();
+  }
+
+  void same(const std::string &file, const std::vector<std::string> &keys,
+            const std::string &start="") {
+    ark full, part;
+    parser().parse_keyvals(full,start);
+    parser().parse_file(full,dir + "/" + file);
+    parser P;
+    P.select(keys);
+    P.parse_keyvals(part,start);
+    P.parse_file(part,dir + "/" + file);
+    for (size_t i=0; i<keys.size(); ++i) {
+      std::string f = lookup(full,keys[i]), p = lookup(part,keys[i]);
+      if (f == p) continue;
+      fprintf(stderr,"failed: %s %s\nfull:\n%s\nselected:\n%s\n",
+              file.c_str(), keys[i].c_str(), f.c_str(), p.c_str());
+      fail=true;
+    }
+  }
+}
+
+int main() {
+  scratch("ut_select");
+  make_dir("sub");
+
+  write("top.ark",
+        "a = { b = 1 c = [1 2 { d = 3 }] e = { f = 'x]' } }\n"
+        "noise = { a = 5 b = [ { a = 6 } ] } # a.b = 7\n"
+        "a.b = 2  a.c[+] = 4  a.c[2].d = 5\n"
+        "g { h = 1 !include sub/g.ark }\n"
+        "k = [1 2]  k = { l = 1 }  k.m = 2  k.l !erase\n"
+        "n = { o = 1 }  n[0] = 1\n"
+        "p = { q = 1 }  p !erase\n"
+        "s = `a` s2 = ? s3 = !file sub/x.dat\n"
+        "!include sub/tail.ark\n");
+  write("sub/g.ark", "h = 2 i = { j = !file y.dat } a = 9\n");
+  write("sub/tail.ark", "a.e.f = tail r.t = [ 1 ]\n");
+
+  const char *keys[] = { "a", "a.b", "a.c", "a.c[2].d", "a.e.f", "g.h",
+                         "g.i.j", "k", "k.l", "k.m", "n", "n.o", "p",
+                         "p.q", "r.t[0]", "s", "s2", "s3", "missing.key",
+                         "noise.b[0].a" };
+  const size_t nkeys = sizeof(keys)/sizeof(keys[0]);
+  for (size_t i=0; i<nkeys; ++i)
+    same("top.ark", std::vector<std::string>(1,keys[i]));
+  same("top.ark", std::vector<std::string>(keys,keys+nkeys));
+  same("top.ark", std::vector<std::string>(1,"a.b"), "a = 1 z = 2");
+
+  // nothing after the last mention of a is parsed
+  write("late.ark", "a = { b = 1 } c = { d = 2 }\nzzz = { unterminated\n");
+  {
+    ark a;
+    parser P;
+    P.select(std::vector<std::string>(1,"a.b"));
+    try {
+      P.parse_file(a,path("late.ark"));
+      if (lookup(a,"a.b")!="\"1\"" || a.get("c")) {
+        fprintf(stderr,"failed: early stop kept\n%s\n",lookup(a,"").c_str());
+        fail=true;
+      }
+    }
+    catch (exception &e) {
+      fprintf(stderr,"failed: early stop threw\n%s\n",e.what());
+      fail=true;
+    }
+  }
+
+  clean();
+
+  if (fail) exit(1);
+}
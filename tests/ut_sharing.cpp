@@ -0,0 +1,169 @@
+#include "ut_common.hpp"
+#include <random>
+#include <thread>
+
+using namespace Ark;
+
+/* Copies share their subtrees until one of them is changed, and a
+   change to one must never show in another.  Random snapshots, copied
+   from each other and changed through the non-const accessors, are
+   checked against trees built separately by the same steps; threads
+   change copies of one shared tree at once. */
+
+namespace {
+  void expect(const ark &a, const std::string &s, const char *what) {
+    if (show(a)==s) return;
+    fprintf(stderr,"failed: %s: %s, expected %s\n", what, show(a).c_str(),
+            s.c_str());
+    fail=true;
+  }
+
+  // a random change, reached through non-const accessors
+  void change(std::mt19937 &g, ark &a, int depth) {
+    switch (a.kind()) {
+    case Table: {
+      table_t &t = a.table();
+      std::string k(1,"abc"[g()%3]);
+      if (depth && t.count(k) && g()%2) { change(g,t[k],depth-1); return; }
+      switch (g()%4) {
+      case 0: t.erase(k); break;
+      case 1: t[k] = std::to_string(g()%100); break;
+      case 2: t[k].be(Table); break;
+      default: t[k].be(Vector); break;
+      }
+      return;
+    }
+    case Vector: {
+      vector_t &v = a.vector();
+      if (depth && !v.empty() && g()%2) { change(g,v[g()%v.size()],depth-1); return; }
+      switch (g()%4) {
+      case 0: if (!v.empty()) v.pop_back(); break;
+      case 1: v.emplace_back(std::to_string(g()%100)); break;
+      case 2: v.emplace_back(Table); break;
+      default: v.emplace_back(Vector); break;
+      }
+      return;
+    }
+    case Atom:
+      a.atom() = atom_t("x" + std::to_string(g()%10));
+      return;
+    default:
+      a.be(Table);
+    }
+  }
+}
+
+int main() {
+  ark a;
+  parser().parse_keyvals(a,"t = { x = 1 y = [2 3] } v = [ { z = 4 } 5 ] s = word");
+  const std::string before = show(a);
+
+  // a copy shares until changed
+  {
+    ark b(a);
+    const ark &ca = a, &cb = b;
+    if (&ca.table()!=&cb.table()) {
+      fprintf(stderr,"failed: a copy doesn't share its table\n");
+      fail=true;
+    }
+    b.table()["t"].table()["x"] = "changed";
+    expect(a,before,"original after changing a copy");
+    if (&ca.table()==&cb.table()
+        || &ca.get("v")->vector()!=&cb.get("v")->vector()) {
+      fprintf(stderr,"failed: changing t copies more or less than it should\n");
+      fail=true;
+    }
+    ark c = a;
+    c.table()["v"].vector()[0].table()["z"] = "changed";
+    c.table()["s"].atom() = atom_t("changed");
+    expect(a,before,"original after changing a vector in a copy");
+    a.table()["t"].table()["y"].vector().emplace_back("9");
+    expect(c,"{s=\"changed\"t={x=\"1\"y=[\"2\"\"3\"]}v=[{z=\"changed\"}\"5\"]}",
+           "copy after changing the original");
+    a = ark(b);
+    expect(a,show(b),"assigned copy");
+  }
+
+  // merging from a copy leaves what it shares alone
+  {
+    const std::string was = show(a);
+    ark b(a), m;
+    parser().parse_keyvals(m,"t = { w = 0 } u = 1");
+    const ark &ca = a, &cb = b;
+    m.merge(std::move(b));
+    if (&ca.table()!=&cb.table()
+        || &m.get("v")->vector()!=&ca.get("v")->vector()) {
+      fprintf(stderr,"failed: merging from a copy copies it\n");
+      fail=true;
+    }
+    expect(a,was,"original after merging from its copy");
+    expect(m,"{s=\"word\"t={w=\"0\"x=\"changed\"y=[\"2\"\"3\"]}u=\"1\""
+           "v=[{z=\"4\"}\"5\"]}","merged from a copy");
+  }
+
+  // copies of arena trees go to the heap and outlive the arena
+  {
+    ark b;
+    {
+      arena A;
+      const ark &r = parser().parse_keyvals_into(A,"t = { x = [1 2] long = '"
+                                                 + std::string(100,'q') + "' }");
+      b = r;
+      ark c(b);
+      c.table()["t"].table()["x"].vector().emplace_back("3");
+    }
+    expect(b,"{t={long=\"" + std::string(100,'q') + "\"x=[\"1\"\"2\"]}}",
+           "copy of an arena tree");
+  }
+
+  // random changes to snapshots copied from each other
+  std::mt19937 g(24);
+  for (int round=0; round<200; ++round) {
+    std::vector<ark> snaps(6), built(6);
+    for (int step=0; step<200; ++step) {
+      size_t i = g()%snaps.size(), j = g()%snaps.size();
+      if (g()%3==0) {
+        snaps[j] = snaps[i];
+        built[j] = parse(show(built[i])); // a copy sharing nothing
+      }
+      else {
+        std::mt19937 h(g());
+        std::mt19937 k(h);
+        change(h,snaps[i],4);
+        change(k,built[i],4);
+      }
+    }
+    for (size_t i=0; i<snaps.size(); ++i)
+      expect(snaps[i],show(built[i]),"snapshot");
+  }
+
+  // threads changing copies of one tree
+  {
+    ark big;
+    for (int i=0; i<200; ++i)
+      parser().parse_keyvals(big,"rows[+] = { a = " + std::to_string(i)
+                             + " b = [x y z] }");
+    const std::string whole = show(big);
+    std::vector<std::string> got(4);
+    std::vector<std::thread> ts;
+    for (size_t n=0; n<got.size(); ++n)
+      ts.emplace_back([&,n] {
+          for (int k=0; k<200; ++k) {
+            ark c(big);
+            c.table()["rows"].vector()[n].table()["a"] = "mine";
+            ark d(c);
+            d.table()["rows"].vector()[n+1].table()["b"].vector().clear();
+            if (k==199) got[n] = show(c.get("rows")->vector()[n]);
+          }
+        });
+    for (size_t n=0; n<ts.size(); ++n) ts[n].join();
+    expect(big,whole,"tree copied by threads");
+    for (size_t n=0; n<got.size(); ++n)
+      if (got[n]!="{a=\"mine\"b=[\"x\"\"y\"\"z\"]}") {
+        fprintf(stderr,"failed: thread %zu got %s\n", n, got[n].c_str());
+        fail=true;
+      }
+  }
+
+  if (fail) exit(1);
+}
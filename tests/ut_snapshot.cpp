@@ -0,0 +1,100 @@
+#include "ut_common.hpp"
+#include <dirent.h>
+#include <sys/time.h>
+
+using namespace Ark;
+
+/* Parses through a snapshot directory must give the same ark, or the
+   same error, as plain parses, however the files change between them,
+   and whatever state the snapshots are in. */
+
+namespace {
+  std::string cache;
+  std::vector<std::string> listing(const std::string &d) {
+    std::vector<std::string> names;
+    if (DIR *p = opendir(d.c_str())) {
+      while (struct dirent *e = readdir(p))
+        if (e->d_name[0]!='.') names.push_back(d + "/" + e->d_name);
+      closedir(p);
+    }
+    return names;
+  }
+
+  std::string run(const std::string &file, const std::string &start,
+                  bool snap) {
+    return outcome([&](ark &a) {
+      parser P;
+      if (snap) P.cache_dir(cache);
+      P.parse_keyvals(a,start);
+      P.parse_file(a,path(file));
+    });
+  }
+
+  void same(const char *what, const std::string &file,
+            const std::string &start="") {
+    std::string plain = run(file,start,false);
+    for (int i=0; i<2; ++i) {
+      std::string snap = run(file,start,true);
+      if (snap == plain) continue;
+      fprintf(stderr,"failed: %s\nplain:\n%s\nsnapshot:\n%s\n",
+              what, plain.c_str(), snap.c_str());
+      fail=true;
+    }
+  }
+}
+
+int main() {
+  scratch("ut_snapshot");
+  cache = path("cache/deeper"); // made, parents and all, when first used
+  make_dir("sub");
+
+  write("top.ark",   "a = 1 v = [1 2] !include sub/a.ark\n"
+                     "t { !include " + dir + "/sub/b.ark }\n");
+  write("sub/a.ark", "a = 2 v[+] = 3 f = !file b.ark !include b.ark\n");
+  write("sub/b.ark", "x = 1 v[0] !erase\n");
+  write("bad.ark",   "!include sub/a.ark y = { unterminated\n");
+  write("badinc.ark", "!include sub/missing.ark\n");
+
+  same("cold and warm", "top.ark");
+  if (listing(cache).empty()) {
+    fprintf(stderr,"failed: no snapshots written\n");
+    fail=true;
+  }
+  same("into a table", "top.ark", "v = [9] t.y = 2");
+  same("parse error", "bad.ark");
+  same("include error", "badinc.ark");
+
+  // an include changes, keeping its size
+  write("sub/b.ark", "x = 2 v[0] !erase\n");
+  same("changed include", "top.ark");
+
+  // one included from inside a value changes, merged or not
+  write("value.ark", "x = { !include sub/b.ark }\ny = [ { !include sub/b.ark } ]\n");
+  same("value include", "value.ark");
+  same("value include into a table", "value.ark", "q = 1");
+  write("sub/b.ark", "x = 3 v[0] !erase\n");
+  same("changed value include", "value.ark");
+  same("changed value include into a table", "value.ark", "q = 1");
+
+  // touched but unchanged
+  struct timeval tv[2] = { { 1000000000, 0 }, { 1000000000, 0 } };
+  utimes(path("sub/a.ark").c_str(), tv);
+  same("touched include", "top.ark");
+
+  // an include appears
+  write("badinc.ark", "!include sub/b.ark\n");
+  same("fixed include", "badinc.ark");
+
+  // damaged snapshots are ignored
+  std::vector<std::string> snaps = listing(cache);
+  for (size_t i=0; i<snaps.size(); ++i) {
+    std::ostringstream o;
+    o << std::ifstream(snaps[i]).rdbuf();
+    std::ofstream(snaps[i]) << o.str().substr(0, o.str().size()/2);
+  }
+  same("damaged snapshots", "top.ark");
+
+  clean();
+
+  if (fail) exit(1);
+}
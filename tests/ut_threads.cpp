@@ -0,0 +1,84 @@
+#include "ut_common.hpp"
+#include <cstring>
+
+using namespace Ark;
+
+/* A threaded parse must give the same ark, or the same error, as a
+   serial one.  The inputs are large enough to be split, and their
+   later blocks override, erase and extend what earlier blocks set.
+   Flat inputs, with no bracketed values to split after, are split at
+   line ends, which strings and comments must not fool. */
+
+namespace {
+  std::string block(unsigned i) {
+    std::ostringstream o;
+    o << "t" << i%50 << " = { name = \"block " << i << " }{\" rows = [\n";
+    for (unsigned j=0; j<100; ++j)
+      o << "  { a = " << j << " b = 'x]' c = [1 2 3] } # ] }\n";
+    o << "] }\n"
+      << "t" << i%50 << ".rows[0].a = changed\n"
+      << "log[+] = " << i << "\n"
+      << "acc { k" << i%11 << " = " << i << " }\n"
+      << "acc.k" << (i+3)%11 << " !erase\n"
+      << "s" << i%7 << " = [ " << i << " ]\n"
+      << "s" << i%7 << "[+] = more\n";
+    return o.str();
+  }
+
+  std::string flat(unsigned i) {
+    std::ostringstream o;
+    for (unsigned j=0; j<100; ++j)
+      o << "f" << i%50 << ".g" << j%13 << ".h" << j << " = " << i+j << "\n";
+    o << "f" << i%50 << ".memo = \"line one\nk" << i << " = not a key\"\n"
+      << "f" << i%50 << ".g1 = # a comment\nlater\n"
+      << "f" << i%50 << ".g2 =\n  " << i << " f" << i%50 << ".g3 = 'q'\n"
+      << "log[+] = " << i << " # log\n"
+      << "f" << (i+3)%50 << ".g4 !erase\n";
+    return o.str();
+  }
+
+  std::string run(const std::string &text, unsigned threads) {
+    return outcome([&](ark &a) {
+      parser().threads(threads).parse_keyvals(a.be(Table),"before = 1");
+      parser().threads(threads).parse_keyvals(a,text);
+    });
+  }
+}
+
+int main() {
+  // two halves, with each of the middles below put between them, of
+  // blocks and then of flat keyvals
+  std::string heads[2], tails[2];
+  unsigned i=0;
+  while (heads[0].size() < (3u<<19)) heads[0] += block(i++);
+  while (tails[0].size() < (3u<<19)) tails[0] += block(i++);
+  while (heads[1].size() < (3u<<19)) heads[1] += flat(i++);
+  while (tails[1].size() < (3u<<19)) tails[1] += flat(i++);
+
+  const char *middles[] = {
+    "",
+    "log[1000000] = 1\n",         // fails while applying
+    "t1 = { unterminated = \"\n", // fails while parsing
+    "} x = 1\n",                  // unbalanced
+    "!include /nonexistent.ark\n",
+  };
+
+  const unsigned nmiddles = sizeof(middles)/sizeof(middles[0]);
+
+  for (unsigned k=0; k<2*nmiddles; ++k) {
+    unsigned h = k/nmiddles;
+    const char *middle = middles[k%nmiddles];
+    std::string in = heads[h] + middle + tails[h];
+
+    std::string serial = run(in,1);
+    std::string threaded = run(in,4);
+    fprintf(stderr,"testing: %s \"%.*s\"\n", h ? "flat" : "blocks",
+            int(strcspn(middle,"\n")), middle);
+    if (serial == threaded) continue;
+    fail=true;
+    fprintf(stderr,"failed: threaded parse differs (%zu vs %zu bytes)\n",
+            threaded.size(), serial.size());
+  }
+
+  if (fail) exit(1);
+}
@@ -0,0 +1,86 @@
+#include "ut_common.hpp"
+
+using namespace Ark;
+
+/* parse_trusted() must give what parse() gives for printer output in
+   any style, and for anything else, errors included. */
+
+namespace {
+  std::string result(const std::string &text, int how) {
+    std::ostringstream o;
+    try {
+      if (how==0) o << parse(text);
+      else if (how==1) o << parse_trusted(text);
+      else if (how==2) o << parse_trusted(text,false);
+      else {
+        arena A;
+        o << parse_trusted_into(A,text.data(),text.size());
+      }
+    }
+    catch (exception &e) {
+      o << "error: " << e.what();
+    }
+    return o.str();
+  }
+
+  // how: 1 checked, 2 unchecked, 3 checked into an arena
+  void same(const char *what, const std::string &text, bool unchecked) {
+    std::string expect = result(text,0);
+    for (int how=1; how<4; ++how) {
+      if (how==2 && !unchecked) continue;
+      std::string got = result(text,how);
+      if (got == expect) continue;
+      fprintf(stderr,"failed: %s (%d)\n%s\nexpected:\n%s\ngot:\n%s\n",
+              what, how, text.c_str(), expect.c_str(), got.c_str());
+      fail=true;
+    }
+  }
+}
+
+int main() {
+  ark a;
+  parser().parse_keyvals(a,
+    "a = 1 b = \"two words\" c = 'q\"uote' d = \"back\\\\slash\" e = ?\n"
+    "f = [ 1 [ 2 [] ] { g = {} h = [ ? ? ] } \"\" ]\n"
+    "long_key_that_is_not_short = { x = \"}]=\" y = \"a#b\" }\n"
+    "v = [ { k = 1 } { k = 2 } ] :colon-key = 3 _u = ``\n");
+
+  // printer output, in each style
+  for (int ws=0; ws<2; ++ws) {
+    printer P;
+    P.whitespace(ws);
+    std::ostringstream o;
+    o << P(a);
+    same(ws ? "whitespace" : "default", o.str(), true);
+    if (result(o.str(),0).find("error")==0) {
+      fprintf(stderr,"failed: printer output didn't parse\n");
+      fail=true;
+    }
+  }
+
+  // anything else, including what only parse() can report
+  const char *texts[] = {
+    "", "   ", "?", "x", "\"x\"", "[]", "{}", "  { a = 1 }  # trailing\n",
+    "{ a = 1 # comment\n b = 2 }", "{ a = 'x\\'y' }", "{a=1}{b=2}",
+    "{ a = 1 a = 2 }", "{ 9a = 1 }", "{ \"a\" = 1 }", "{ a = 1",
+    "[ 1 2", "{ a 1 }", "{ a = }", "[ } ]", "{ a = < 1 > }", "x y",
+    "\"unterminated", "\"esc\\", "[a\\b]", "{ b = 1 a = 2 }"
+  };
+  for (size_t i=0; i<sizeof(texts)/sizeof(texts[0]); ++i)
+    same(texts[i],texts[i],false);
+  same("NUL after", std::string("[1 2]\0junk",10), false);
+  same("NUL inside", std::string("[1\0 2]",6), false);
+
+  // unchecked, a repeated key keeps its last value and any key goes
+  {
+    ark r = parse_trusted(std::string("{ a = 1 a = [2] 9b = 3 }"),false);
+    std::ostringstream o;
+    o << r;
+    if (o.str() != "{9b=\"3\"a=[\"2\"]}") {
+      fprintf(stderr,"failed: unchecked gave %s\n",o.str().c_str());
+      fail=true;
+    }
+  }
+
+  if (fail) exit(1);
+}
@@ -0,0 +1,122 @@
+#include "ut_common.hpp"
+#include <thread>
+
+using namespace Ark;
+
+/* A watcher must notice changes to any of the files it parsed, read
+   only those again, and name the keys that changed; a change that
+   doesn't parse must leave the ark alone until it is fixed. */
+
+namespace {
+  // as an editor saves: a new file renamed over the old one
+  void replace(const std::string &name, const std::string &text) {
+    write(name + "~", text);
+    rename(path(name + "~").c_str(), path(name).c_str());
+  }
+
+}
+
+int main() {
+  scratch("ut_watcher");
+
+  write("top.ark", "a = 1\nb { !include inc.ark }\nc { !include other.ark }\n");
+  write("inc.ark", "x = 1 y = [1 2]\n");
+  write("other.ark", "z = 1\n");
+
+  watcher w(path("top.ark"));
+  std::string heard;
+  int calls = 0;
+  w.subscribe([&](const ark &a, const std::vector<std::string> &keys) {
+    heard = joined(keys);
+    ++calls;
+    check("the ark passed is the watcher's", &a==&w.get());
+  });
+
+  check("first parse", "{a=\"1\"b={x=\"1\"y=[\"1\"\"2\"]}c={z=\"1\"}}",
+        show(w.get()));
+  const include_graph &g = w.includes();
+  check("includes", g.size()==3 && g[0].from=="" && g[0].to==path("top.ark")
+        && g[1].from==path("top.ark") && g[1].to==path("inc.ark")
+        && g[2].to==path("other.ark"));
+  // each include is stamped as it was read, not looked at afterwards
+  for (size_t i=0; i<g.size(); ++i) {
+    file_stamp st;
+    check("stamped", g[i].there && include_cache::stat(g[i].to,st)
+          && st==g[i].st);
+  }
+  check("nothing to do", !w.poll(0) && !w.reload() && !calls);
+
+  // only the changed file is parsed again
+  size_t hits = include_cache::hits(), misses = include_cache::misses();
+  write("inc.ark", "x = 2 y = [1 2 3]\n");
+  check("edited", w.poll(5000));
+  check("edited keys", "b.x b.y", heard);
+  check("reparsed", include_cache::misses()-misses==1
+        && include_cache::hits()-hits==2);
+  check("edited ark", "{a=\"1\"b={x=\"2\"y=[\"1\"\"2\"\"3\"]}c={z=\"1\"}}",
+        show(w.get()));
+
+  replace("other.ark", "z = 1 w = 2\n");
+  check("renamed", w.poll(5000));
+  check("renamed keys", "c.w", heard);
+
+  // saved again as it was: nothing to tell
+  calls = 0;
+  replace("other.ark", "z = 1 w = 2\n");
+  check("unchanged", !w.poll(200) && !calls);
+
+  // a change made while waiting wakes the wait
+  {
+    std::thread t([] {
+      usleep(100000);
+      write("other.ark", "z = 2 w = 2\n");
+    });
+    bool woke = w.poll(5000);
+    t.join();
+    check("woken", woke);
+    check("woken keys", "c.z", heard);
+  }
+
+  // a mistake, and its fix
+  calls = 0;
+  std::string before = show(w.get());
+  write("inc.ark", "x = [\n");
+  check("broken", !w.poll(5000) && !calls);
+  check("broken error", w.error().find("inc.ark")!=std::string::npos);
+  check("broken ark", before, show(w.get()));
+  write("inc.ark", "x = 3 y = { k = 1 }\n");
+  check("fixed", w.poll(5000) && w.error().empty());
+  check("fixed keys", "b.x b.y", heard);
+
+  // an include that isn't there yet
+  write("top.ark", "a = 1\nb { !include inc.ark }\nc { !include other.ark }\n"
+        "d { !include later.ark }\n");
+  check("missing", !w.poll(5000) && !w.error().empty());
+  check("missing include", w.includes().back().to==path("later.ark"));
+  write("later.ark", "q = [1]\n");
+  check("appeared", w.poll(5000) && w.error().empty());
+  check("appeared keys", "d", heard);
+
+  // and one that goes away
+  write("top.ark", "a = 2\nb { !include inc.ark }\n");
+  check("dropped", w.poll(5000));
+  check("dropped keys", "a c d", heard);
+  check("dropped includes", w.includes().size()==2);
+
+  // one included from inside a value
+  write("val.ark", "v = 1\n");
+  write("top.ark", "a = 2\nb { !include inc.ark }\ne = { k = 1 !include val.ark }\n");
+  check("value include", w.poll(5000) && w.error().empty());
+  check("value include keys", "e", heard);
+  check("value include watched", w.includes().back().to==path("val.ark"));
+  hits = include_cache::hits(), misses = include_cache::misses();
+  write("val.ark", "v = 2\n");
+  check("value include edited", w.poll(5000));
+  check("value include edited keys", "e.v", heard);
+  check("value include reparsed", include_cache::misses()-misses==1
+        && include_cache::hits()-hits==2);
+
+  clean();
+
+  if (fail) exit(1);
+}
@@ -0,0 +1,68 @@
+#include "parser.hpp"
+#include "exception.hpp"
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static void usage(const std::string& program, int exstatus) {
+  std::cerr << "usage: " << program
+            << " [--help]"
+            << " [--output file]"
+            << " file"
+            << std::endl
+            << std::endl
+            << "    --help              : print this message\n"
+            << "    --output file       : write the bundle here (default: stdout)\n"
+            << std::endl
+            << "Pack an ark file and every file it includes into one bundle,\n"
+            << "which parses exactly like the original and can be given to\n"
+            << "--include in its place."
+            << std::endl;
+
+  exit(exstatus);
+}
+
+int main(int argc, char** argv) try {
+  std::string input, output;
+
+  for (int i=1; i<argc; ++i) {
+    std::string text = argv[i];
+    if (text == "--help") {
+      usage(argv[0], 0);
+    }
+    else if (text == "--output") {
+      if (++i<argc)
+        output = argv[i];
+      else
+        usage(argv[0], 1);
+    }
+    else if (input.empty() && text.substr(0,2) != "--") {
+      input = text;
+    }
+    else
+      usage(argv[0], 1);
+  }
+  if (input.empty()) usage(argv[0], 1);
+
+  std::ostringstream bundle;
+  Ark::parser().write_bundle(bundle, input);
+
+  if (output.empty()) {
+    std::cout << bundle.str();
+  }
+  else {
+    std::ofstream out(output.c_str(), std::ios::binary);
+    out << bundle.str();
+    out.close();
+    if (!out) {
+      std::cerr << argv[0] << ": unable to write " << output << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
+catch (std::exception &e) {
+  std::cerr << argv[0] << ": " << e.what() << std::endl;
+  return 1;
+}
@@ -3,7 +3,10 @@
 #include "printer.hpp"
 #include "exception.hpp"
 #include "argv.hpp"
+#include "records.hpp"
+#include "compress.hpp"
 #include <cstdlib>
+#include <fstream>
 #include <functional>
 
 static void usage(const std::string& program, int exstatus) {
@@ -15,6 +18,11 @@ static void usage(const std::string& program, int exstatus) {
             << " [--include file]*"
             << " [--cfg line]*"
             << " [--flatten]"
+            << " [--jobs N]"
+            << " [--cache_dir dir]"
+            << " [--records file]"
+            << " [--record]"
+            << " [--gzip|--zstd]"
             << std::endl
             << std::endl
             << "    --help              : print this message\n"
@@ -23,6 +31,12 @@ static void usage(const std::string& program, int exstatus) {
             << "    --width INT         : set linewrap threshold\n"
             << "    --flatten           : ouput in 'dotted' notation rather than 'tabular' notation\n"
             << "    --open_tables       : print tables as key{...} rather than key={...}\n"
+            << "    --jobs N            : read and parse on N threads (default: one per core)\n"
+            << "    --cache_dir dir     : keep compiled snapshots of the input files in dir\n"
+            << "    --records file      : print each ark of the ark stream in file instead\n"
+            << "    --records -         : (special case) read the ark stream from stdin\n"
+            << "    --record            : print as records of an ark stream\n"
+            << "    --gzip, --zstd      : compress the output\n"
             << "    --include file      : Include this file as a table\n"
             << "    --cfg line          : parse given line as a table (see below)\n"
             << "    --cfg -             : (special case) parse stdin as a table\n"
@@ -39,10 +53,17 @@ int main(int argc, char** argv) {
   Ark::parser parser;
   Ark::printer printer;
 
+  // inputs are read and parsed on every core
+  parser.threads(0);
+
   // set printer defaults
   printer.no_delim(true);
   bool whitespace=true;
   printer.whitespace(whitespace);
+  unsigned jobs=0;
+  const char *records=NULL;
+  bool as_record=false;
+  Ark::compression_t compress=Ark::Uncompressed;
 
   // Demonstrate using argvremove_copy to defer the call to arkparse
   // until after the non-ark processing.
@@ -100,17 +121,88 @@ int main(int argc, char** argv) {
       printer.flatten(true);
     }
 
+    else if (text == "--jobs") {
+      if (++p!=nonarkargs.end())
+        parser.threads(jobs = atoi(*p));
+      else
+          usage(argv[0], 1);
+    }
+
+    else if (text == "--cache_dir") {
+      if (++p!=nonarkargs.end())
+        parser.cache_dir(*p);
+      else
+          usage(argv[0], 1);
+    }
+
+    else if (text == "--records") {
+      if (++p!=nonarkargs.end())
+        records = *p;
+      else
+          usage(argv[0], 1);
+    }
+
+    else if (text == "--record") {
+      as_record = true;
+    }
+
+    else if (text == "--gzip") {
+      compress = Ark::Gzip;
+    }
+
+    else if (text == "--zstd") {
+      compress = Ark::Zstd;
+    }
+
     else
         usage(argv[0], 1);
   }
 
+  try {
+    Ark::deflater out(std::cout, compress);
+    Ark::record_writer writer(out, printer);
+    auto print = [&](const Ark::ark &a) {
+      if (as_record) {
+        writer.write(a);
+        return;
+      }
+      out << printer(a);
+      // newline if no whitespace
+      if (!whitespace) out << std::endl;
+    };
+
+    if (records) {
+      // records are parsed a batch at a time on every core
+      std::ifstream file;
+      std::string name = records;
+      if (name == "-") name = "<stdin>";
+      else {
+        file.open(records, std::ios::binary);
+        if (!file) {
+          std::cerr << "arkcat: can't open " << records << std::endl;
+          return 1;
+        }
+      }
+      // compressed streams are inflated as they are read
+      Ark::inflater in(file.is_open() ? file : std::cin);
+      Ark::record_reader reader(in, name);
+      std::vector<Ark::ark> batch;
+      while (reader.next(batch, 256, jobs))
+        for (size_t i=0; i<batch.size(); ++i) print(batch[i]);
+      out.finish();
+      return 0;
+    }
 
-  Ark::argvparse(ark, argv, argv+argc);
+    Ark::argvparse(ark, argv, argv+argc, parser);
 
-  // Print
-  std::cout << printer(ark);
-  // newline if no whitespace
-  if (!whitespace) std::cout << std::endl;
+    // Print
+    print(ark);
+    out.finish();
+  }
+  catch (Ark::exception &e) {
+    std::cerr << "arkcat: " << e.what() << std::endl;
+    return 1;
+  }
 
   return 0;
 }
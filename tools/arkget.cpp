@@ -42,7 +42,19 @@ int main(int argc, char** argv)  try {
 
   printer.no_delim(1).whitespace(1);
 
-  Ark::argvparse(ark, argv, argv+argc);
+  // parse only what the output keys need; none means the whole ark
+  std::vector<const char *> rest;
+  Ark::argvremove_copy(argv+1, argv+argc, std::back_inserter(rest));
+  std::vector<std::string> keys;
+  for (size_t i=0; i<rest.size(); ++i) {
+    std::string text = rest[i];
+    if (text == "--width") ++i;
+    else if (text.substr(0,2) != "--") keys.push_back(text);
+  }
+  if (keys.empty()) keys.push_back("");
+  parser.select(keys);
+
+  Ark::argvparse(ark, argv, argv+argc, parser);
   char **end = Ark::argvremove(argv, argv+argc);
   argc = end-argv;
   for(int i=1; i<argc; ++i){
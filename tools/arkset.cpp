@@ -0,0 +1,70 @@
+#include "parser.hpp"
+#include "patch.hpp"
+#include "exception.hpp"
+#include <cstdlib>
+#include <iostream>
+
+static void usage(const std::string& program, int exstatus) {
+  std::cerr << "usage: " << program
+            << " [--help]"
+            << " [--output file]"
+            << " file"
+            << " key=value..."
+            << std::endl
+            << std::endl
+            << "    --help              : print this message\n"
+            << "    --output file       : write here (default: the file itself)\n"
+            << std::endl
+            << "Set superkeys in a keyvals file, replacing their values where\n"
+            << "they stand and copying the rest through as it was.  Values\n"
+            << "are written as after '=' in a keyval; keys that can't be set\n"
+            << "in place are appended.  The file is replaced atomically."
+            << std::endl;
+
+  exit(exstatus);
+}
+
+int main(int argc, char** argv) try {
+  std::string input, output;
+  Ark::patch patch;
+  size_t keys = 0;
+
+  for (int i=1; i<argc; ++i) {
+    std::string text = argv[i];
+    if (text == "--help") {
+      usage(argv[0], 0);
+    }
+    else if (text == "--output") {
+      if (++i<argc)
+        output = argv[i];
+      else
+        usage(argv[0], 1);
+    }
+    else if (input.empty() && text.substr(0,2) != "--") {
+      input = text;
+    }
+    else if (!input.empty() && text.find('=') != std::string::npos) {
+      size_t eq = text.find('=');
+      std::string v = text.substr(eq+1);
+      // anything after the value would set keys of its own; parsed
+      // under two names, one of them shows it whatever keys it sets
+      Ark::ark value, other;
+      Ark::parser().parse_keyvals(value, "v = " + v);
+      Ark::parser().parse_keyvals(other, "w = " + v);
+      if (value.table().size()!=1 || other.table().size()!=1)
+        throw Ark::InputError("'" + v + "' is more than one value");
+      patch.set(text.substr(0,eq), value.table()[Ark::key_t("v")]);
+      ++keys;
+    }
+    else
+      usage(argv[0], 1);
+  }
+  if (input.empty() || !keys) usage(argv[0], 1);
+
+  patch.apply_file(input, output);
+  return 0;
+}
+catch (std::exception &e) {
+  std::cerr << argv[0] << ": " << e.what() << std::endl;
+  return 1;
+}